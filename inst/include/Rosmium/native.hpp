@@ -0,0 +1,188 @@
+
+// Rosmium: R bindings for the Osmium library
+// Copyright (C) 2016 Lukas Huwiler
+//
+// This file is part of Rosmium.
+//
+// Rosmium is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Rosmium is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Rosmium.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ROSMIUM_NATIVE_HPP
+#define ROSMIUM_NATIVE_HPP
+
+// Native predicates and handlers compiled outside of Rosmium, e.g. with
+//
+//   // [[Rcpp::depends(Rosmium)]]
+//   #include <Rosmium/native.hpp>
+//
+//   bool many_tags(const osmium::OSMObject& object, void*) {
+//     return object.tags().size() > 10;
+//   }
+//
+//   // [[Rcpp::export]]
+//   SEXP many_tags_predicate() {
+//     return rosmium::make_predicate(&many_tags);
+//   }
+//
+// Only plain function pointers and the structs below cross the boundary
+// between the two shared libraries, so the user code has to be compiled
+// against the osmium headers installed with Rosmium (which the depends
+// attribute takes care of). Rosmium checks the tag of the external pointer
+// and the ABI version before it uses a struct.
+
+#include <cstdint>
+#include <Rcpp.h>
+#include <osmium/handler.hpp>
+#include <osmium/osm/node.hpp>
+#include <osmium/osm/object.hpp>
+#include <osmium/osm/relation.hpp>
+#include <osmium/osm/way.hpp>
+
+namespace rosmium {
+
+  enum {
+    native_abi_version = 1
+  };
+
+  typedef bool (*predicate_function)(const osmium::OSMObject& object, void* data);
+  typedef void (*node_function)(const osmium::Node& node, void* data);
+  typedef void (*way_function)(const osmium::Way& way, void* data);
+  typedef void (*relation_function)(const osmium::Relation& relation, void* data);
+  typedef void (*data_function)(void* data);
+
+  // A predicate usable as leaf of an object filter, true keeps the object
+  struct NativePredicate {
+    uint32_t abi_version;
+    predicate_function predicate;
+    void* data;
+    // Called when the external pointer is garbage collected (may be null)
+    data_function release;
+  };
+
+  /**
+   * Callbacks run inside a scan. Callbacks which are null are skipped. The
+   * handler is called on one thread in file order; ways have node
+   * locations if the scan was run with locations.
+   */
+  struct NativeHandler {
+    uint32_t abi_version;
+    void* data;
+    node_function node;
+    way_function way;
+    relation_function relation;
+    // Called at the end of every buffer (may be null)
+    data_function flush;
+    // Called when the external pointer is garbage collected (may be null)
+    data_function release;
+  };
+
+  // Tags of the external pointers, checked by Rosmium
+  inline const char* predicate_tag() {
+    return "Rosmium::NativePredicate";
+  }
+
+  inline const char* handler_tag() {
+    return "Rosmium::NativeHandler";
+  }
+
+  namespace detail {
+
+    template <typename T>
+    void finalize(SEXP pointer) {
+      T* object = static_cast<T*>(R_ExternalPtrAddr(pointer));
+      if(object == nullptr) {
+        return;
+      }
+      if(object->release != nullptr) {
+        object->release(object->data);
+      }
+      delete object;
+      R_ClearExternalPtr(pointer);
+    }
+
+    template <typename T>
+    SEXP wrap(T* object, const char* tag) {
+      SEXP pointer = PROTECT(R_MakeExternalPtr(object, Rf_install(tag), R_NilValue));
+      R_RegisterCFinalizerEx(pointer, finalize<T>, TRUE);
+      UNPROTECT(1);
+      return pointer;
+    }
+
+    template <typename T>
+    void release(void* data) {
+      delete static_cast<T*>(data);
+    }
+
+    template <typename TPredicate>
+    bool call_predicate(const osmium::OSMObject& object, void* data) {
+      return (*static_cast<TPredicate*>(data))(object);
+    }
+
+    template <typename THandler>
+    void call_node(const osmium::Node& node, void* data) {
+      static_cast<THandler*>(data)->node(node);
+    }
+
+    template <typename THandler>
+    void call_way(const osmium::Way& way, void* data) {
+      static_cast<THandler*>(data)->way(way);
+    }
+
+    template <typename THandler>
+    void call_relation(const osmium::Relation& relation, void* data) {
+      static_cast<THandler*>(data)->relation(relation);
+    }
+
+    template <typename THandler>
+    void call_flush(void* data) {
+      static_cast<THandler*>(data)->flush();
+    }
+
+  } // namespace detail
+
+  // External pointer to a predicate function
+  inline SEXP make_predicate(predicate_function predicate, void* data = nullptr, data_function release = nullptr) {
+    return detail::wrap(new NativePredicate{native_abi_version, predicate, data, release}, predicate_tag());
+  }
+
+  // External pointer to a copy of a function object with operator()(const osmium::OSMObject&) returning bool
+  template <typename TPredicate>
+  SEXP make_predicate(const TPredicate& predicate) {
+    return make_predicate(detail::call_predicate<TPredicate>, new TPredicate(predicate), detail::release<TPredicate>);
+  }
+
+  /**
+   * External pointer to a copy of an osmium handler (a class derived from
+   * osmium::handler::Handler). Its results can be read with
+   * handler_object<THandler>() on the same pointer after the scan.
+   */
+  template <typename THandler>
+  SEXP make_handler(const THandler& handler) {
+    return detail::wrap(new NativeHandler{native_abi_version, new THandler(handler),
+                                          detail::call_node<THandler>, detail::call_way<THandler>,
+                                          detail::call_relation<THandler>, detail::call_flush<THandler>,
+                                          detail::release<THandler>}, handler_tag());
+  }
+
+  template <typename THandler>
+  THandler& handler_object(SEXP pointer) {
+    if(TYPEOF(pointer) != EXTPTRSXP || R_ExternalPtrTag(pointer) != Rf_install(handler_tag()) ||
+       R_ExternalPtrAddr(pointer) == nullptr) {
+      Rcpp::stop("Not a native handler");
+    }
+    return *static_cast<THandler*>(static_cast<NativeHandler*>(R_ExternalPtrAddr(pointer))->data);
+  }
+
+} // namespace rosmium
+
+#endif // ROSMIUM_NATIVE_HPP
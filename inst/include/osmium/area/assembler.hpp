@@ -35,6 +35,7 @@ DEALINGS IN THE SOFTWARE.
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cstring>
 #include <iostream>
 #include <iterator>
@@ -69,9 +70,13 @@ namespace osmium {
             // Enables debug output to stderr
             bool debug;
 
+            // Measure the time spent in the phases of the assembly (see Assembler::timings())
+            bool timings;
+
             explicit AssemblerConfig(osmium::area::ProblemReporter* pr = nullptr, bool d = false) :
                 problem_reporter(pr),
-                debug(d) {
+                debug(d),
+                timings(false) {
             }
 
             /**
@@ -84,6 +89,32 @@ namespace osmium {
 
         }; // struct AssemblerConfig
 
+        /**
+         * Time spent in the phases of the assembly of one object (in
+         * seconds) and the number of segments. Only measured if enabled
+         * in the AssemblerConfig.
+         */
+        struct AssemblerTimings {
+
+            // Extracting the segments from the member ways
+            double extract_segments = 0;
+
+            // Sorting the segments, removing duplicates, checking for
+            // intersections and building the rings
+            double create_rings = 0;
+
+            // Building the area object (and the areas of inner ways with
+            // different tags)
+            double build_area = 0;
+
+            size_t segments = 0;
+
+            double total() const noexcept {
+                return extract_segments + create_rings + build_area;
+            }
+
+        }; // struct AssemblerTimings
+
         /**
          * Assembles area objects from multipolygon relations and their
          * members. This is called by the MultipolygonCollector object
@@ -91,8 +122,14 @@ namespace osmium {
          */
         class Assembler {
 
+            typedef std::chrono::steady_clock clock_type;
+
             const AssemblerConfig m_config;
 
+            AssemblerTimings m_timings;
+
+            clock_type::time_point m_phase_start;
+
             // The way segments
             osmium::area::detail::SegmentList m_segment_list;
 
@@ -108,6 +145,21 @@ namespace osmium {
                 return m_config.debug;
             }
 
+            void start_phase() {
+                if (m_config.timings) {
+                    m_phase_start = clock_type::now();
+                }
+            }
+
+            // Add the time since the last phase ended to the given timing
+            void end_phase(double& seconds) {
+                if (m_config.timings) {
+                    const clock_type::time_point now = clock_type::now();
+                    seconds += std::chrono::duration<double>(now - m_phase_start).count();
+                    m_phase_start = now;
+                }
+            }
+
             /**
              * Checks whether the given NodeRefs have the same location.
              * Uses the actual location for the test, not the id. If both
@@ -573,7 +625,7 @@ namespace osmium {
              */
             bool create_rings() {
                 m_segment_list.sort();
-                m_segment_list.erase_duplicate_segments();
+                m_segment_list.erase_duplicate_segments(m_config.problem_reporter);
 
                 // Now we look for segments crossing each other. If there are
                 // any, the multipolygon is invalid.
@@ -679,6 +731,7 @@ namespace osmium {
              * The resulting area is put into the out_buffer.
              */
             void operator()(const osmium::Way& way, osmium::memory::Buffer& out_buffer) {
+                start_phase();
                 if (m_config.problem_reporter) {
                     m_config.problem_reporter->set_object(osmium::item_type::way, way.id());
                 }
@@ -690,6 +743,8 @@ namespace osmium {
                 }
 
                 m_segment_list.extract_segments_from_way(way, "outer");
+                m_timings.segments = m_segment_list.size();
+                end_phase(m_timings.extract_segments);
 
                 if (debug()) {
                     std::cerr << "\nBuild way id()=" << way.id() << " segments.size()=" << m_segment_list.size() << "\n";
@@ -701,12 +756,15 @@ namespace osmium {
                     osmium::builder::AreaBuilder builder(out_buffer);
                     builder.initialize_from_object(way);
 
-                    if (create_rings()) {
+                    const bool valid = create_rings();
+                    end_phase(m_timings.create_rings);
+                    if (valid) {
                         add_tags_to_area(builder, way);
                         add_rings_to_area(builder);
                     }
                 }
                 out_buffer.commit();
+                end_phase(m_timings.build_area);
             }
 
             /**
@@ -716,11 +774,14 @@ namespace osmium {
              * The resulting area is put into the out_buffer.
              */
             void operator()(const osmium::Relation& relation, const std::vector<size_t>& members, const osmium::memory::Buffer& in_buffer, osmium::memory::Buffer& out_buffer) {
+                start_phase();
                 if (m_config.problem_reporter) {
                     m_config.problem_reporter->set_object(osmium::item_type::relation, relation.id());
                 }
 
                 m_segment_list.extract_segments_from_ways(relation, members, in_buffer);
+                m_timings.segments = m_segment_list.size();
+                end_phase(m_timings.extract_segments);
 
                 if (debug()) {
                     std::cerr << "\nBuild relation id()=" << relation.id() << " members.size()=" << members.size() << " segments.size()=" << m_segment_list.size() << "\n";
@@ -734,7 +795,9 @@ namespace osmium {
                     osmium::builder::AreaBuilder builder(out_buffer);
                     builder.initialize_from_object(relation);
 
-                    if (create_rings()) {
+                    const bool valid = create_rings();
+                    end_phase(m_timings.create_rings);
+                    if (valid) {
                         add_tags_to_area(builder, relation);
                         add_rings_to_area(builder);
                     }
@@ -776,6 +839,16 @@ namespace osmium {
                     Assembler assembler(m_config);
                     assembler(*way, out_buffer);
                 }
+                end_phase(m_timings.build_area);
+            }
+
+            /**
+             * Time spent in operator() of this Assembler (which is normally
+             * used for one object only). All zero unless timings are
+             * enabled in the config.
+             */
+            const AssemblerTimings& timings() const noexcept {
+                return m_timings;
             }
 
         }; // class Assembler
@@ -152,7 +152,7 @@ namespace osmium {
                  * segment. So if there are three, for instance, two will be
                  * removed and one will be left.
                  */
-                void erase_duplicate_segments() {
+                void erase_duplicate_segments(osmium::area::ProblemReporter* problem_reporter = nullptr) {
                     while (true) {
                         auto it = std::adjacent_find(m_segments.begin(), m_segments.end());
                         if (it == m_segments.end()) {
@@ -161,6 +161,9 @@ namespace osmium {
                         if (m_debug) {
                             std::cerr << "  erase duplicate segment: " << *it << "\n";
                         }
+                        if (problem_reporter) {
+                            problem_reporter->report_duplicate_segment(it->first(), it->second());
+                        }
                         m_segments.erase(it, it+2);
                     }
                 }
@@ -35,6 +35,7 @@ DEALINGS IN THE SOFTWARE.
 
 #include <osmium/osm/item_type.hpp>
 #include <osmium/osm/location.hpp>
+#include <osmium/osm/node_ref.hpp>
 #include <osmium/osm/types.hpp>
 
 namespace osmium {
@@ -138,6 +139,17 @@ namespace osmium {
             virtual void report_role_should_be_inner(osmium::object_id_type way_id, osmium::Location seg_start, osmium::Location seg_end) {
             }
 
+            /**
+             * Report a duplicate segment, ie. two ways (or the same way twice)
+             * with a segment between the same two nodes. Both segments are
+             * removed before the rings are built.
+             *
+             * @param nr1            NodeRef of one end of the segment.
+             * @param nr2            NodeRef of the other end of the segment.
+             */
+            virtual void report_duplicate_segment(const osmium::NodeRef& nr1, const osmium::NodeRef& nr2) {
+            }
+
 #pragma GCC diagnostic pop
 
         }; // class ProblemReporter
@@ -221,6 +221,25 @@ namespace osmium {
                 }
             }
 
+            /**
+             * Same as create_point(), but the geometry is written into out.
+             * The factory reuses the memory of out for its next geometry,
+             * so a caller which converts millions of objects with the same
+             * output string does not allocate a new string per object.
+             */
+            void create_point(const osmium::Location& location, point_type& out) {
+                m_impl.make_point(m_projection(location), out);
+            }
+
+            void create_point(const osmium::Node& node, point_type& out) {
+                try {
+                    create_point(node.location(), out);
+                } catch (osmium::geometry_error& e) {
+                    e.set_id("node", node.id());
+                    throw;
+                }
+            }
+
             /* LineString */
 
             void linestring_start() {
@@ -254,7 +273,7 @@ namespace osmium {
                 return m_impl.linestring_finish(num_points);
             }
 
-            linestring_type create_linestring(const osmium::WayNodeList& wnl, use_nodes un = use_nodes::unique, direction dir = direction::forward) {
+            size_t linestring_fill(const osmium::WayNodeList& wnl, use_nodes un, direction dir) {
                 linestring_start();
                 size_t num_points = 0;
 
@@ -283,7 +302,16 @@ namespace osmium {
                     throw osmium::geometry_error("need at least two points for linestring");
                 }
 
-                return linestring_finish(num_points);
+                return num_points;
+            }
+
+            linestring_type create_linestring(const osmium::WayNodeList& wnl, use_nodes un = use_nodes::unique, direction dir = direction::forward) {
+                return linestring_finish(linestring_fill(wnl, un, dir));
+            }
+
+            // Same as create_linestring(), but the geometry is written into out (see create_point())
+            void create_linestring(const osmium::WayNodeList& wnl, linestring_type& out, use_nodes un = use_nodes::unique, direction dir = direction::forward) {
+                m_impl.linestring_finish(linestring_fill(wnl, un, dir), out);
             }
 
             linestring_type create_linestring(const osmium::Way& way, use_nodes un=use_nodes::unique, direction dir=direction::forward) {
@@ -295,6 +323,15 @@ namespace osmium {
                 }
             }
 
+            void create_linestring(const osmium::Way& way, linestring_type& out, use_nodes un=use_nodes::unique, direction dir=direction::forward) {
+                try {
+                    create_linestring(way.nodes(), out, un, dir);
+                } catch (osmium::geometry_error& e) {
+                    e.set_id("way", way.id());
+                    throw;
+                }
+            }
+
             /* Polygon */
 
             void polygon_start() {
@@ -328,7 +365,7 @@ namespace osmium {
                 return m_impl.polygon_finish(num_points);
             }
 
-            polygon_type create_polygon(const osmium::WayNodeList& wnl, use_nodes un = use_nodes::unique, direction dir = direction::forward) {
+            size_t polygon_fill(const osmium::WayNodeList& wnl, use_nodes un, direction dir) {
                 polygon_start();
                 size_t num_points = 0;
 
@@ -357,7 +394,16 @@ namespace osmium {
                     throw osmium::geometry_error("need at least four points for polygon");
                 }
 
-                return polygon_finish(num_points);
+                return num_points;
+            }
+
+            polygon_type create_polygon(const osmium::WayNodeList& wnl, use_nodes un = use_nodes::unique, direction dir = direction::forward) {
+                return polygon_finish(polygon_fill(wnl, un, dir));
+            }
+
+            // Same as create_polygon(), but the geometry is written into out (see create_point())
+            void create_polygon(const osmium::WayNodeList& wnl, polygon_type& out, use_nodes un = use_nodes::unique, direction dir = direction::forward) {
+                m_impl.polygon_finish(polygon_fill(wnl, un, dir), out);
             }
 
             polygon_type create_polygon(const osmium::Way& way, use_nodes un=use_nodes::unique, direction dir=direction::forward) {
@@ -369,40 +415,53 @@ namespace osmium {
                 }
             }
 
+            void create_polygon(const osmium::Way& way, polygon_type& out, use_nodes un=use_nodes::unique, direction dir=direction::forward) {
+                try {
+                    create_polygon(way.nodes(), out, un, dir);
+                } catch (osmium::geometry_error& e) {
+                    e.set_id("way", way.id());
+                    throw;
+                }
+            }
+
             /* MultiPolygon */
 
-            multipolygon_type create_multipolygon(const osmium::Area& area) {
-                try {
-                    size_t num_polygons = 0;
-                    size_t num_rings = 0;
-                    m_impl.multipolygon_start();
-
-                    for (auto it = area.cbegin(); it != area.cend(); ++it) {
-                        const osmium::OuterRing& ring = static_cast<const osmium::OuterRing&>(*it);
-                        if (it->type() == osmium::item_type::outer_ring) {
-                            if (num_polygons > 0) {
-                                m_impl.multipolygon_polygon_finish();
-                            }
-                            m_impl.multipolygon_polygon_start();
-                            m_impl.multipolygon_outer_ring_start();
-                            add_points(ring);
-                            m_impl.multipolygon_outer_ring_finish();
-                            ++num_rings;
-                            ++num_polygons;
-                        } else if (it->type() == osmium::item_type::inner_ring) {
-                            m_impl.multipolygon_inner_ring_start();
-                            add_points(ring);
-                            m_impl.multipolygon_inner_ring_finish();
-                            ++num_rings;
+            void multipolygon_fill(const osmium::Area& area) {
+                size_t num_polygons = 0;
+                size_t num_rings = 0;
+                m_impl.multipolygon_start();
+
+                for (auto it = area.cbegin(); it != area.cend(); ++it) {
+                    const osmium::OuterRing& ring = static_cast<const osmium::OuterRing&>(*it);
+                    if (it->type() == osmium::item_type::outer_ring) {
+                        if (num_polygons > 0) {
+                            m_impl.multipolygon_polygon_finish();
                         }
+                        m_impl.multipolygon_polygon_start();
+                        m_impl.multipolygon_outer_ring_start();
+                        add_points(ring);
+                        m_impl.multipolygon_outer_ring_finish();
+                        ++num_rings;
+                        ++num_polygons;
+                    } else if (it->type() == osmium::item_type::inner_ring) {
+                        m_impl.multipolygon_inner_ring_start();
+                        add_points(ring);
+                        m_impl.multipolygon_inner_ring_finish();
+                        ++num_rings;
                     }
+                }
 
-                    // if there are no rings, this area is invalid
-                    if (num_rings == 0) {
-                        throw osmium::geometry_error("area contains no rings");
-                    }
+                // if there are no rings, this area is invalid
+                if (num_rings == 0) {
+                    throw osmium::geometry_error("area contains no rings");
+                }
 
-                    m_impl.multipolygon_polygon_finish();
+                m_impl.multipolygon_polygon_finish();
+            }
+
+            multipolygon_type create_multipolygon(const osmium::Area& area) {
+                try {
+                    multipolygon_fill(area);
                     return m_impl.multipolygon_finish();
                 } catch (osmium::geometry_error& e) {
                     e.set_id("area", area.id());
@@ -410,6 +469,17 @@ namespace osmium {
                 }
             }
 
+            // Same as create_multipolygon(), but the geometry is written into out (see create_point())
+            void create_multipolygon(const osmium::Area& area, multipolygon_type& out) {
+                try {
+                    multipolygon_fill(area);
+                    m_impl.multipolygon_finish(out);
+                } catch (osmium::geometry_error& e) {
+                    e.set_id("area", area.id());
+                    throw;
+                }
+            }
+
         }; // class GeometryFactory
 
     } // namespace geom
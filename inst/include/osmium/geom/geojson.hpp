@@ -73,6 +73,12 @@ namespace osmium {
                     return str;
                 }
 
+                void make_point(const osmium::geom::Coordinates& xy, std::string& out) const {
+                    out = "{\"type\":\"Point\",\"coordinates\":";
+                    xy.append_to_string(out, '[', ',', ']', m_precision);
+                    out += "}";
+                }
+
                 /* LineString */
 
                 // { "type": "LineString", "coordinates": [ [100.0, 0.0], [101.0, 1.0] ] }
@@ -97,6 +103,19 @@ namespace osmium {
                     return str;
                 }
 
+                /**
+                 * Same as linestring_finish(), but the geometry is swapped into out,
+                 * so the memory of out is reused for the next geometry.
+                 */
+                void linestring_finish(size_t /* num_points */, std::string& out) {
+                    assert(!m_str.empty());
+                    m_str.back() = ']';
+                    m_str += "}";
+
+                    using std::swap;
+                    swap(out, m_str);
+                }
+
                 /* MultiPolygon */
 
                 void multipolygon_start() {
@@ -146,6 +165,19 @@ namespace osmium {
                     return str;
                 }
 
+                /**
+                 * Same as multipolygon_finish(), but the geometry is swapped into out,
+                 * so the memory of out is reused for the next geometry.
+                 */
+                void multipolygon_finish(std::string& out) {
+                    assert(!m_str.empty());
+                    m_str.back() = ']';
+                    m_str += "}";
+
+                    using std::swap;
+                    swap(out, m_str);
+                }
+
             }; // class GeoJSONFactoryImpl
 
         } // namespace detail
@@ -65,15 +65,24 @@ namespace osmium {
                 std::copy_n(reinterpret_cast<char*>(&data), sizeof(T), &str[size]);
             }
 
-            inline std::string convert_to_hex(const std::string& str) {
+            /**
+             * Write the hex representation of str into out, replacing its
+             * content. The memory of out is reused if it is large enough.
+             */
+            inline void convert_to_hex(const std::string& str, std::string& out) {
                 static const char* lookup_hex = "0123456789ABCDEF";
-                std::string out;
+                out.resize(str.size() * 2);
 
+                char* hex = &out[0];
                 for (char c : str) {
-                    out += lookup_hex[(c >> 4) & 0xf];
-                    out += lookup_hex[c & 0xf];
+                    *hex++ = lookup_hex[(c >> 4) & 0xf];
+                    *hex++ = lookup_hex[c & 0xf];
                 }
+            }
 
+            inline std::string convert_to_hex(const std::string& str) {
+                std::string out;
+                convert_to_hex(str, out);
                 return out;
             }
 
@@ -122,6 +131,15 @@ namespace osmium {
                 size_t m_polygon_size_offset = 0;
                 size_t m_ring_size_offset = 0;
 
+                // Copy the geometry into out, keeping the memory of m_data for the next geometry
+                void output(std::string& out) const {
+                    if (m_out_type == out_type::hex) {
+                        convert_to_hex(m_data, out);
+                    } else {
+                        out.assign(m_data);
+                    }
+                }
+
                 size_t header(std::string& str, wkbGeometryType type, bool add_length) const {
 #if __BYTE_ORDER == __LITTLE_ENDIAN
                     str_push(str, wkb_byte_order_type::NDR);
@@ -173,6 +191,14 @@ namespace osmium {
                     }
                 }
 
+                void make_point(const osmium::geom::Coordinates& xy, std::string& out) {
+                    m_data.clear();
+                    header(m_data, wkbPoint, false);
+                    str_push(m_data, xy.x);
+                    str_push(m_data, xy.y);
+                    output(out);
+                }
+
                 /* LineString */
 
                 void linestring_start() {
@@ -199,6 +225,45 @@ namespace osmium {
                     }
                 }
 
+                void linestring_finish(size_t num_points, std::string& out) {
+                    set_size(m_linestring_size_offset, num_points);
+                    output(out);
+                }
+
+                /* Polygon */
+
+                void polygon_start() {
+                    m_data.clear();
+                    header(m_data, wkbPolygon, false);
+                    str_push(m_data, static_cast<uint32_t>(1));
+                    m_ring_size_offset = m_data.size();
+                    str_push(m_data, static_cast<uint32_t>(0));
+                }
+
+                void polygon_add_location(const osmium::geom::Coordinates& xy) {
+                    str_push(m_data, xy.x);
+                    str_push(m_data, xy.y);
+                }
+
+                polygon_type polygon_finish(size_t num_points) {
+                    set_size(m_ring_size_offset, num_points);
+                    std::string data;
+
+                    using std::swap;
+                    swap(data, m_data);
+
+                    if (m_out_type == out_type::hex) {
+                        return convert_to_hex(data);
+                    } else {
+                        return data;
+                    }
+                }
+
+                void polygon_finish(size_t num_points, std::string& out) {
+                    set_size(m_ring_size_offset, num_points);
+                    output(out);
+                }
+
                 /* MultiPolygon */
 
                 void multipolygon_start() {
@@ -259,6 +324,11 @@ namespace osmium {
                     }
                 }
 
+                void multipolygon_finish(std::string& out) {
+                    set_size(m_multipolygon_size_offset, m_polygons);
+                    output(out);
+                }
+
             }; // class WKBFactoryImpl
 
         } // namespace detail
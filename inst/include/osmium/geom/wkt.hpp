@@ -72,6 +72,11 @@ namespace osmium {
                     return str;
                 }
 
+                void make_point(const osmium::geom::Coordinates& xy, std::string& out) const {
+                    out = "POINT";
+                    xy.append_to_string(out, '(', ' ', ')', m_precision);
+                }
+
                 /* LineString */
 
                 void linestring_start() {
@@ -94,6 +99,18 @@ namespace osmium {
                     return str;
                 }
 
+                /**
+                 * Same as linestring_finish(), but the geometry is swapped into out,
+                 * so the memory of out is reused for the next geometry.
+                 */
+                void linestring_finish(size_t /* num_points */, std::string& out) {
+                    assert(!m_str.empty());
+                    m_str.back() = ')';
+
+                    using std::swap;
+                    swap(out, m_str);
+                }
+
                 /* MultiPolygon */
 
                 void multipolygon_start() {
@@ -142,6 +159,18 @@ namespace osmium {
                     return str;
                 }
 
+                /**
+                 * Same as multipolygon_finish(), but the geometry is swapped into out,
+                 * so the memory of out is reused for the next geometry.
+                 */
+                void multipolygon_finish(std::string& out) {
+                    assert(!m_str.empty());
+                    m_str.back() = ')';
+
+                    using std::swap;
+                    swap(out, m_str);
+                }
+
             }; // class WKTFactoryImpl
 
         } // namespace detail
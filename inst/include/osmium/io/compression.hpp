@@ -33,16 +33,26 @@ DEALINGS IN THE SOFTWARE.
 
 */
 
+#include <atomic>
 #include <cerrno>
+#include <condition_variable>
+#include <cstdlib>
+#include <exception>
 #include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>
 #include <system_error>
+#include <thread>
 #include <tuple>
 #include <utility>
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
 #ifndef _MSC_VER
 # include <unistd.h>
 #else
@@ -52,7 +62,9 @@ DEALINGS IN THE SOFTWARE.
 #include <osmium/io/detail/read_write.hpp>
 #include <osmium/io/error.hpp>
 #include <osmium/io/file_compression.hpp>
+#include <osmium/io/read_options.hpp>
 #include <osmium/io/writer_options.hpp>
+#include <osmium/thread/util.hpp>
 #include <osmium/util/compatibility.hpp>
 
 namespace osmium {
@@ -101,6 +113,22 @@ namespace osmium {
             virtual ~Decompressor() noexcept {
             }
 
+            /**
+             * Set the options for reading the input. This is called once
+             * before the first read(). Decompressors which do not read
+             * from a file themselves ignore the options.
+             */
+            virtual void set_read_options(const read_options& /*options*/) {
+            }
+
+            /**
+             * The page cache mode actually used. This can differ from the
+             * one in the read options if it is not supported.
+             */
+            virtual read_cache cache_mode() const noexcept {
+                return read_cache::keep;
+            }
+
             virtual std::string read() = 0;
 
             virtual void close() = 0;
@@ -238,24 +266,274 @@ namespace osmium {
 
         class NoDecompressor : public Decompressor {
 
+            struct free_delete {
+                void operator()(char* ptr) const noexcept {
+                    std::free(ptr);
+                }
+            };
+
+            // alignment of buffer, file offset and size for O_DIRECT
+            static constexpr size_t direct_alignment = 4096;
+
             int m_fd;
             const char *m_buffer;
             size_t m_buffer_size;
 
+            // only used when reading from m_fd
+            read_options m_options;
+            std::atomic<read_cache> m_cache;
+            bool m_started;
+            bool m_regular_file;
+            off_t m_offset;
+            off_t m_dropped;
+            std::unique_ptr<char, free_delete> m_direct_buffer;
+
+            // with prefetching, a helper thread reads the next chunk while
+            // the current one is processed and hands it over in one slot
+            std::thread m_prefetch_thread;
+            std::mutex m_prefetch_mutex;
+            std::condition_variable m_prefetch_cv;
+            std::string m_prefetched;
+            std::exception_ptr m_prefetch_error;
+            bool m_prefetch_full;
+            bool m_prefetch_end;
+            bool m_prefetch_stop;
+
+            void start() {
+                m_started = true;
+                struct stat file_stat;
+                m_regular_file = ::fstat(m_fd, &file_stat) == 0 && (file_stat.st_mode & S_IFMT) == S_IFREG;
+                if (!m_regular_file) {
+                    m_cache = read_cache::keep;
+                    return;
+                }
+
+                m_offset = ::lseek(m_fd, 0, SEEK_CUR);
+                if (m_offset < 0) {
+                    m_offset = 0;
+                }
+                m_dropped = m_offset;
+
+#ifdef POSIX_FADV_SEQUENTIAL
+                if (m_options.advise) {
+                    ::posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+                }
+#endif
+
+                if (m_cache == read_cache::direct && !enable_direct_io()) {
+                    m_cache = drop_or_keep();
+                } else if (m_cache == read_cache::drop) {
+                    m_cache = drop_or_keep();
+                }
+            }
+
+            static read_cache drop_or_keep() noexcept {
+#ifdef POSIX_FADV_DONTNEED
+                return read_cache::drop;
+#else
+                return read_cache::keep;
+#endif
+            }
+
+            size_t direct_read_size() const noexcept {
+                return (m_options.read_size + direct_alignment - 1) / direct_alignment * direct_alignment;
+            }
+
+            bool enable_direct_io() {
+#if defined(O_DIRECT)
+                if (m_offset % off_t(direct_alignment) != 0) {
+                    return false;
+                }
+                void* memory = nullptr;
+                if (::posix_memalign(&memory, direct_alignment, direct_read_size()) != 0) {
+                    return false;
+                }
+                m_direct_buffer.reset(static_cast<char*>(memory));
+                const int flags = ::fcntl(m_fd, F_GETFL);
+                if (flags == -1 || ::fcntl(m_fd, F_SETFL, flags | O_DIRECT) == -1) {
+                    m_direct_buffer.reset();
+                    return false;
+                }
+                return true;
+#elif defined(F_NOCACHE)
+                return ::fcntl(m_fd, F_NOCACHE, 1) != -1;
+#else
+                return false;
+#endif
+            }
+
+            void disable_direct_io() {
+#if defined(O_DIRECT)
+                const int flags = ::fcntl(m_fd, F_GETFL);
+                if (flags != -1) {
+                    ::fcntl(m_fd, F_SETFL, flags & ~O_DIRECT);
+                }
+#endif
+                m_direct_buffer.reset();
+                m_cache = drop_or_keep();
+            }
+
+            // Reads the next chunk from m_fd. Runs in the prefetch thread
+            // when prefetching.
+            std::string read_chunk() {
+                const size_t size = m_direct_buffer ? direct_read_size() : m_options.read_size;
+
+#ifdef POSIX_FADV_WILLNEED
+                if (m_options.advise && m_regular_file && m_cache != read_cache::direct) {
+                    ::posix_fadvise(m_fd, m_offset + off_t(size), off_t(size), POSIX_FADV_WILLNEED);
+                }
+#endif
+
+                std::string buffer;
+                if (m_direct_buffer) {
+                    const auto nread = ::read(m_fd, m_direct_buffer.get(), size);
+                    if (nread < 0 && errno == EINVAL) {
+                        // the file system does not support O_DIRECT after all
+                        disable_direct_io();
+                        return read_chunk();
+                    }
+                    if (nread < 0) {
+                        throw std::system_error(errno, std::system_category(), "Read failed");
+                    }
+                    buffer.assign(m_direct_buffer.get(), std::string::size_type(nread));
+                } else {
+                    buffer.resize(size);
+                    const auto nread = ::read(m_fd, const_cast<char*>(buffer.data()), size);
+                    if (nread < 0) {
+                        throw std::system_error(errno, std::system_category(), "Read failed");
+                    }
+                    buffer.resize(std::string::size_type(nread));
+                }
+                m_offset += off_t(buffer.size());
+
+#ifdef POSIX_FADV_DONTNEED
+                if (m_cache == read_cache::drop) {
+                    // whole pages only, at the end of the file everything
+                    // read ahead by the kernel is dropped as well
+                    const off_t start = m_dropped - m_dropped % off_t(direct_alignment);
+                    ::posix_fadvise(m_fd, start, buffer.empty() ? 0 : m_offset - start, POSIX_FADV_DONTNEED);
+                    m_dropped = m_offset;
+                }
+#endif
+
+                return buffer;
+            }
+
+            void run_prefetch() {
+                osmium::thread::set_thread_name("_osmium_prefetch");
+
+                std::exception_ptr error;
+                try {
+                    while (true) {
+                        {
+                            std::lock_guard<std::mutex> lock{m_prefetch_mutex};
+                            if (m_prefetch_stop) {
+                                break;
+                            }
+                        }
+                        std::string data{read_chunk()};
+                        if (data.empty()) {
+                            break;
+                        }
+                        std::unique_lock<std::mutex> lock{m_prefetch_mutex};
+                        m_prefetch_cv.wait(lock, [this] {
+                            return !m_prefetch_full || m_prefetch_stop;
+                        });
+                        if (m_prefetch_stop) {
+                            break;
+                        }
+                        m_prefetched = std::move(data);
+                        m_prefetch_full = true;
+                        m_prefetch_cv.notify_all();
+                    }
+                } catch (...) {
+                    error = std::current_exception();
+                }
+
+                std::lock_guard<std::mutex> lock{m_prefetch_mutex};
+                m_prefetch_error = error;
+                m_prefetch_end = true;
+                m_prefetch_cv.notify_all();
+            }
+
+            // Waits for the next chunk of the prefetch thread. Returns an
+            // empty string at the end of the file.
+            std::string take_prefetched() {
+                std::unique_lock<std::mutex> lock{m_prefetch_mutex};
+                m_prefetch_cv.wait(lock, [this] {
+                    return m_prefetch_full || m_prefetch_end;
+                });
+                if (m_prefetch_full) {
+                    std::string data{std::move(m_prefetched)};
+                    m_prefetched.clear();
+                    m_prefetch_full = false;
+                    m_prefetch_cv.notify_all();
+                    return data;
+                }
+                if (m_prefetch_error) {
+                    std::exception_ptr error{m_prefetch_error};
+                    m_prefetch_error = nullptr;
+                    std::rethrow_exception(error);
+                }
+                return std::string{};
+            }
+
+            void stop_prefetch() {
+                if (!m_prefetch_thread.joinable()) {
+                    return;
+                }
+                {
+                    std::lock_guard<std::mutex> lock{m_prefetch_mutex};
+                    m_prefetch_stop = true;
+                }
+                m_prefetch_cv.notify_all();
+                m_prefetch_thread.join();
+            }
+
         public:
 
             explicit NoDecompressor(int fd) :
                 Decompressor(),
                 m_fd(fd),
                 m_buffer(nullptr),
-                m_buffer_size(0) {
+                m_buffer_size(0),
+                m_options(),
+                m_cache(read_cache::keep),
+                m_started(false),
+                m_regular_file(false),
+                m_offset(0),
+                m_dropped(0),
+                m_direct_buffer(),
+                m_prefetch_thread(),
+                m_prefetch_mutex(),
+                m_prefetch_cv(),
+                m_prefetched(),
+                m_prefetch_error(),
+                m_prefetch_full(false),
+                m_prefetch_end(false),
+                m_prefetch_stop(false) {
             }
 
             NoDecompressor(const char* buffer, size_t size) :
                 Decompressor(),
                 m_fd(-1),
                 m_buffer(buffer),
-                m_buffer_size(size) {
+                m_buffer_size(size),
+                m_options(),
+                m_cache(read_cache::keep),
+                m_started(false),
+                m_regular_file(false),
+                m_offset(0),
+                m_dropped(0),
+                m_direct_buffer(),
+                m_prefetch_thread(),
+                m_prefetch_mutex(),
+                m_prefetch_cv(),
+                m_prefetched(),
+                m_prefetch_error(),
+                m_prefetch_full(false),
+                m_prefetch_end(false),
+                m_prefetch_stop(false) {
             }
 
             ~NoDecompressor() noexcept final {
@@ -266,6 +544,15 @@ namespace osmium {
                 }
             }
 
+            void set_read_options(const read_options& options) final {
+                m_options = options.check();
+                m_cache = options.cache;
+            }
+
+            read_cache cache_mode() const noexcept final {
+                return m_buffer ? read_cache::keep : m_cache.load();
+            }
+
             std::string read() final {
                 std::string buffer;
 
@@ -276,18 +563,20 @@ namespace osmium {
                         buffer.append(m_buffer, size);
                     }
                 } else {
-                    buffer.resize(osmium::io::Decompressor::input_buffer_size);
-                    auto nread = ::read(m_fd, const_cast<char*>(buffer.data()), osmium::io::Decompressor::input_buffer_size);
-                    if (nread < 0) {
-                        throw std::system_error(errno, std::system_category(), "Read failed");
+                    if (!m_started) {
+                        start();
+                        if (m_options.prefetch) {
+                            m_prefetch_thread = std::thread(&NoDecompressor::run_prefetch, this);
+                        }
                     }
-                    buffer.resize(std::string::size_type(nread));
+                    buffer = m_options.prefetch ? take_prefetched() : read_chunk();
                 }
 
                 return buffer;
             }
 
             void close() final {
+                stop_prefetch();
                 if (m_fd >= 0) {
                     int fd = m_fd;
                     m_fd = -1;
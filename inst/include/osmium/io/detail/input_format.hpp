@@ -58,6 +58,7 @@ namespace osmium {
             class Parser {
 
                 future_buffer_queue_type& m_output_queue;
+                std::shared_ptr<ready_signal> m_ready_signal;
                 std::promise<osmium::io::Header>& m_header_promise;
                 queue_wrapper<std::string> m_input_queue;
                 osmium::osm_entity_bits::type m_read_types;
@@ -95,15 +96,31 @@ namespace osmium {
                     }
                 }
 
+                /**
+                 * The signal to notify when a buffer is ready, if the
+                 * reader wants to take buffers out of order (else null).
+                 */
+                const std::shared_ptr<ready_signal>& output_ready_signal() const noexcept {
+                    return m_ready_signal;
+                }
+
+                void notify_output_ready() {
+                    if (m_ready_signal) {
+                        m_ready_signal->notify();
+                    }
+                }
+
                 /**
                  * Wrap the buffer into a future and add it to the output queue.
                  */
                 void send_to_output_queue(osmium::memory::Buffer&& buffer) {
                     add_to_queue(m_output_queue, std::move(buffer));
+                    notify_output_ready();
                 }
 
                 void send_to_output_queue(std::future<osmium::memory::Buffer>&& future) {
                     m_output_queue.push(std::move(future));
+                    notify_output_ready();
                 }
 
             public:
@@ -113,6 +130,7 @@ namespace osmium {
                        std::promise<osmium::io::Header>& header_promise,
                        osmium::osm_entity_bits::type read_types) :
                     m_output_queue(output_queue),
+                    m_ready_signal(),
                     m_header_promise(header_promise),
                     m_input_queue(input_queue),
                     m_read_types(read_types),
@@ -129,6 +147,15 @@ namespace osmium {
 
                 virtual void run() = 0;
 
+                /**
+                 * Notify this signal whenever a buffer is added to the
+                 * output queue or becomes ready. Must be called before
+                 * parse().
+                 */
+                void set_ready_signal(const std::shared_ptr<ready_signal>& signal) {
+                    m_ready_signal = signal;
+                }
+
                 void parse() {
                     try {
                         run();
@@ -139,6 +166,7 @@ namespace osmium {
                     }
 
                     add_end_of_data_to_queue(m_output_queue);
+                    notify_output_ready();
                 }
 
             }; // class Parser
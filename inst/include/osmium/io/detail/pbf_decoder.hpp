@@ -48,6 +48,7 @@ DEALINGS IN THE SOFTWARE.
 
 #include <osmium/builder/osm_object_builder.hpp>
 #include <osmium/io/detail/pbf.hpp> // IWYU pragma: export
+#include <osmium/io/detail/pbf_varint.hpp>
 #include <osmium/io/detail/protobuf_tags.hpp>
 #include <osmium/io/detail/zlib.hpp>
 #include <osmium/io/header.hpp>
@@ -57,7 +58,6 @@ DEALINGS IN THE SOFTWARE.
 #include <osmium/memory/buffer.hpp>
 #include <osmium/osm/entity_bits.hpp>
 #include <osmium/util/cast.hpp>
-#include <osmium/util/delta.hpp>
 
 namespace osmium {
 
@@ -84,6 +84,20 @@ namespace osmium {
 
                 osmium::memory::Buffer m_buffer { initial_buffer_size };
 
+                // decoded packed sint fields, reused for all objects of the block
+                std::vector<int64_t> m_ids;
+                std::vector<int64_t> m_lats;
+                std::vector<int64_t> m_lons;
+                std::vector<int64_t> m_timestamps;
+                std::vector<int64_t> m_changesets;
+                std::vector<int64_t> m_uids;
+                std::vector<int64_t> m_user_sids;
+                std::vector<int64_t> m_refs;
+
+                static void decode_deltas(const ptr_len_type& data, std::vector<int64_t>& values) {
+                    decode_packed_sint_delta(data.first, data.first + data.second, values);
+                }
+
                 void decode_stringtable(const ptr_len_type& data) {
                     if (!m_stringtable.empty()) {
                         throw osmium::pbf_error("more than one stringtable in pbf file");
@@ -292,7 +306,7 @@ namespace osmium {
 
                     kv_type keys;
                     kv_type vals;
-                    std::pair<protozero::pbf_reader::const_sint64_iterator, protozero::pbf_reader::const_sint64_iterator> refs;
+                    ptr_len_type refs = { nullptr, 0 };
 
                     osm_string_len_type user = { "", 0 };
 
@@ -312,7 +326,7 @@ namespace osmium {
                                 user = decode_info(pbf_way.get_data(), builder.object());
                                 break;
                             case OSMFormat::Way::packed_sint64_refs:
-                                refs = pbf_way.get_packed_sint64();
+                                refs = pbf_way.get_data();
                                 break;
                             default:
                                 pbf_way.skip();
@@ -321,11 +335,11 @@ namespace osmium {
 
                     builder.add_user(user.first, user.second);
 
-                    if (refs.first != refs.second) {
+                    if (refs.second > 0) {
+                        decode_deltas(refs, m_refs);
                         osmium::builder::WayNodeListBuilder wnl_builder(m_buffer, &builder);
-                        osmium::util::DeltaDecode<int64_t> ref;
-                        while (refs.first != refs.second) {
-                            wnl_builder.add_node_ref(ref.update(*refs.first++));
+                        for (const int64_t ref : m_refs) {
+                            wnl_builder.add_node_ref(ref);
                         }
                     }
 
@@ -340,7 +354,7 @@ namespace osmium {
                     kv_type keys;
                     kv_type vals;
                     std::pair<protozero::pbf_reader::const_int32_iterator,  protozero::pbf_reader::const_int32_iterator> roles;
-                    std::pair<protozero::pbf_reader::const_sint64_iterator, protozero::pbf_reader::const_sint64_iterator> refs;
+                    ptr_len_type refs = { nullptr, 0 };
                     std::pair<protozero::pbf_reader::const_int32_iterator,  protozero::pbf_reader::const_int32_iterator> types;
 
                     osm_string_len_type user = { "", 0 };
@@ -364,7 +378,7 @@ namespace osmium {
                                 roles = pbf_relation.get_packed_int32();
                                 break;
                             case OSMFormat::Relation::packed_sint64_memids:
-                                refs = pbf_relation.get_packed_sint64();
+                                refs = pbf_relation.get_data();
                                 break;
                             case OSMFormat::Relation::packed_MemberType_types:
                                 types = pbf_relation.get_packed_enum();
@@ -376,10 +390,11 @@ namespace osmium {
 
                     builder.add_user(user.first, user.second);
 
-                    if (refs.first != refs.second) {
+                    if (refs.second > 0) {
+                        decode_deltas(refs, m_refs);
                         osmium::builder::RelationMemberListBuilder rml_builder(m_buffer, &builder);
-                        osmium::util::DeltaDecode<int64_t> ref;
-                        while (roles.first != roles.second && refs.first != refs.second && types.first != types.second) {
+                        auto ref = m_refs.cbegin();
+                        while (roles.first != roles.second && ref != m_refs.cend() && types.first != types.second) {
                             const auto& r = m_stringtable.at(*roles.first++);
                             int type = *types.first++;
                             if (type < 0 || type > 2) {
@@ -387,7 +402,7 @@ namespace osmium {
                             }
                             rml_builder.add_member(
                                 osmium::item_type(type + 1),
-                                ref.update(*refs.first++),
+                                *ref++,
                                 r.first,
                                 r.second
                             );
@@ -403,24 +418,24 @@ namespace osmium {
                     bool has_info     = false;
                     bool has_visibles = false;
 
-                    std::pair<protozero::pbf_reader::const_sint64_iterator, protozero::pbf_reader::const_sint64_iterator> ids;
-                    std::pair<protozero::pbf_reader::const_sint64_iterator, protozero::pbf_reader::const_sint64_iterator> lats;
-                    std::pair<protozero::pbf_reader::const_sint64_iterator, protozero::pbf_reader::const_sint64_iterator> lons;
+                    ptr_len_type ids = { nullptr, 0 };
+                    ptr_len_type lats = { nullptr, 0 };
+                    ptr_len_type lons = { nullptr, 0 };
 
                     std::pair<protozero::pbf_reader::const_int32_iterator,  protozero::pbf_reader::const_int32_iterator>  tags;
 
                     std::pair<protozero::pbf_reader::const_int32_iterator,  protozero::pbf_reader::const_int32_iterator>  versions;
-                    std::pair<protozero::pbf_reader::const_sint64_iterator, protozero::pbf_reader::const_sint64_iterator> timestamps;
-                    std::pair<protozero::pbf_reader::const_sint64_iterator, protozero::pbf_reader::const_sint64_iterator> changesets;
-                    std::pair<protozero::pbf_reader::const_sint32_iterator, protozero::pbf_reader::const_sint32_iterator> uids;
-                    std::pair<protozero::pbf_reader::const_sint32_iterator, protozero::pbf_reader::const_sint32_iterator> user_sids;
+                    ptr_len_type timestamps = { nullptr, 0 };
+                    ptr_len_type changesets = { nullptr, 0 };
+                    ptr_len_type uids = { nullptr, 0 };
+                    ptr_len_type user_sids = { nullptr, 0 };
                     std::pair<protozero::pbf_reader::const_int32_iterator,  protozero::pbf_reader::const_int32_iterator>  visibles;
 
                     protozero::pbf_message<OSMFormat::DenseNodes> pbf_dense_nodes(data);
                     while (pbf_dense_nodes.next()) {
                         switch (pbf_dense_nodes.tag()) {
                             case OSMFormat::DenseNodes::packed_sint64_id:
-                                ids = pbf_dense_nodes.get_packed_sint64();
+                                ids = pbf_dense_nodes.get_data();
                                 break;
                             case OSMFormat::DenseNodes::optional_DenseInfo_denseinfo:
                                 {
@@ -432,16 +447,16 @@ namespace osmium {
                                                 versions = pbf_dense_info.get_packed_int32();
                                                 break;
                                             case OSMFormat::DenseInfo::packed_sint64_timestamp:
-                                                timestamps = pbf_dense_info.get_packed_sint64();
+                                                timestamps = pbf_dense_info.get_data();
                                                 break;
                                             case OSMFormat::DenseInfo::packed_sint64_changeset:
-                                                changesets = pbf_dense_info.get_packed_sint64();
+                                                changesets = pbf_dense_info.get_data();
                                                 break;
                                             case OSMFormat::DenseInfo::packed_sint32_uid:
-                                                uids = pbf_dense_info.get_packed_sint32();
+                                                uids = pbf_dense_info.get_data();
                                                 break;
                                             case OSMFormat::DenseInfo::packed_sint32_user_sid:
-                                                user_sids = pbf_dense_info.get_packed_sint32();
+                                                user_sids = pbf_dense_info.get_data();
                                                 break;
                                             case OSMFormat::DenseInfo::packed_bool_visible:
                                                 has_visibles = true;
@@ -454,10 +469,10 @@ namespace osmium {
                                 }
                                 break;
                             case OSMFormat::DenseNodes::packed_sint64_lat:
-                                lats = pbf_dense_nodes.get_packed_sint64();
+                                lats = pbf_dense_nodes.get_data();
                                 break;
                             case OSMFormat::DenseNodes::packed_sint64_lon:
-                                lons = pbf_dense_nodes.get_packed_sint64();
+                                lons = pbf_dense_nodes.get_data();
                                 break;
                             case OSMFormat::DenseNodes::packed_int32_keys_vals:
                                 tags = pbf_dense_nodes.get_packed_int32();
@@ -467,36 +482,39 @@ namespace osmium {
                         }
                     }
 
-                    osmium::util::DeltaDecode<int64_t> dense_id;
-                    osmium::util::DeltaDecode<int64_t> dense_latitude;
-                    osmium::util::DeltaDecode<int64_t> dense_longitude;
-                    osmium::util::DeltaDecode<int64_t> dense_uid;
-                    osmium::util::DeltaDecode<int64_t> dense_user_sid;
-                    osmium::util::DeltaDecode<int64_t> dense_changeset;
-                    osmium::util::DeltaDecode<int64_t> dense_timestamp;
+                    // the delta coded fields are decoded as a whole
+                    decode_deltas(ids, m_ids);
+                    decode_deltas(lats, m_lats);
+                    decode_deltas(lons, m_lons);
+                    if (m_lons.size() < m_ids.size() ||
+                        m_lats.size() < m_ids.size()) {
+                        // this is against the spec, must have same number of elements
+                        throw osmium::pbf_error("PBF format error");
+                    }
+                    if (has_info) {
+                        decode_deltas(timestamps, m_timestamps);
+                        decode_deltas(changesets, m_changesets);
+                        decode_deltas(uids, m_uids);
+                        decode_deltas(user_sids, m_user_sids);
+                    }
 
                     auto tag_it = tags.first;
 
-                    while (ids.first != ids.second) {
-                        if (lons.first == lons.second ||
-                            lats.first == lats.second) {
-                            // this is against the spec, must have same number of elements
-                            throw osmium::pbf_error("PBF format error");
-                        }
+                    for (size_t i = 0; i < m_ids.size(); ++i) {
 
                         bool visible = true;
 
                         osmium::builder::NodeBuilder builder(m_buffer);
                         osmium::Node& node = builder.object();
 
-                        node.set_id(dense_id.update(*ids.first++));
+                        node.set_id(m_ids[i]);
 
                         if (has_info) {
                             if (versions.first == versions.second ||
-                                changesets.first == changesets.second ||
-                                timestamps.first == timestamps.second ||
-                                uids.first == uids.second ||
-                                user_sids.first == user_sids.second) {
+                                i >= m_changesets.size() ||
+                                i >= m_timestamps.size() ||
+                                i >= m_uids.size() ||
+                                i >= m_user_sids.size()) {
                                 // this is against the spec, must have same number of elements
                                 throw osmium::pbf_error("PBF format error");
                             }
@@ -507,14 +525,14 @@ namespace osmium {
                             }
                             node.set_version(static_cast<osmium::object_version_type>(version));
 
-                            auto changeset_id = dense_changeset.update(*changesets.first++);
+                            auto changeset_id = m_changesets[i];
                             if (changeset_id < 0) {
                                 throw osmium::pbf_error("object changeset_id must not be negative");
                             }
                             node.set_changeset(static_cast<osmium::changeset_id_type>(changeset_id));
 
-                            node.set_timestamp(dense_timestamp.update(*timestamps.first++) * m_date_factor / 1000);
-                            node.set_uid_from_signed(static_cast<osmium::signed_user_id_type>(dense_uid.update(*uids.first++)));
+                            node.set_timestamp(m_timestamps[i] * m_date_factor / 1000);
+                            node.set_uid_from_signed(static_cast<osmium::signed_user_id_type>(m_uids[i]));
 
                             if (has_visibles) {
                                 if (visibles.first == visibles.second) {
@@ -525,7 +543,7 @@ namespace osmium {
                             }
                             node.set_visible(visible);
 
-                            const auto& u = m_stringtable.at(dense_user_sid.update(*user_sids.first++));
+                            const auto& u = m_stringtable.at(m_user_sids[i]);
                             builder.add_user(u.first, u.second);
                         } else {
                             builder.add_user("");
@@ -533,8 +551,8 @@ namespace osmium {
 
                         // even if the node isn't visible, there's still a record
                         // of its lat/lon in the dense arrays.
-                        const auto lon = dense_longitude.update(*lons.first++);
-                        const auto lat = dense_latitude.update(*lats.first++);
+                        const auto lon = m_lons[i];
+                        const auto lat = m_lats[i];
                         if (visible) {
                             builder.object().set_location(osmium::Location(
                                     convert_pbf_coordinate(lon),
@@ -38,6 +38,7 @@ DEALINGS IN THE SOFTWARE.
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <future>
 #include <memory>
 #include <sstream>
 #include <string>
@@ -67,6 +68,40 @@ namespace osmium {
 
         namespace detail {
 
+            /**
+             * Decodes a data blob like PBFDataBlobDecoder, but hands the
+             * buffer over through a promise and notifies the signal (if
+             * set) after it is ready.
+             */
+            class PBFNotifyingBlobDecoder {
+
+                PBFDataBlobDecoder m_decoder;
+                std::shared_ptr<std::promise<osmium::memory::Buffer>> m_promise;
+                std::shared_ptr<ready_signal> m_ready_signal;
+
+            public:
+
+                PBFNotifyingBlobDecoder(PBFDataBlobDecoder&& decoder,
+                                        const std::shared_ptr<std::promise<osmium::memory::Buffer>>& promise,
+                                        const std::shared_ptr<ready_signal>& signal) :
+                    m_decoder(std::move(decoder)),
+                    m_promise(promise),
+                    m_ready_signal(signal) {
+                }
+
+                void operator()() {
+                    try {
+                        m_promise->set_value(m_decoder());
+                    } catch (...) {
+                        m_promise->set_exception(std::current_exception());
+                    }
+                    if (m_ready_signal) {
+                        m_ready_signal->notify();
+                    }
+                }
+
+            }; // class PBFNotifyingBlobDecoder
+
             class PBFParser : public Parser {
 
                 std::string m_input_buffer;
@@ -186,7 +221,10 @@ namespace osmium {
                         PBFDataBlobDecoder data_blob_parser{ std::move(input_buffer), read_types() };
 
                         if (osmium::config::use_pool_threads_for_pbf_parsing()) {
-                            send_to_output_queue(osmium::thread::Pool::instance().submit(std::move(data_blob_parser)));
+                            auto promise = std::make_shared<std::promise<osmium::memory::Buffer>>();
+                            std::future<osmium::memory::Buffer> future = promise->get_future();
+                            osmium::thread::Pool::instance().submit(PBFNotifyingBlobDecoder{ std::move(data_blob_parser), promise, output_ready_signal() });
+                            send_to_output_queue(std::move(future));
                         } else {
                             send_to_output_queue(data_blob_parser());
                         }
@@ -0,0 +1,375 @@
+#ifndef OSMIUM_IO_DETAIL_PBF_VARINT_HPP
+#define OSMIUM_IO_DETAIL_PBF_VARINT_HPP
+
+/*
+
+This file is part of Osmium (http://osmcode.org/libosmium).
+
+Copyright 2013-2015 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <protozero/exception.hpp>
+#include <protozero/varint.hpp>
+
+#if !defined(OSMIUM_NO_SIMD_VARINT) && (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+# define OSMIUM_SIMD_VARINT
+# include <immintrin.h>
+#endif
+
+namespace osmium {
+
+    namespace io {
+
+        namespace detail {
+
+            /**
+             * Implementations of the packed varint decoder. The SIMD
+             * variants are only available on x86 with GCC or clang and
+             * are only used if the CPU supports them.
+             */
+            enum class varint_decoder : int {
+                automatic = 0,
+                scalar    = 1,
+                sse2      = 2,
+                avx2      = 3
+            };
+
+            inline const char* varint_decoder_name(varint_decoder decoder) noexcept {
+                static const char* names[] = { "automatic", "scalar", "sse2", "avx2" };
+                return names[static_cast<int>(decoder)];
+            }
+
+            /**
+             * Does this CPU (and compiler) support the decoder?
+             */
+            inline bool varint_decoder_supported(varint_decoder decoder) noexcept {
+                switch (decoder) {
+                    case varint_decoder::automatic:
+                    case varint_decoder::scalar:
+                        return true;
+#ifdef OSMIUM_SIMD_VARINT
+                    case varint_decoder::sse2: {
+                        static const bool supported = (__builtin_cpu_init(), __builtin_cpu_supports("sse2"));
+                        return supported;
+                    }
+                    case varint_decoder::avx2: {
+                        static const bool supported = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+                        return supported;
+                    }
+#endif
+                    default:
+                        return false;
+                }
+            }
+
+            namespace varint {
+
+                // The decoder chosen with set_varint_decoder()
+                inline std::atomic<int>& decoder_setting() noexcept {
+                    static std::atomic<int> setting{static_cast<int>(varint_decoder::automatic)};
+                    return setting;
+                }
+
+                // The best decoder supported by this CPU, checked once
+                inline varint_decoder best_decoder() noexcept {
+                    static const varint_decoder best = varint_decoder_supported(varint_decoder::avx2) ? varint_decoder::avx2 :
+                                                       varint_decoder_supported(varint_decoder::sse2) ? varint_decoder::sse2 :
+                                                                                                        varint_decoder::scalar;
+                    return best;
+                }
+
+                inline int popcount(uint64_t bits) noexcept {
+#if defined(__GNUC__) || defined(__clang__)
+                    return __builtin_popcountll(bits);
+#else
+                    int count = 0;
+                    for (; bits; bits &= bits - 1) {
+                        ++count;
+                    }
+                    return count;
+#endif
+                }
+
+                /**
+                 * Number of varints in the data (the bytes without the
+                 * continuation bit). Throws if the last varint is cut off.
+                 */
+                inline size_t count(const char* begin, const char* end) {
+                    if (begin == end) {
+                        return 0;
+                    }
+                    if (static_cast<unsigned char>(end[-1]) & 0x80) {
+                        throw protozero::end_of_buffer_exception();
+                    }
+                    size_t count = 0;
+                    const char* p = begin;
+                    for (; end - p >= 8; p += 8) {
+                        uint64_t word;
+                        std::memcpy(&word, p, sizeof(word));
+                        count += popcount(~word & 0x8080808080808080ULL);
+                    }
+                    for (; p != end; ++p) {
+                        count += (static_cast<unsigned char>(*p) & 0x80) == 0;
+                    }
+                    return count;
+                }
+
+                inline const char* decode_scalar(const char* p, const char* end, int64_t*& out, int64_t& value) {
+                    int64_t* data = out;
+                    int64_t sum = value;
+                    while (p != end) {
+                        sum += protozero::decode_zigzag64(protozero::decode_varint(&p, end));
+                        *data++ = sum;
+                    }
+                    out = data;
+                    value = sum;
+                    return p;
+                }
+
+#ifdef OSMIUM_SIMD_VARINT
+
+                /**
+                 * Value of a varint of length 1 to 8 (bytes in little endian
+                 * order): drops the bytes after it and the continuation bits
+                 * and packs the 7 bit groups.
+                 */
+                inline uint64_t pack_groups(const char* data, unsigned int length) noexcept {
+                    uint64_t word;
+                    std::memcpy(&word, data, sizeof(word));
+                    word &= (~uint64_t(0) >> (64 - 8 * length)) & 0x7f7f7f7f7f7f7f7fULL;
+                    // 7 bit groups to 14, 28 and 56 bits
+                    word = (word & 0x007f007f007f007fULL) | ((word & 0x7f007f007f007f00ULL) >> 1);
+                    word = (word & 0x00003fff00003fffULL) | ((word & 0x3fff00003fff0000ULL) >> 2);
+                    return (word & 0x000000000fffffffULL) | ((word & 0x0fffffff00000000ULL) >> 4);
+                }
+
+                /**
+                 * Decodes the varints ending in a chunk starting at p (the
+                 * bits of stops mark the last byte of every varint) and
+                 * returns the start of the first varint not decoded. At
+                 * least 8 bytes must be readable after every varint start.
+                 */
+                inline const char* decode_chunk(const char* p, const char* end, uint32_t stops, int64_t*& out, int64_t& value) {
+                    unsigned int first = 0;
+                    while (stops) {
+                        const unsigned int last = static_cast<unsigned int>(__builtin_ctz(stops));
+                        const unsigned int length = last - first + 1;
+                        uint64_t raw;
+                        if (length <= 8) {
+                            raw = pack_groups(p + first, length);
+                        } else {
+                            // rare 9 and 10 byte varints, throws on overlong ones
+                            const char* data = p + first;
+                            raw = protozero::decode_varint(&data, end);
+                        }
+                        value += protozero::decode_zigzag64(raw);
+                        *out++ = value;
+                        first = last + 1;
+                        stops &= stops - 1;
+                    }
+                    return p + first;
+                }
+
+                /**
+                 * Decodes a chunk of 16 single byte varints: the zigzag
+                 * decoding and the prefix sum of the deltas are done in
+                 * 16 bit lanes, the sums are then widened to 64 bit.
+                 */
+                __attribute__((target("sse2")))
+                inline void decode_bytes_sse2(__m128i chunk, int64_t*& out, int64_t& value) {
+                    const __m128i zero = _mm_setzero_si128();
+                    const __m128i one = _mm_set1_epi16(1);
+                    const __m128i halves[2] = { _mm_unpacklo_epi8(chunk, zero), _mm_unpackhi_epi8(chunk, zero) };
+                    for (const __m128i& half : halves) {
+                        __m128i x = _mm_xor_si128(_mm_srli_epi16(half, 1), _mm_sub_epi16(zero, _mm_and_si128(half, one)));
+                        x = _mm_add_epi16(x, _mm_slli_si128(x, 2));
+                        x = _mm_add_epi16(x, _mm_slli_si128(x, 4));
+                        x = _mm_add_epi16(x, _mm_slli_si128(x, 8));
+                        const __m128i base = _mm_set1_epi64x(value);
+                        const __m128i sign16 = _mm_srai_epi16(x, 15);
+                        const __m128i quads[2] = { _mm_unpacklo_epi16(x, sign16), _mm_unpackhi_epi16(x, sign16) };
+                        for (const __m128i& quad : quads) {
+                            const __m128i sign32 = _mm_srai_epi32(quad, 31);
+                            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_add_epi64(_mm_unpacklo_epi32(quad, sign32), base));
+                            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2), _mm_add_epi64(_mm_unpackhi_epi32(quad, sign32), base));
+                            out += 4;
+                        }
+                        value = out[-1];
+                    }
+                }
+
+                __attribute__((target("avx2")))
+                inline void decode_bytes_avx2(__m128i chunk, int64_t*& out, int64_t& value) {
+                    const __m256i bytes = _mm256_cvtepu8_epi16(chunk);
+                    __m256i x = _mm256_xor_si256(_mm256_srli_epi16(bytes, 1),
+                                                 _mm256_sub_epi16(_mm256_setzero_si256(), _mm256_and_si256(bytes, _mm256_set1_epi16(1))));
+                    x = _mm256_add_epi16(x, _mm256_slli_si256(x, 2));
+                    x = _mm256_add_epi16(x, _mm256_slli_si256(x, 4));
+                    x = _mm256_add_epi16(x, _mm256_slli_si256(x, 8));
+                    // add the last sum of the low 128 bit lane to the high lane
+                    __m256i carry = _mm256_permute2x128_si256(x, x, 0x08);
+                    carry = _mm256_shufflehi_epi16(carry, 0xff);
+                    x = _mm256_add_epi16(x, _mm256_unpackhi_epi64(carry, carry));
+                    const __m256i base = _mm256_set1_epi64x(value);
+                    const __m128i lanes[2] = { _mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1) };
+                    for (const __m128i& lane : lanes) {
+                        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_add_epi64(_mm256_cvtepi16_epi64(lane), base));
+                        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 4), _mm256_add_epi64(_mm256_cvtepi16_epi64(_mm_srli_si128(lane, 8)), base));
+                        out += 8;
+                    }
+                    value = out[-1];
+                }
+
+                __attribute__((target("sse2")))
+                inline const char* decode_sse2(const char* p, const char* end, int64_t*& out, int64_t& value) {
+                    // local copies, so they stay in registers
+                    int64_t* data = out;
+                    int64_t sum = value;
+                    while (end - p >= 16 + 8) {
+                        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                        const uint32_t stops = ~static_cast<uint32_t>(_mm_movemask_epi8(chunk)) & 0xffffu;
+                        if (stops == 0xffffu) {
+                            decode_bytes_sse2(chunk, data, sum);
+                            p += 16;
+                            continue;
+                        }
+                        if (stops == 0) {
+                            protozero::decode_varint(&p, end); // throws varint_too_long_exception
+                        }
+                        p = decode_chunk(p, end, stops, data, sum);
+                    }
+                    p = decode_scalar(p, end, data, sum);
+                    out = data;
+                    value = sum;
+                    return p;
+                }
+
+                __attribute__((target("avx2")))
+                inline const char* decode_avx2(const char* p, const char* end, int64_t*& out, int64_t& value) {
+                    // local copies, so they stay in registers
+                    int64_t* data = out;
+                    int64_t sum = value;
+                    while (end - p >= 32 + 8) {
+                        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+                        const uint32_t stops = ~static_cast<uint32_t>(_mm256_movemask_epi8(chunk));
+                        if ((stops & 0xffffu) == 0xffffu) {
+                            decode_bytes_avx2(_mm256_castsi256_si128(chunk), data, sum);
+                            p += 16;
+                            if (stops == 0xffffffffu) {
+                                decode_bytes_avx2(_mm256_extracti128_si256(chunk, 1), data, sum);
+                                p += 16;
+                            }
+                            continue;
+                        }
+                        if (stops == 0) {
+                            protozero::decode_varint(&p, end); // throws varint_too_long_exception
+                        }
+                        p = decode_chunk(p, end, stops, data, sum);
+                    }
+                    p = decode_scalar(p, end, data, sum);
+                    out = data;
+                    value = sum;
+                    return p;
+                }
+
+#endif
+
+            } // namespace varint
+
+            /**
+             * Use this decoder for all packed sint fields decoded from now
+             * on (in all threads). If the CPU does not support it, the
+             * best supported decoder is used.
+             */
+            inline void set_varint_decoder(varint_decoder decoder) noexcept {
+                varint::decoder_setting().store(static_cast<int>(decoder));
+            }
+
+            /**
+             * The decoder used for packed sint fields.
+             */
+            inline varint_decoder current_varint_decoder() noexcept {
+                const varint_decoder decoder = static_cast<varint_decoder>(varint::decoder_setting().load(std::memory_order_relaxed));
+                if (decoder == varint_decoder::automatic || !varint_decoder_supported(decoder)) {
+                    return varint::best_decoder();
+                }
+                return decoder;
+            }
+
+            /**
+             * Decodes a packed sint32 or sint64 field of delta encoded
+             * values (as the ids, coordinates and way node refs in PBF
+             * files): the varints are zigzag decoded and summed up. The
+             * SIMD decoders find the ends of the varints of a whole chunk
+             * (16 or 32 bytes) with one compare, decode the values and add
+             * up the deltas of the chunk before loading the next one. The
+             * values replace the contents of out.
+             *
+             * @throws protozero::end_of_buffer_exception if the last varint is cut off.
+             * @throws protozero::varint_too_long_exception if a varint is longer than 10 bytes.
+             */
+            inline void decode_packed_sint_delta(const char* begin, const char* end, std::vector<int64_t>& out,
+                                                 varint_decoder decoder = varint_decoder::automatic) {
+                out.resize(varint::count(begin, end));
+                if (out.empty()) {
+                    return;
+                }
+                if (decoder == varint_decoder::automatic) {
+                    decoder = current_varint_decoder();
+                } else if (!varint_decoder_supported(decoder)) {
+                    decoder = varint::best_decoder();
+                }
+                int64_t* data = out.data();
+                int64_t value = 0;
+                switch (decoder) {
+#ifdef OSMIUM_SIMD_VARINT
+                    case varint_decoder::avx2:
+                        varint::decode_avx2(begin, end, data, value);
+                        break;
+                    case varint_decoder::sse2:
+                        varint::decode_sse2(begin, end, data, value);
+                        break;
+#endif
+                    default:
+                        varint::decode_scalar(begin, end, data, value);
+                }
+            }
+
+        } // namespace detail
+
+    } // namespace io
+
+} // namespace osmium
+
+#endif // OSMIUM_IO_DETAIL_PBF_VARINT_HPP
@@ -34,8 +34,11 @@ DEALINGS IN THE SOFTWARE.
 */
 
 #include <algorithm>
+#include <condition_variable>
+#include <cstdint>
 #include <exception>
 #include <future>
+#include <mutex>
 #include <string>
 
 #include <osmium/memory/buffer.hpp>
@@ -73,6 +76,50 @@ namespace osmium {
              */
             using future_string_queue_type = osmium::thread::Queue<std::future<std::string>>;
 
+            /**
+             * Signals that data became ready: a future was added to a queue
+             * or the value of a future already in the queue was set. This
+             * allows a reader to wait for any of the futures it holds
+             * instead of the first one.
+             */
+            class ready_signal {
+
+                std::mutex m_mutex;
+                std::condition_variable m_ready;
+                uint64_t m_generation = 0;
+
+            public:
+
+                /**
+                 * The number of notifications so far. Take it before
+                 * checking the futures and wait() for a later one.
+                 */
+                uint64_t generation() {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    return m_generation;
+                }
+
+                void notify() {
+                    {
+                        std::lock_guard<std::mutex> lock(m_mutex);
+                        ++m_generation;
+                    }
+                    m_ready.notify_all();
+                }
+
+                /**
+                 * Wait until there was a notification after the given
+                 * generation.
+                 */
+                void wait(uint64_t generation) {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_ready.wait(lock, [this, generation] {
+                        return m_generation != generation;
+                    });
+                }
+
+            }; // class ready_signal
+
             template <typename T>
             inline void add_to_queue(osmium::thread::Queue<std::future<T>>& queue, T&& data) {
                 std::promise<T> promise;
@@ -133,6 +180,28 @@ namespace osmium {
                     return m_has_reached_end_of_data;
                 }
 
+                /**
+                 * Take the next future from the queue without waiting for
+                 * its data (to read the data out of order). If wait is
+                 * false, this returns false if the queue is empty. The
+                 * caller has to call set_reached_end_of_data() when it
+                 * gets the end of data from one of the futures.
+                 */
+                bool pop_future(std::future<T>& data_future, bool wait) {
+                    if (m_has_reached_end_of_data) {
+                        return false;
+                    }
+                    if (wait) {
+                        m_queue.wait_and_pop(data_future);
+                        return data_future.valid();
+                    }
+                    return m_queue.try_pop(data_future);
+                }
+
+                void set_reached_end_of_data() noexcept {
+                    m_has_reached_end_of_data = true;
+                }
+
                 T pop() {
                     T data;
                     if (!m_has_reached_end_of_data) {
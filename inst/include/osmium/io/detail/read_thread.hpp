@@ -34,6 +34,8 @@ DEALINGS IN THE SOFTWARE.
 */
 
 #include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <exception>
 #include <string>
 #include <thread>
@@ -41,6 +43,7 @@ DEALINGS IN THE SOFTWARE.
 
 #include <osmium/io/compression.hpp>
 #include <osmium/io/detail/queue_util.hpp>
+#include <osmium/io/read_options.hpp>
 #include <osmium/thread/util.hpp>
 
 namespace osmium {
@@ -53,29 +56,49 @@ namespace osmium {
              * This code uses an internally managed thread to read data from
              * the input file and (optionally) decompress it. The result is
              * sent to the given queue. Any exceptions will also be send to
-             * the queue.
+             * the queue. The bytes read and the time spent waiting for the
+             * input are counted, see statistics().
              */
             class ReadThreadManager {
 
+                typedef std::chrono::steady_clock clock;
+
                 // only used in the sub-thread
                 osmium::io::Decompressor& m_decompressor;
                 future_string_queue_type& m_queue;
 
                 // used in both threads
                 std::atomic<bool> m_done;
+                std::atomic<uint64_t> m_bytes;
+                std::atomic<uint64_t> m_reads;
+                std::atomic<int64_t> m_read_nanoseconds;
+                std::atomic<int64_t> m_nanoseconds;
+                std::atomic<read_cache> m_cache;
+                clock::time_point m_start;
 
                 // only used in the main thread
                 std::thread m_thread;
 
+                static int64_t nanoseconds(clock::time_point start, clock::time_point end) noexcept {
+                    return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+                }
+
                 void run_in_thread() {
                     osmium::thread::set_thread_name("_osmium_read");
 
                     try {
                         while (!m_done) {
+                            const auto read_start = clock::now();
                             std::string data {m_decompressor.read()};
+                            const auto read_end = clock::now();
+                            m_read_nanoseconds += nanoseconds(read_start, read_end);
+                            m_nanoseconds = nanoseconds(m_start, read_end);
+                            m_cache = m_decompressor.cache_mode();
                             if (at_end_of_data(data)) {
                                 break;
                             }
+                            m_bytes += data.size();
+                            ++m_reads;
                             add_to_queue(m_queue, std::move(data));
                         }
 
@@ -84,17 +107,28 @@ namespace osmium {
                         add_to_queue(m_queue, std::current_exception());
                     }
 
+                    m_nanoseconds = nanoseconds(m_start, clock::now());
+                    set_last_read_statistics(statistics());
                     add_end_of_data_to_queue(m_queue);
                 }
 
             public:
 
                 ReadThreadManager(osmium::io::Decompressor& decompressor,
-                                  future_string_queue_type& queue) :
+                                  future_string_queue_type& queue,
+                                  const read_options& options = default_read_options()) :
                     m_decompressor(decompressor),
                     m_queue(queue),
                     m_done(false),
-                    m_thread(std::thread(&ReadThreadManager::run_in_thread, this)) {
+                    m_bytes(0),
+                    m_reads(0),
+                    m_read_nanoseconds(0),
+                    m_nanoseconds(0),
+                    m_cache(read_cache::keep),
+                    m_start(clock::now()),
+                    m_thread() {
+                    m_decompressor.set_read_options(options);
+                    m_thread = std::thread(&ReadThreadManager::run_in_thread, this);
                 }
 
                 ReadThreadManager(const ReadThreadManager&) = delete;
@@ -122,6 +156,20 @@ namespace osmium {
                     }
                 }
 
+                /**
+                 * The statistics of the reads so far. Can be called while
+                 * the read thread is running.
+                 */
+                read_statistics statistics() const noexcept {
+                    read_statistics result;
+                    result.bytes = m_bytes;
+                    result.reads = m_reads;
+                    result.read_seconds = double(m_read_nanoseconds) / 1e9;
+                    result.seconds = double(m_nanoseconds) / 1e9;
+                    result.cache = m_cache;
+                    return result;
+                }
+
             }; // class ReadThreadManager
 
         } // namespace detail
@@ -0,0 +1,200 @@
+#ifndef OSMIUM_IO_READ_OPTIONS_HPP
+#define OSMIUM_IO_READ_OPTIONS_HPP
+
+/*
+
+This file is part of Osmium (http://osmcode.org/libosmium).
+
+Copyright 2013-2015 Jochen Topf <jochen@topf.org> and others (see README).
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+
+namespace osmium {
+
+    namespace io {
+
+        /**
+         * How reading an input file uses the page cache of the operating
+         * system.
+         */
+        enum class read_cache {
+            keep   = 0, ///< Data read stays in the page cache.
+            drop   = 1, ///< Data already read is dropped from the page cache (POSIX_FADV_DONTNEED).
+            direct = 2  ///< Reads bypass the page cache (O_DIRECT). Falls back to drop if not supported.
+        };
+
+        inline const char* read_cache_name(read_cache cache) noexcept {
+            switch (cache) {
+                case read_cache::drop:
+                    return "drop";
+                case read_cache::direct:
+                    return "direct";
+                default:
+                    break;
+            }
+            return "keep";
+        }
+
+        /**
+         * Options for reading the input file in the read thread. They
+         * are used when reading uncompressed files from disk, compressed
+         * files and input from pipes or URLs are read as before.
+         */
+        struct read_options {
+
+            static constexpr size_t min_read_size = 4 * 1024;
+            static constexpr size_t max_read_size = 1024 * 1024 * 1024;
+
+            /// Number of bytes requested from the file with each read.
+            size_t read_size = 1024 * 1024;
+
+            /**
+             * Tell the operating system that the file is read
+             * sequentially and ask it to fetch the next chunk while the
+             * current one is read (posix_fadvise with
+             * POSIX_FADV_SEQUENTIAL and POSIX_FADV_WILLNEED).
+             */
+            bool advise = true;
+
+            /**
+             * Double buffering: a helper thread, started once per file,
+             * reads the next chunk while the current one is passed on to
+             * the parser.
+             */
+            bool prefetch = false;
+
+            read_cache cache = read_cache::keep;
+
+            /**
+             * Check the options.
+             *
+             * @throws std::invalid_argument if the read size is out of range.
+             */
+            const read_options& check() const {
+                if (read_size < min_read_size || read_size > max_read_size) {
+                    throw std::invalid_argument("Read size must be between 4 KiB and 1 GiB");
+                }
+                return *this;
+            }
+
+        }; // struct read_options
+
+        /**
+         * Statistics of the read thread of a Reader.
+         */
+        struct read_statistics {
+
+            /// Bytes passed on to the parser (after decompression).
+            uint64_t bytes = 0;
+
+            /// Number of chunks read.
+            uint64_t reads = 0;
+
+            /// Time spent waiting for data from the input.
+            double read_seconds = 0.0;
+
+            /// Time since the read thread started (or until it ended).
+            double seconds = 0.0;
+
+            /// The page cache mode actually used.
+            read_cache cache = read_cache::keep;
+
+            /// Throughput of the reads alone in MiB/s.
+            double read_mb_per_second() const noexcept {
+                return read_seconds > 0 ? bytes / read_seconds / (1024.0 * 1024.0) : 0.0;
+            }
+
+            /// Throughput of the read thread in MiB/s, includes waiting for the parser.
+            double mb_per_second() const noexcept {
+                return seconds > 0 ? bytes / seconds / (1024.0 * 1024.0) : 0.0;
+            }
+
+        }; // struct read_statistics
+
+        namespace detail {
+
+            inline std::mutex& read_options_mutex() {
+                static std::mutex mutex;
+                return mutex;
+            }
+
+            inline read_options& default_read_options_instance() {
+                static read_options options;
+                return options;
+            }
+
+            inline read_statistics& last_read_statistics_instance() {
+                static read_statistics statistics;
+                return statistics;
+            }
+
+            inline void set_last_read_statistics(const read_statistics& statistics) {
+                std::lock_guard<std::mutex> lock(read_options_mutex());
+                last_read_statistics_instance() = statistics;
+            }
+
+        } // namespace detail
+
+        /**
+         * The read options used by Readers which are not given any.
+         */
+        inline read_options default_read_options() {
+            std::lock_guard<std::mutex> lock(detail::read_options_mutex());
+            return detail::default_read_options_instance();
+        }
+
+        /**
+         * Set the read options used by Readers created afterwards which
+         * are not given any.
+         *
+         * @throws std::invalid_argument if the options are invalid.
+         */
+        inline void set_default_read_options(const read_options& options) {
+            options.check();
+            std::lock_guard<std::mutex> lock(detail::read_options_mutex());
+            detail::default_read_options_instance() = options;
+        }
+
+        /**
+         * The statistics of the read thread of the Reader which finished
+         * reading last.
+         */
+        inline read_statistics last_read_statistics() {
+            std::lock_guard<std::mutex> lock(detail::read_options_mutex());
+            return detail::last_read_statistics_instance();
+        }
+
+    } // namespace io
+
+} // namespace osmium
+
+#endif // OSMIUM_IO_READ_OPTIONS_HPP
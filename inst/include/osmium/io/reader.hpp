@@ -33,8 +33,11 @@ DEALINGS IN THE SOFTWARE.
 
 */
 
+#include <cassert>
 #include <cerrno>
+#include <chrono>
 #include <cstdlib>
+#include <deque>
 #include <fcntl.h>
 #include <future>
 #include <memory>
@@ -59,6 +62,7 @@ DEALINGS IN THE SOFTWARE.
 #include <osmium/io/error.hpp>
 #include <osmium/io/file.hpp>
 #include <osmium/io/header.hpp>
+#include <osmium/io/read_options.hpp>
 #include <osmium/memory/buffer.hpp>
 #include <osmium/osm/entity_bits.hpp>
 #include <osmium/thread/util.hpp>
@@ -67,6 +71,20 @@ namespace osmium {
 
     namespace io {
 
+        /**
+         * Order in which Reader::read() returns the buffers.
+         */
+        enum class read_order {
+
+            /// In the order of the data in the file.
+            ordered   = 0,
+
+            /// As soon as they are decoded. Empty buffers are returned
+            /// too, so the sequence numbers have no gaps.
+            unordered = 1
+
+        }; // enum class read_order
+
         /**
          * This is the user-facing interface for reading OSM files. Instantiate
          * an object of this class with a file name or osmium::io::File object
@@ -99,6 +117,15 @@ namespace osmium {
             detail::future_buffer_queue_type m_osmdata_queue;
             detail::queue_wrapper<osmium::memory::Buffer> m_osmdata_queue_wrapper;
 
+            // Buffers taken out of the queue but not returned yet with their
+            // sequence numbers (only used for unordered reads)
+            std::shared_ptr<detail::ready_signal> m_ready_signal;
+            std::deque<std::pair<size_t, std::future<osmium::memory::Buffer>>> m_pending;
+            read_order m_read_order;
+            size_t m_next_sequence;
+            size_t m_sequence;
+            bool m_pending_end_of_data;
+
             std::future<osmium::io::Header> m_header_future;
             osmium::io::Header m_header;
 
@@ -108,14 +135,86 @@ namespace osmium {
             static void parser_thread(const osmium::io::File& file,
                                       detail::future_string_queue_type& input_queue,
                                       detail::future_buffer_queue_type& osmdata_queue,
+                                      std::shared_ptr<detail::ready_signal> ready_signal,
                                       std::promise<osmium::io::Header>&& header_promise,
                                       osmium::osm_entity_bits::type read_which_entities) {
                 std::promise<osmium::io::Header> promise = std::move(header_promise);
                 auto creator = detail::ParserFactory::instance().get_creator_function(file);
                 auto parser = creator(input_queue, osmdata_queue, promise, read_which_entities);
+                parser->set_ready_signal(ready_signal);
                 parser->parse();
             }
 
+            /**
+             * Get the data of a future taken out of the queue and remember
+             * if it is the end of data.
+             */
+            osmium::memory::Buffer get_pending(std::future<osmium::memory::Buffer>& future) {
+                osmium::memory::Buffer buffer = future.get();
+                if (detail::at_end_of_data(buffer)) {
+                    m_pending_end_of_data = true;
+                    m_osmdata_queue_wrapper.set_reached_end_of_data();
+                }
+                return buffer;
+            }
+
+            // The next buffer in file order
+            osmium::memory::Buffer read_in_order() {
+                if (m_pending.empty()) {
+                    m_sequence = m_next_sequence++;
+                    return m_osmdata_queue_wrapper.pop();
+                }
+                auto entry = std::move(m_pending.front());
+                m_pending.pop_front();
+                m_sequence = entry.first;
+                return get_pending(entry.second);
+            }
+
+            /**
+             * The first buffer which is ready. Up to max_osmdata_queue_size
+             * futures are taken out of the queue, if none of them is ready
+             * this waits until the parser or one of the decoding threads
+             * signals a new buffer. The end of data is only returned after
+             * all other buffers. As the parser fills the queue again, up to
+             * 2 * max_osmdata_queue_size decoded buffers can be held in
+             * memory (in m_pending and in the queue).
+             */
+            osmium::memory::Buffer read_any() {
+                // without the signal a buffer decoded on the pool would
+                // never wake up the wait below
+                assert(m_ready_signal);
+                while (true) {
+                    const uint64_t generation = m_ready_signal->generation();
+
+                    std::future<osmium::memory::Buffer> future;
+                    while (m_pending.size() < max_osmdata_queue_size && m_osmdata_queue_wrapper.pop_future(future, false)) {
+                        m_pending.emplace_back(m_next_sequence++, std::move(future));
+                    }
+
+                    for (auto it = m_pending.begin(); it != m_pending.end(); ++it) {
+                        if (it->second.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                            auto entry = std::move(*it);
+                            m_pending.erase(it);
+                            osmium::memory::Buffer buffer = get_pending(entry.second);
+                            if (detail::at_end_of_data(buffer)) {
+                                break;
+                            }
+                            m_sequence = entry.first;
+                            return buffer;
+                        }
+                    }
+
+                    if (m_pending.empty()) {
+                        if (m_pending_end_of_data || !m_osmdata_queue_wrapper.pop_future(future, true)) {
+                            return osmium::memory::Buffer{};
+                        }
+                        m_pending.emplace_back(m_next_sequence++, std::move(future));
+                    } else {
+                        m_ready_signal->wait(generation);
+                    }
+                }
+            }
+
 #ifndef _WIN32
             /**
              * Fork and execute the given command in the child.
@@ -196,8 +295,12 @@ namespace osmium {
              *                            should be read from the input file. It can speed the read up
              *                            significantly if objects that are not needed anyway are not
              *                            parsed.
+             * @param options How the input file is read (read size,
+             *                prefetching, page cache). By default the
+             *                options set with set_default_read_options()
+             *                are used.
              */
-            explicit Reader(const osmium::io::File& file, osmium::osm_entity_bits::type read_which_entities = osmium::osm_entity_bits::all) :
+            explicit Reader(const osmium::io::File& file, osmium::osm_entity_bits::type read_which_entities = osmium::osm_entity_bits::all, const read_options& options = default_read_options()) :
                 m_file(file.check()),
                 m_read_which_entities(read_which_entities),
                 m_status(status::okay),
@@ -206,23 +309,29 @@ namespace osmium {
                 m_decompressor(m_file.buffer() ?
                     osmium::io::CompressionFactory::instance().create_decompressor(file.compression(), m_file.buffer(), m_file.buffer_size()) :
                     osmium::io::CompressionFactory::instance().create_decompressor(file.compression(), open_input_file_or_url(m_file.filename(), &m_childpid))),
-                m_read_thread_manager(*m_decompressor, m_input_queue),
+                m_read_thread_manager(*m_decompressor, m_input_queue, options),
                 m_osmdata_queue(max_osmdata_queue_size, "parser_results"),
                 m_osmdata_queue_wrapper(m_osmdata_queue),
+                m_ready_signal(std::make_shared<detail::ready_signal>()),
+                m_pending(),
+                m_read_order(read_order::ordered),
+                m_next_sequence(0),
+                m_sequence(0),
+                m_pending_end_of_data(false),
                 m_header_future(),
                 m_header(),
                 m_thread() {
                 std::promise<osmium::io::Header> header_promise;
                 m_header_future = header_promise.get_future();
-                m_thread = osmium::thread::thread_handler{parser_thread, std::ref(m_file), std::ref(m_input_queue), std::ref(m_osmdata_queue), std::move(header_promise), read_which_entities};
+                m_thread = osmium::thread::thread_handler{parser_thread, std::ref(m_file), std::ref(m_input_queue), std::ref(m_osmdata_queue), m_ready_signal, std::move(header_promise), read_which_entities};
             }
 
-            explicit Reader(const std::string& filename, osmium::osm_entity_bits::type read_types = osmium::osm_entity_bits::all) :
-                Reader(osmium::io::File(filename), read_types) {
+            explicit Reader(const std::string& filename, osmium::osm_entity_bits::type read_types = osmium::osm_entity_bits::all, const read_options& options = default_read_options()) :
+                Reader(osmium::io::File(filename), read_types, options) {
             }
 
-            explicit Reader(const char* filename, osmium::osm_entity_bits::type read_types = osmium::osm_entity_bits::all) :
-                Reader(osmium::io::File(filename), read_types) {
+            explicit Reader(const char* filename, osmium::osm_entity_bits::type read_types = osmium::osm_entity_bits::all, const read_options& options = default_read_options()) :
+                Reader(osmium::io::File(filename), read_types, options) {
             }
 
             Reader(const Reader&) = delete;
@@ -252,6 +361,14 @@ namespace osmium {
 
                 m_read_thread_manager.stop();
 
+                while (!m_pending.empty()) {
+                    try {
+                        get_pending(m_pending.front().second);
+                    } catch (...) {
+                        // Ignore any exceptions.
+                    }
+                    m_pending.pop_front();
+                }
                 m_osmdata_queue_wrapper.drain();
 
                 try {
@@ -325,13 +442,13 @@ namespace osmium {
                     // without data is not an error, it just means we have to
                     // keep getting the next buffer until there is one with data.
                     while (true) {
-                        buffer = m_osmdata_queue_wrapper.pop();
+                        buffer = m_read_order == read_order::ordered ? read_in_order() : read_any();
                         if (detail::at_end_of_data(buffer)) {
                             m_status = status::eof;
                             m_read_thread_manager.close();
                             return buffer;
                         }
-                        if (buffer.committed() > 0) {
+                        if (buffer.committed() > 0 || m_read_order == read_order::unordered) {
                             return buffer;
                         }
                     }
@@ -342,6 +459,41 @@ namespace osmium {
                 }
             }
 
+            /**
+             * Set the order in which read() returns the buffers. With
+             * read_order::unordered a buffer is returned as soon as it is
+             * decoded, so a block which takes long to decode (e.g. with
+             * large relations) does not hold up the blocks after it. Use
+             * sequence() to put the buffers back into order if needed.
+             * The order can be changed at any time.
+             */
+            void set_read_order(read_order order) noexcept {
+                m_read_order = order;
+            }
+
+            read_order get_read_order() const noexcept {
+                return m_read_order;
+            }
+
+            /**
+             * The sequence number of the buffer returned by the last
+             * read(): the position of the buffer in the file, counting from
+             * 0. In ordered mode empty buffers are skipped, so there can
+             * be gaps.
+             */
+            size_t sequence() const noexcept {
+                return m_sequence;
+            }
+
+            /**
+             * Statistics of the read thread: the bytes read from the input
+             * (after decompression) and the time it took. Can be called
+             * while reading, the final numbers are available after close().
+             */
+            read_statistics statistics() const noexcept {
+                return m_read_thread_manager.statistics();
+            }
+
             /**
              * Has the end of file been reached? This is set after the last
              * data has been read. It is also set by calling close().
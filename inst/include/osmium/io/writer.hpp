@@ -166,6 +166,48 @@ namespace osmium {
                 options.sync = value;
             }
 
+            template <typename... TArgs>
+            static options_type make_options(const TArgs&... args) {
+                options_type options;
+                (void)std::initializer_list<int>{
+                    (set_option(options, args), 0)...
+                };
+                return options;
+            }
+
+            void start(std::unique_ptr<osmium::io::Compressor>&& compressor, const osmium::io::Header& header) {
+                std::promise<bool> write_promise;
+                m_write_future = write_promise.get_future();
+                m_thread = osmium::thread::thread_handler{write_thread, std::ref(m_output_queue), std::move(compressor), std::move(write_promise)};
+
+                ensure_cleanup([&](){
+                    m_output->write_header(header);
+                });
+            }
+
+            // Common part of the constructors. Without a compressor the
+            // file is opened. The options come first, so this is never
+            // confused with the public constructors.
+            Writer(const options_type& options, const osmium::io::File& file, std::unique_ptr<osmium::io::Compressor>&& compressor) :
+                m_file(file.check()),
+                m_output_queue(20, "raw_output"), // XXX
+                m_output(osmium::io::detail::OutputFormatFactory::instance().create_output(m_file, m_output_queue)),
+                m_buffer(),
+                m_buffer_size(default_buffer_size),
+                m_write_future(),
+                m_thread(),
+                m_status(status::okay) {
+                assert(!m_file.buffer()); // XXX can't handle pseudo-files
+
+                if (!compressor) {
+                    compressor = CompressionFactory::instance().create_compressor(m_file.compression(),
+                                                                                  osmium::io::detail::open_for_writing(m_file.filename(), options.allow_overwrite),
+                                                                                  options.sync);
+                }
+
+                start(std::move(compressor), options.header);
+            }
+
         public:
 
             /**
@@ -193,33 +235,25 @@ namespace osmium {
              */
             template <typename... TArgs>
             explicit Writer(const osmium::io::File& file, TArgs&&... args) :
-                m_file(file.check()),
-                m_output_queue(20, "raw_output"), // XXX
-                m_output(osmium::io::detail::OutputFormatFactory::instance().create_output(m_file, m_output_queue)),
-                m_buffer(),
-                m_buffer_size(default_buffer_size),
-                m_write_future(),
-                m_thread(),
-                m_status(status::okay) {
-                assert(!m_file.buffer()); // XXX can't handle pseudo-files
-
-                options_type options;
-                (void)std::initializer_list<int>{
-                    (set_option(options, args), 0)...
-                };
-
-                std::unique_ptr<osmium::io::Compressor> compressor =
-                    CompressionFactory::instance().create_compressor(file.compression(),
-                                                                     osmium::io::detail::open_for_writing(m_file.filename(), options.allow_overwrite),
-                                                                     options.sync);
-
-                std::promise<bool> write_promise;
-                m_write_future = write_promise.get_future();
-                m_thread = osmium::thread::thread_handler{write_thread, std::ref(m_output_queue), std::move(compressor), std::move(write_promise)};
+                Writer(make_options(args...), file, std::unique_ptr<osmium::io::Compressor>{}) {
+            }
 
-                ensure_cleanup([&](){
-                    m_output->write_header(options.header);
-                });
+            /**
+             * This constructor writes to the given compressor instead of
+             * opening the file, e.g. to write to an already open file
+             * descriptor or to a sink in memory. The file is only used for
+             * the format, the compressor has to do the compression (if any).
+             *
+             * @param file File with the format info.
+             * @param compressor Compressor the encoded data is written to
+             *                   by the write thread.
+             * @param args Optional osmium::io::Header (see above).
+             *
+             * @throws osmium::io_error If there was an error.
+             */
+            template <typename... TArgs>
+            Writer(const osmium::io::File& file, std::unique_ptr<osmium::io::Compressor>&& compressor, TArgs&&... args) :
+                Writer(make_options(args...), file, std::move(compressor)) {
             }
 
             template <typename... TArgs>
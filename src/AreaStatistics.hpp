@@ -0,0 +1,136 @@
+
+// Rosmium: R bindings for the Osmium library
+// Copyright (C) 2016 Lukas Huwiler
+//
+// This file is part of Rosmium.
+//
+// Rosmium is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Rosmium is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Rosmium.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef AREASTATISTICS_HPP
+#define AREASTATISTICS_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+#include <osmium/area/problem_reporter.hpp>
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/node_ref.hpp>
+#include <osmium/osm/types.hpp>
+
+// Number of problems reported by the area assembler, by type
+struct AreaProblemCounts {
+  uint64_t duplicate_nodes = 0;
+  uint64_t intersections = 0;
+  uint64_t open_rings = 0;
+  uint64_t role_should_be_outer = 0;
+  uint64_t role_should_be_inner = 0;
+  uint64_t duplicate_segments = 0;
+
+  uint64_t total() const {
+    return duplicate_nodes + intersections + open_rings + role_should_be_outer + role_should_be_inner + duplicate_segments;
+  }
+
+  void merge(const AreaProblemCounts& other) {
+    duplicate_nodes += other.duplicate_nodes;
+    intersections += other.intersections;
+    open_rings += other.open_rings;
+    role_should_be_outer += other.role_should_be_outer;
+    role_should_be_inner += other.role_should_be_inner;
+    duplicate_segments += other.duplicate_segments;
+  }
+};
+
+/**
+ * Problem reporter which only counts the problems. It is not thread safe
+ * (as no ProblemReporter is, because of set_object()), so every assembly
+ * task uses its own reporter and the counts are merged afterwards.
+ */
+class CountingProblemReporter : public osmium::area::ProblemReporter {
+public:
+
+  AreaProblemCounts counts;
+
+  void report_duplicate_node(osmium::object_id_type, osmium::object_id_type, osmium::Location) override {
+    ++counts.duplicate_nodes;
+  }
+
+  void report_intersection(osmium::object_id_type, osmium::Location, osmium::Location,
+                           osmium::object_id_type, osmium::Location, osmium::Location, osmium::Location) override {
+    ++counts.intersections;
+  }
+
+  void report_ring_not_closed(osmium::Location, osmium::Location) override {
+    ++counts.open_rings;
+  }
+
+  void report_role_should_be_outer(osmium::object_id_type, osmium::Location, osmium::Location) override {
+    ++counts.role_should_be_outer;
+  }
+
+  void report_role_should_be_inner(osmium::object_id_type, osmium::Location, osmium::Location) override {
+    ++counts.role_should_be_inner;
+  }
+
+  void report_duplicate_segment(const osmium::NodeRef&, const osmium::NodeRef&) override {
+    ++counts.duplicate_segments;
+  }
+};
+
+// Assembly of one multipolygon relation
+struct AreaAssemblyRecord {
+  osmium::object_id_type id;
+  uint32_t members;
+  uint32_t segments;
+  double extract_seconds;
+  double rings_seconds;
+  double build_seconds;
+  uint32_t problems;
+  // false if no area with rings could be built (e.g. open rings or missing locations)
+  bool valid;
+
+  double seconds() const {
+    return extract_seconds + rings_seconds + build_seconds;
+  }
+};
+
+/**
+ * Statistics of the area assembly: the problems of relations and closed
+ * ways, a record per relation and the totals for the closed ways (which are
+ * too many to keep a record for each).
+ */
+struct AreaAssemblyStats {
+  AreaProblemCounts problems;
+  std::vector<AreaAssemblyRecord> relations;
+  uint64_t ways = 0;
+  uint64_t valid_ways = 0;
+  double way_seconds = 0;
+
+  void merge(AreaAssemblyStats& other) {
+    problems.merge(other.problems);
+    relations.insert(relations.end(), other.relations.begin(), other.relations.end());
+    ways += other.ways;
+    valid_ways += other.valid_ways;
+    way_seconds += other.way_seconds;
+  }
+
+  // Slowest relations first
+  void sortByTime() {
+    std::stable_sort(relations.begin(), relations.end(), [](const AreaAssemblyRecord& a, const AreaAssemblyRecord& b) {
+      return a.seconds() > b.seconds();
+    });
+  }
+};
+
+#endif // AREASTATISTICS_HPP
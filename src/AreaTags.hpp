@@ -0,0 +1,92 @@
+
+// Rosmium: R bindings for the Osmium library
+// Copyright (C) 2016 Lukas Huwiler
+//
+// This file is part of Rosmium.
+//
+// Rosmium is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Rosmium is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Rosmium.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef AREATAGS_HPP
+#define AREATAGS_HPP
+
+#include <cstring>
+#include <osmium/osm/tag.hpp>
+#include <osmium/osm/way.hpp>
+
+// Keys whose presence makes a closed way an area (unless the value is listed in the exceptions below)
+static const char* const area_keys[] = {
+  "building", "building:part", "landuse", "leisure", "amenity", "natural", "place", "shop", "tourism",
+  "historic", "military", "aeroway", "office", "craft", "power", "public_transport", "boundary", "area:highway"
+};
+
+// Values of the area keys for which a closed way is usually a line
+static const char* const linear_exceptions[][2] = {
+  {"natural", "coastline"}, {"natural", "cliff"}, {"natural", "ridge"}, {"natural", "arete"},
+  {"natural", "tree_row"}, {"aeroway", "runway"}, {"aeroway", "taxiway"}, {"power", "line"},
+  {"power", "minor_line"}, {"power", "cable"}, {"leisure", "track"}, {"boundary", "administrative"}
+};
+
+// Key/value pairs which make a closed way an area although the key usually describes lines
+static const char* const area_values[][2] = {
+  {"waterway", "riverbank"}, {"waterway", "dock"}, {"waterway", "boatyard"}, {"waterway", "dam"},
+  {"highway", "services"}, {"highway", "rest_area"}, {"railway", "platform"}, {"railway", "station"},
+  {"man_made", "wastewater_plant"}, {"man_made", "water_works"}, {"man_made", "works"},
+  {"man_made", "pier"}, {"barrier", "city_wall"}
+};
+
+/**
+ * Decides by its tags whether a closed way describes an area (e.g. a
+ * building or a forest) or a line (e.g. a roundabout or a fence). An
+ * explicit area=yes/no tag always wins, otherwise the rules above, which
+ * follow the ones used by common OSM renderers, are applied.
+ */
+inline bool impliesArea(const osmium::TagList& tags) {
+  const char* area = tags.get_value_by_key("area");
+  if(area != nullptr) {
+    if(!std::strcmp(area, "yes")) {
+      return true;
+    }
+    if(!std::strcmp(area, "no")) {
+      return false;
+    }
+  }
+  for(const osmium::Tag& tag : tags) {
+    for(const char* key : area_keys) {
+      if(!std::strcmp(tag.key(), key)) {
+        bool is_line = !std::strcmp(tag.value(), "no");
+        for(const auto& exception : linear_exceptions) {
+          if(!std::strcmp(tag.key(), exception[0]) && !std::strcmp(tag.value(), exception[1])) {
+            is_line = true;
+          }
+        }
+        if(!is_line) {
+          return true;
+        }
+      }
+    }
+    for(const auto& pair : area_values) {
+      if(!std::strcmp(tag.key(), pair[0]) && !std::strcmp(tag.value(), pair[1])) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Closed way with enough nodes for a polygon and tags implying an area
+inline bool isAreaWay(const osmium::Way& way) {
+  return way.nodes().size() >= 4 && way.is_closed() && impliesArea(way.tags());
+}
+
+#endif // AREATAGS_HPP
@@ -0,0 +1,259 @@
+
+// Rosmium: R bindings for the Osmium library
+// Copyright (C) 2016 Lukas Huwiler
+//
+// This file is part of Rosmium.
+//
+// Rosmium is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Rosmium is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Rosmium.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef BLOBINDEX_HPP
+#define BLOBINDEX_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <sys/stat.h>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/entity_bits.hpp>
+#include <osmium/osm/item_type.hpp>
+#include <osmium/osm/object.hpp>
+#include <osmium/thread/pool.hpp>
+
+#include "PBFBlobReader.hpp"
+
+// Position of an object in a file sorted by type and id (osmium orders the ids by their absolute value)
+typedef std::pair<int, osmium::unsigned_object_id_type> ObjectKey;
+
+inline ObjectKey objectKey(osmium::item_type type, osmium::object_id_type id) {
+  return ObjectKey(static_cast<int>(type), static_cast<osmium::unsigned_object_id_type>(id < 0 ? -id : id));
+}
+
+/**
+ * The data blobs of an uncompressed PBF file sorted by type and id, with
+ * the range of objects (first and last type and id) of every blob. The
+ * ranges are only known for the blobs decoded so far: looking up an id is
+ * a binary search over the blobs which decodes the blobs it probes the
+ * first time. The index is kept by the reader, so later lookups in the
+ * same file decode fewer blobs.
+ */
+class BlobIndex {
+public:
+
+  // Blobs decoded since the index was created (to find ranges or objects)
+  uint64_t decoded = 0;
+
+  explicit BlobIndex(const std::string& filename) :
+    mFilename(filename),
+    mReader(filename) {
+    stat(filename, mSize, mTime);
+    PBFBlob blob;
+    while(mReader.skip(blob)) {
+      mBlobs.push_back(BlobRange{blob.offset, false, ObjectKey(), ObjectKey()});
+    }
+  }
+
+  // Whether the index still describes the file
+  bool matches(const std::string& filename) const {
+    uint64_t size;
+    int64_t time;
+    return filename == mFilename && stat(filename, size, time) && size == mSize && time == mTime;
+  }
+
+  size_t blobs() const {
+    return mBlobs.size();
+  }
+
+  size_t knownRanges() const {
+    size_t known = 0;
+    for(const BlobRange& blob : mBlobs) {
+      known += blob.known;
+    }
+    return known;
+  }
+
+  /**
+   * Calls callback(object) for every object of the type with one of the
+   * ids (sorted and unique), in file order. Only the blobs
+   * holding these ids are decoded (on the osmium thread pool), apart from
+   * the ones probed to find them. All versions of an object are passed on.
+   */
+  template <typename TCallback>
+  void fetch(osmium::item_type type, const std::vector<osmium::object_id_type>& ids, TCallback callback) {
+    static const size_t max_pending = 16;
+
+    std::vector<ObjectKey> keys;
+    keys.reserve(ids.size());
+    for(osmium::object_id_type id : ids) {
+      keys.push_back(objectKey(type, id));
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<size_t> targets;
+    size_t lower = 0;
+    for(const ObjectKey& key : keys) {
+      size_t found;
+      if(!locate(key, lower, found)) {
+        continue;
+      }
+      lower = found;
+      // Versions of the object (in a history file) can start in the blobs before
+      size_t first = found;
+      while(first > 0 && range(first).first == key && range(first - 1).second >= key) {
+        --first;
+      }
+      // and continue in the blobs after
+      size_t last = found;
+      while(last + 1 < mBlobs.size() && range(last).second == key && range(last + 1).first == key) {
+        ++last;
+      }
+      for(size_t blob = first; blob <= last; ++blob) {
+        addTarget(targets, blob);
+      }
+    }
+
+    auto harvest = [type, &ids, &callback](const osmium::memory::Buffer& buffer) {
+      for(auto it = buffer.begin<osmium::OSMObject>(); it != buffer.end<osmium::OSMObject>(); ++it) {
+        if(it->type() == type && std::binary_search(ids.begin(), ids.end(), it->id())) {
+          callback(*it);
+        }
+      }
+    };
+
+    std::deque<std::future<osmium::memory::Buffer>> pending;
+    size_t next = 0;
+    while(next < targets.size() || !pending.empty()) {
+      while(next < targets.size() && pending.size() < max_pending) {
+        pending.push_back(submit(targets[next++]));
+      }
+      osmium::memory::Buffer buffer = pending.front().get();
+      pending.pop_front();
+      harvest(buffer);
+    }
+    mCache.clear();
+  }
+
+private:
+  struct BlobRange {
+    uint64_t offset;
+    bool known;
+    ObjectKey first;
+    ObjectKey last;
+  };
+
+  // Decoded blobs kept between the search for the blobs and reading them
+  static const size_t max_cached = 16;
+
+  std::string mFilename;
+  PBFBlobReader mReader;
+  uint64_t mSize = 0;
+  int64_t mTime = 0;
+  std::vector<BlobRange> mBlobs;
+  std::deque<std::pair<size_t, osmium::memory::Buffer>> mCache;
+
+  static bool stat(const std::string& filename, uint64_t& size, int64_t& time) {
+    struct stat info;
+    if(::stat(filename.c_str(), &info) != 0) {
+      return false;
+    }
+    size = static_cast<uint64_t>(info.st_size);
+    time = static_cast<int64_t>(info.st_mtime);
+    return true;
+  }
+
+  static void addTarget(std::vector<size_t>& targets, size_t blob) {
+    if(targets.empty() || targets.back() < blob) {
+      targets.push_back(blob);
+    }
+  }
+
+  std::string read(size_t blob) {
+    PBFBlob data;
+    mReader.seek(mBlobs[blob].offset);
+    if(!mReader.next(data)) {
+      throw osmium::pbf_error("blob at offset " + std::to_string(mBlobs[blob].offset) + " is missing");
+    }
+    ++decoded;
+    return std::move(data.data);
+  }
+
+  // A cached blob as ready future, else the blob decoded on the thread pool
+  std::future<osmium::memory::Buffer> submit(size_t blob) {
+    for(auto it = mCache.begin(); it != mCache.end(); ++it) {
+      if(it->first == blob) {
+        std::promise<osmium::memory::Buffer> cached;
+        cached.set_value(std::move(it->second));
+        mCache.erase(it);
+        return cached.get_future();
+      }
+    }
+    return osmium::thread::Pool::instance().submit(
+      osmium::io::detail::PBFDataBlobDecoder(read(blob), osmium::osm_entity_bits::nwr));
+  }
+
+  // First and last object of a blob, decoded if not known yet
+  const std::pair<ObjectKey, ObjectKey> range(size_t blob) {
+    BlobRange& entry = mBlobs[blob];
+    if(!entry.known) {
+      osmium::memory::Buffer buffer = osmium::io::detail::PBFDataBlobDecoder(read(blob), osmium::osm_entity_bits::nwr)();
+      auto it = buffer.begin<osmium::OSMObject>();
+      if(it == buffer.end<osmium::OSMObject>()) {
+        throw osmium::pbf_error("empty data blob at offset " + std::to_string(entry.offset));
+      }
+      entry.first = objectKey(it->type(), it->id());
+      for(; it != buffer.end<osmium::OSMObject>(); ++it) {
+        const ObjectKey key = objectKey(it->type(), it->id());
+        if(key < entry.last) {
+          throw std::runtime_error(mFilename + " is not sorted by type and id");
+        }
+        entry.last = key;
+      }
+      entry.known = true;
+      if(mCache.size() == max_cached) {
+        mCache.pop_front();
+      }
+      mCache.emplace_back(blob, std::move(buffer));
+    }
+    return std::make_pair(entry.first, entry.last);
+  }
+
+  // The blob which holds the key (the last one starting at or before it), searching from blob lower
+  bool locate(const ObjectKey& key, size_t lower, size_t& found) {
+    if(lower >= mBlobs.size() || key < range(lower).first) {
+      return false;
+    }
+    if(key <= range(lower).second) {
+      found = lower;
+      return true;
+    }
+    size_t low = lower;
+    size_t high = mBlobs.size();
+    while(high - low > 1) {
+      const size_t middle = low + (high - low) / 2;
+      if(range(middle).first <= key) {
+        low = middle;
+      } else {
+        high = middle;
+      }
+    }
+    found = low;
+    return key <= range(low).second;
+  }
+};
+
+#endif // BLOBINDEX_HPP
@@ -0,0 +1,300 @@
+
+// Rosmium: R bindings for the Osmium library
+// Copyright (C) 2016 Lukas Huwiler
+//
+// This file is part of Rosmium.
+//
+// Rosmium is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Rosmium is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Rosmium.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef CHANGESETSTATS_HPP
+#define CHANGESETSTATS_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <osmium/handler.hpp>
+#include <osmium/osm/box.hpp>
+#include <osmium/osm/changeset.hpp>
+#include <osmium/osm/timestamp.hpp>
+
+// Totals of a group of changesets (of a user, a time window or a hashtag)
+struct ChangesetGroup {
+  uint64_t changesets = 0;
+  uint64_t changes = 0;
+  uint64_t comments = 0;
+  osmium::Timestamp first = osmium::end_of_time();
+  osmium::Timestamp last = osmium::start_of_time();
+  // Union of the bounding boxes of the changesets
+  osmium::Box bounds;
+
+  void add(const osmium::Changeset& changeset) {
+    ++changesets;
+    changes += changeset.num_changes();
+    comments += changeset.num_comments();
+    if(changeset.created_at().valid()) {
+      first = std::min(first, changeset.created_at());
+      last = std::max(last, changeset.created_at());
+    }
+    if(changeset.bounds().valid()) {
+      bounds.extend(changeset.bounds());
+    }
+  }
+
+  void merge(const ChangesetGroup& other) {
+    changesets += other.changesets;
+    changes += other.changes;
+    comments += other.comments;
+    first = std::min(first, other.first);
+    last = std::max(last, other.last);
+    if(other.bounds.valid()) {
+      bounds.extend(other.bounds);
+    }
+  }
+};
+
+struct UserGroup : ChangesetGroup {
+  std::string name;
+};
+
+struct HashtagGroup : ChangesetGroup {
+  std::unordered_set<osmium::user_id_type> users;
+};
+
+// A changeset selected by the bounding box filter
+struct ChangesetRecord {
+  osmium::changeset_id_type id;
+  osmium::user_id_type uid;
+  std::string user;
+  osmium::Timestamp created_at;
+  osmium::Timestamp closed_at;
+  uint32_t changes;
+  osmium::Box bounds;
+  std::string comment;
+};
+
+/**
+ * Hashtags (#word) of a changeset comment and of the hashtags tag (which
+ * lists them separated by semicolons) in lower case, without duplicates.
+ * Letters, digits, '_', '-' and all non-ASCII bytes (UTF-8 letters) belong
+ * to a hashtag.
+ */
+inline std::vector<std::string> changesetHashtags(const osmium::TagList& tags) {
+  std::vector<std::string> hashtags;
+  auto add = [&hashtags](std::string hashtag) {
+    std::transform(hashtag.begin(), hashtag.end(), hashtag.begin(), [](char c) {
+      return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+    });
+    if(hashtag.size() > 1 && std::find(hashtags.begin(), hashtags.end(), hashtag) == hashtags.end()) {
+      hashtags.push_back(hashtag);
+    }
+  };
+  auto is_word = [](char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-' ||
+           static_cast<unsigned char>(c) >= 0x80;
+  };
+  for(const char* key : {"comment", "hashtags"}) {
+    const char* value = tags.get_value_by_key(key);
+    if(value == nullptr) {
+      continue;
+    }
+    for(const char* it = value; *it; ++it) {
+      if(*it != '#') {
+        continue;
+      }
+      const char* end = it + 1;
+      while(*end && is_word(*end)) {
+        ++end;
+      }
+      add(std::string(it, end));
+      it = end - 1;
+    }
+  }
+  return hashtags;
+}
+
+/**
+ * Aggregates changesets by user, by time window (day, week starting on
+ * Monday, month or year, in UTC) and by hashtag. With a bounding box only
+ * the changesets whose bounds intersect it are aggregated, and these are
+ * also kept individually. Copies can be merged, so the handler can be used
+ * with parallel_apply().
+ */
+class ChangesetHandler : public osmium::handler::Handler {
+public:
+
+  ChangesetHandler(const std::string& window) :
+    mWindow(parseWindow(window)) {
+  }
+
+  void setBox(double min_lon, double min_lat, double max_lon, double max_lat) {
+    // The Box constructor asserts the order of the corners
+    if(!(std::isfinite(min_lon) && std::isfinite(min_lat) && std::isfinite(max_lon) && std::isfinite(max_lat)) ||
+       min_lon > max_lon || min_lat > max_lat) {
+      throw std::invalid_argument("Invalid bounding box");
+    }
+    const osmium::Box box(min_lon, min_lat, max_lon, max_lat);
+    if(!box.valid()) {
+      throw std::invalid_argument("Invalid bounding box");
+    }
+    mBox = box;
+  }
+
+  void changeset(const osmium::Changeset& changeset) {
+    if(mBox.valid() && !intersects(changeset.bounds(), mBox)) {
+      return;
+    }
+    UserGroup& user = mUsers[changeset.uid()];
+    if(user.changesets == 0) {
+      user.name = changeset.user();
+    }
+    user.add(changeset);
+    if(changeset.created_at().valid()) {
+      mWindows[windowStart(changeset.created_at())].add(changeset);
+    }
+    for(const std::string& hashtag : changesetHashtags(changeset.tags())) {
+      HashtagGroup& group = mHashtags[hashtag];
+      group.add(changeset);
+      group.users.insert(changeset.uid());
+    }
+    if(mBox.valid()) {
+      const char* comment = changeset.tags().get_value_by_key("comment");
+      mSelected.push_back({changeset.id(), changeset.uid(), changeset.user(), changeset.created_at(),
+                           changeset.closed_at(), changeset.num_changes(), changeset.bounds(),
+                           comment != nullptr ? comment : ""});
+    }
+  }
+
+  void merge(const ChangesetHandler& other) {
+    for(const auto& user : other.mUsers) {
+      UserGroup& group = mUsers[user.first];
+      if(group.changesets == 0) {
+        group.name = user.second.name;
+      }
+      group.merge(user.second);
+    }
+    for(const auto& window : other.mWindows) {
+      mWindows[window.first].merge(window.second);
+    }
+    for(const auto& hashtag : other.mHashtags) {
+      HashtagGroup& group = mHashtags[hashtag.first];
+      group.merge(hashtag.second);
+      group.users.insert(hashtag.second.users.begin(), hashtag.second.users.end());
+    }
+    mSelected.insert(mSelected.end(), other.mSelected.begin(), other.mSelected.end());
+  }
+
+  // Clears the results, the window and the bounding box are kept
+  void clear() {
+    mUsers.clear();
+    mWindows.clear();
+    mHashtags.clear();
+    mSelected.clear();
+  }
+
+  const std::unordered_map<osmium::user_id_type, UserGroup>& users() const {
+    return mUsers;
+  }
+
+  const std::map<time_t, ChangesetGroup>& windows() const {
+    return mWindows;
+  }
+
+  const std::unordered_map<std::string, HashtagGroup>& hashtags() const {
+    return mHashtags;
+  }
+
+  // The changesets intersecting the bounding box, by id
+  std::vector<ChangesetRecord>& selected() {
+    std::sort(mSelected.begin(), mSelected.end(), [](const ChangesetRecord& a, const ChangesetRecord& b) {
+      return a.id < b.id;
+    });
+    return mSelected;
+  }
+
+private:
+  enum class Window {
+    day,
+    week,
+    month,
+    year
+  };
+
+  Window mWindow;
+  osmium::Box mBox;
+  std::unordered_map<osmium::user_id_type, UserGroup> mUsers;
+  std::map<time_t, ChangesetGroup> mWindows;
+  std::unordered_map<std::string, HashtagGroup> mHashtags;
+  std::vector<ChangesetRecord> mSelected;
+
+  static Window parseWindow(const std::string& window) {
+    if(window == "day") {
+      return Window::day;
+    } else if(window == "week") {
+      return Window::week;
+    } else if(window == "month") {
+      return Window::month;
+    } else if(window == "year") {
+      return Window::year;
+    }
+    throw std::invalid_argument("Unknown time window: " + window + " (use day, week, month or year)");
+  }
+
+  static bool intersects(const osmium::Box& a, const osmium::Box& b) {
+    return a.valid() &&
+           a.bottom_left().x() <= b.top_right().x() && b.bottom_left().x() <= a.top_right().x() &&
+           a.bottom_left().y() <= b.top_right().y() && b.bottom_left().y() <= a.top_right().y();
+  }
+
+  // Start of the window containing the timestamp (UTC)
+  time_t windowStart(const osmium::Timestamp& timestamp) const {
+    static const time_t day = 24 * 60 * 60;
+    const time_t seconds = timestamp.seconds_since_epoch();
+    switch(mWindow) {
+      case Window::day:
+        return seconds - seconds % day;
+      case Window::week: {
+        // 1970-01-01 was a Thursday, so Mondays are 4 days later
+        const time_t days = seconds / day;
+        return (days - (days + 3) % 7) * day;
+      }
+      default: {
+        struct tm tm;
+#ifndef _WIN32
+        gmtime_r(&seconds, &tm);
+#else
+        gmtime_s(&tm, &seconds);
+#endif
+        tm.tm_mday = 1;
+        tm.tm_hour = tm.tm_min = tm.tm_sec = 0;
+        if(mWindow == Window::year) {
+          tm.tm_mon = 0;
+        }
+#ifndef _WIN32
+        return timegm(&tm);
+#else
+        return _mkgmtime(&tm);
+#endif
+      }
+    }
+  }
+};
+
+#endif // CHANGESETSTATS_HPP
@@ -0,0 +1,274 @@
+
+// Rosmium: R bindings for the Osmium library
+// Copyright (C) 2016 Lukas Huwiler
+//
+// This file is part of Rosmium.
+//
+// Rosmium is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Rosmium is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Rosmium.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <sys/stat.h>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/entity_bits.hpp>
+#include <osmium/thread/pool.hpp>
+#include <osmium/visitor.hpp>
+
+#include "PBFBlobReader.hpp"
+
+// Serializes the state of a handler (in native byte order, checkpoints are not meant to be moved between machines)
+class StateWriter {
+public:
+
+  template <typename T>
+  void write(const T& value) {
+    static_assert(std::is_pod<T>::value, "only plain values can be written");
+    mData.append(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  void write(const std::string& value) {
+    write(static_cast<uint64_t>(value.size()));
+    mData.append(value);
+  }
+
+  const std::string& data() const {
+    return mData;
+  }
+
+private:
+  std::string mData;
+};
+
+class StateReader {
+public:
+
+  explicit StateReader(const std::string& data) :
+    mData(data) {
+  }
+
+  template <typename T>
+  T read() {
+    static_assert(std::is_pod<T>::value, "only plain values can be read");
+    T value;
+    std::memcpy(&value, take(sizeof(T)), sizeof(T));
+    return value;
+  }
+
+  std::string readString() {
+    const size_t size = static_cast<size_t>(read<uint64_t>());
+    return std::string(take(size), size);
+  }
+
+private:
+  const std::string& mData;
+  size_t mPosition = 0;
+
+  const char* take(size_t size) {
+    if(size > mData.size() - mPosition) {
+      throw std::runtime_error("Checkpoint is truncated");
+    }
+    const char* data = mData.data() + mPosition;
+    mPosition += size;
+    return data;
+  }
+};
+
+/**
+ * A checkpoint file: the offset of the first blob not processed yet and
+ * the state of the handler after all blobs before it. It is bound to the
+ * input file (by size and modification time), the handler type and the
+ * entities read, so it is never applied to another job. The file is
+ * replaced atomically, so a job killed while writing it keeps the previous
+ * checkpoint.
+ */
+class Checkpoint {
+public:
+
+  Checkpoint(const std::string& filename, const std::string& input, const std::string& handler,
+             osmium::osm_entity_bits::type entities) :
+    mFilename(filename),
+    mHandler(handler),
+    mEntities(static_cast<uint32_t>(entities)) {
+    struct stat info;
+    if(::stat(input.c_str(), &info) != 0) {
+      throw std::runtime_error("Can not read " + input);
+    }
+    mInputSize = static_cast<uint64_t>(info.st_size);
+    mInputTime = static_cast<int64_t>(info.st_mtime);
+  }
+
+  // Reads the checkpoint if there is one, false if the job starts from the beginning
+  bool load(uint64_t& offset, std::string& state) const {
+    std::ifstream in(mFilename, std::ios::binary);
+    if(!in) {
+      return false;
+    }
+    const std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    StateReader reader(data);
+    std::string header;
+    try {
+      header = reader.readString();
+    } catch(std::runtime_error&) {
+    }
+    if(header != magic) {
+      throw std::runtime_error(mFilename + " is not a checkpoint file");
+    }
+    const uint64_t input_size = reader.read<uint64_t>();
+    const int64_t input_time = reader.read<int64_t>();
+    if(input_size != mInputSize || input_time != mInputTime) {
+      throw std::runtime_error("The input file changed since the checkpoint " + mFilename + " was written");
+    }
+    if(reader.readString() != mHandler || reader.read<uint32_t>() != mEntities) {
+      throw std::runtime_error("The checkpoint " + mFilename + " belongs to another handler or entity selection");
+    }
+    offset = reader.read<uint64_t>();
+    state = reader.readString();
+    return true;
+  }
+
+  void save(uint64_t offset, const std::string& state) const {
+    StateWriter writer;
+    writer.write(std::string(magic));
+    writer.write(mInputSize);
+    writer.write(mInputTime);
+    writer.write(mHandler);
+    writer.write(mEntities);
+    writer.write(offset);
+    writer.write(state);
+    const std::string temporary = mFilename + ".tmp";
+    {
+      std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+      out.write(writer.data().data(), static_cast<std::streamsize>(writer.data().size()));
+      out.close();
+      if(!out) {
+        throw std::runtime_error("Can not write the checkpoint " + temporary);
+      }
+    }
+#ifdef _WIN32
+    // rename() does not replace an existing file on Windows
+    std::remove(mFilename.c_str());
+#endif
+    if(std::rename(temporary.c_str(), mFilename.c_str()) != 0) {
+      throw std::runtime_error("Can not replace the checkpoint " + mFilename);
+    }
+  }
+
+  void remove() const {
+    std::remove(mFilename.c_str());
+  }
+
+private:
+  static constexpr const char* magic = "Rosmium checkpoint 1";
+
+  std::string mFilename;
+  std::string mHandler;
+  uint32_t mEntities;
+  uint64_t mInputSize;
+  int64_t mInputTime;
+};
+
+struct CheckpointProgress {
+  // Offset the scan continued at, 0 if it started from the beginning
+  uint64_t resumed_from = 0;
+  uint64_t blobs = 0;
+  uint64_t checkpoints = 0;
+};
+
+/**
+ * Applies the handler to a PBF file blob by blob and saves a checkpoint
+ * (with the handler's save()) whenever interval seconds have passed since
+ * the last one. If the checkpoint file exists, the handler state is
+ * restored with load() and the scan continues after the last blob it
+ * covers. The blobs are decoded on the osmium thread pool, the handler is
+ * called on this thread in file order.
+ *
+ * after_blob() is called after every blob (e.g. to check for an interrupt
+ * or the memory budget). If it throws, the state is consistent, so a last
+ * checkpoint is saved before the exception is passed on. When the scan
+ * completes, the checkpoint is removed.
+ */
+template <typename THandler, typename TCallback>
+CheckpointProgress checkpointedApply(const std::string& filename, osmium::osm_entity_bits::type entities,
+                                     THandler& handler, const Checkpoint& checkpoint, double interval,
+                                     TCallback after_blob) {
+  typedef std::chrono::steady_clock clock_type;
+  static const size_t max_pending = 16;
+
+  CheckpointProgress progress;
+  PBFBlobReader reader(filename);
+  std::string state;
+  uint64_t offset = 0;
+  if(checkpoint.load(offset, state)) {
+    StateReader state_reader(state);
+    handler.load(state_reader);
+    reader.seek(offset);
+    progress.resumed_from = offset;
+  }
+
+  auto save = [&handler, &checkpoint, &progress](uint64_t done) {
+    StateWriter state_writer;
+    handler.save(state_writer);
+    checkpoint.save(done, state_writer.data());
+    ++progress.checkpoints;
+  };
+
+  std::deque<std::pair<uint64_t, std::future<osmium::memory::Buffer>>> pending;
+  clock_type::time_point last_save = clock_type::now();
+  PBFBlob blob;
+  bool more = true;
+  while(true) {
+    while(more && pending.size() < max_pending) {
+      more = reader.next(blob);
+      if(more) {
+        pending.emplace_back(blob.end(), osmium::thread::Pool::instance().submit(
+          osmium::io::detail::PBFDataBlobDecoder(std::move(blob.data), entities)));
+      }
+    }
+    if(pending.empty()) {
+      break;
+    }
+    osmium::memory::Buffer buffer = pending.front().second.get();
+    const uint64_t done = pending.front().first;
+    pending.pop_front();
+    osmium::apply(buffer, handler);
+    ++progress.blobs;
+    try {
+      after_blob();
+    } catch(...) {
+      save(done);
+      throw;
+    }
+    if(std::chrono::duration<double>(clock_type::now() - last_save).count() >= interval) {
+      save(done);
+      last_save = clock_type::now();
+    }
+  }
+  checkpoint.remove();
+  return progress;
+}
+
+#endif // CHECKPOINT_HPP
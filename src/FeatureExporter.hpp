@@ -0,0 +1,430 @@
+
+// Rosmium: R bindings for the Osmium library
+// Copyright (C) 2016 Lukas Huwiler
+//
+// This file is part of Rosmium.
+//
+// Rosmium is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Rosmium is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Rosmium.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef FEATUREEXPORTER_HPP
+#define FEATUREEXPORTER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <osmium/area/assembler.hpp>
+#include <osmium/geom/geojson.hpp>
+#include <osmium/geom/wkt.hpp>
+#include <osmium/io/any_compression.hpp>
+#include <osmium/io/compression.hpp>
+#include <osmium/io/detail/read_write.hpp>
+#include <osmium/io/file.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/area.hpp>
+#include <osmium/osm/entity_bits.hpp>
+#include <osmium/osm/node.hpp>
+#include <osmium/osm/way.hpp>
+#include <osmium/thread/pool.hpp>
+
+#include "object_filter/command.h"
+#include "AreaTags.hpp"
+#include "GeometryCheck.hpp"
+
+// Appends a JSON string literal (with quotes) to out
+inline void appendJsonString(std::string& out, const char* str) {
+  out += '"';
+  for(; *str; ++str) {
+    const char c = *str;
+    switch(c) {
+      case '"': out += "\\\""; break;
+      case '\\': out += "\\\\"; break;
+      case '\n': out += "\\n"; break;
+      case '\r': out += "\\r"; break;
+      case '\t': out += "\\t"; break;
+      default:
+        if(static_cast<unsigned char>(c) < 0x20) {
+          char escaped[8];
+          std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+          out += escaped;
+        } else {
+          out += c;
+        }
+    }
+  }
+  out += '"';
+}
+
+// Appends a CSV field, quoted if necessary (RFC 4180), or a TSV field with tabs and line breaks replaced by spaces
+inline void appendDelimitedField(std::string& out, const char* str, char separator) {
+  if(separator == '\t') {
+    for(; *str; ++str) {
+      out += (*str == '\t' || *str == '\n' || *str == '\r') ? ' ' : *str;
+    }
+    return;
+  }
+  bool quote = false;
+  for(const char* it = str; *it; ++it) {
+    if(*it == separator || *it == '"' || *it == '\n' || *it == '\r') {
+      quote = true;
+      break;
+    }
+  }
+  if(!quote) {
+    out += str;
+    return;
+  }
+  out += '"';
+  for(; *str; ++str) {
+    if(*str == '"') {
+      out += '"';
+    }
+    out += *str;
+  }
+  out += '"';
+}
+
+struct ExportOptions {
+  enum class Format {
+    geojsonseq,
+    csv,
+    tsv
+  };
+
+  Format format = Format::geojsonseq;
+  // Tag keys written as properties or columns, all tags (GeoJSON only) if empty
+  std::vector<std::string> columns;
+  // Object types exported: nodes as points, ways as linestrings, areas as multipolygons
+  osmium::osm_entity_bits::type types = osmium::osm_entity_bits::nwr;
+  // Areas are built from closed ways with area tags (instead of being assembled by a collector)
+  bool way_areas = false;
+
+  static Format parseFormat(const std::string& format) {
+    if(format == "geojsonseq") {
+      return Format::geojsonseq;
+    } else if(format == "csv") {
+      return Format::csv;
+    } else if(format == "tsv") {
+      return Format::tsv;
+    }
+    throw std::invalid_argument("Unknown export format: " + format + " (use geojsonseq, csv or tsv)");
+  }
+
+  char separator() const {
+    return format == Format::tsv ? '\t' : ',';
+  }
+
+  // Closed ways with area tags are written as areas instead of linestrings
+  bool isWayArea(const osmium::Way& way) const {
+    return way_areas && (types & osmium::osm_entity_bits::area) && isAreaWay(way);
+  }
+};
+
+struct FormattedBlock {
+  std::string data;
+  uint64_t features = 0;
+  uint64_t invalid_geometries = 0;
+};
+
+/**
+ * Formats the features of one buffer: a GeoJSON text sequence record (RFC
+ * 8142, starting with the record separator) or a CSV/TSV row with the
+ * geometry as WKT. Objects whose geometry can not be built are skipped and
+ * counted.
+ */
+class FeatureFormatter {
+public:
+
+  explicit FeatureFormatter(const ExportOptions& options) :
+    mOptions(options),
+    mScratch(1024, osmium::memory::Buffer::auto_grow::yes) {
+  }
+
+  void format(const osmium::OSMObject& object, FormattedBlock& block) {
+    switch(object.type()) {
+      case osmium::item_type::node:
+        if(!check(checkPoint(static_cast<const osmium::Node&>(object)), block)) {
+          return;
+        }
+        if(mOptions.format == ExportOptions::Format::geojsonseq) {
+          mGeoJSON.create_point(static_cast<const osmium::Node&>(object), mGeometry);
+        } else {
+          mWKT.create_point(static_cast<const osmium::Node&>(object), mGeometry);
+        }
+        feature('n', object.id(), object, block);
+        break;
+      case osmium::item_type::way: {
+        const osmium::Way& way = static_cast<const osmium::Way&>(object);
+        if(mOptions.isWayArea(way)) {
+          formatWayArea(way, block);
+          return;
+        }
+        if(!check(checkLinestring(way), block)) {
+          return;
+        }
+        if(mOptions.format == ExportOptions::Format::geojsonseq) {
+          mGeoJSON.create_linestring(way, mGeometry);
+        } else {
+          mWKT.create_linestring(way, mGeometry);
+        }
+        feature('w', way.id(), way, block);
+        break;
+      }
+      case osmium::item_type::area:
+        formatArea(static_cast<const osmium::Area&>(object), block);
+        break;
+      default:
+        break;
+    }
+  }
+
+  // Column names of the CSV/TSV header
+  static std::string header(const ExportOptions& options) {
+    const char separator = options.separator();
+    std::string out = std::string("type") + separator + "id" + separator + "geometry";
+    for(const std::string& column : options.columns) {
+      out += separator;
+      appendDelimitedField(out, column.c_str(), separator);
+    }
+    out += '\n';
+    return out;
+  }
+
+private:
+  const ExportOptions& mOptions;
+  osmium::geom::GeoJSONFactory<> mGeoJSON;
+  osmium::geom::WKTFactory<> mWKT;
+  std::string mGeometry;
+  osmium::memory::Buffer mScratch;
+  osmium::area::Assembler::config_type mAssemblerConfig;
+
+  static bool check(GeometryProblem problem, FormattedBlock& block) {
+    if(problem != GeometryProblem::none) {
+      ++block.invalid_geometries;
+      return false;
+    }
+    return true;
+  }
+
+  void formatArea(const osmium::Area& area, FormattedBlock& block) {
+    if(!check(checkMultipolygon(area), block)) {
+      return;
+    }
+    if(mOptions.format == ExportOptions::Format::geojsonseq) {
+      mGeoJSON.create_multipolygon(area, mGeometry);
+    } else {
+      mWKT.create_multipolygon(area, mGeometry);
+    }
+    feature(area.from_way() ? 'w' : 'r', area.orig_id(), area, block);
+  }
+
+  void formatWayArea(const osmium::Way& way, FormattedBlock& block) {
+    if(!check(checkPolygon(way), block)) {
+      return;
+    }
+    mScratch.clear();
+    osmium::area::Assembler assembler(mAssemblerConfig);
+    assembler(way, mScratch);
+    formatArea(mScratch.get<osmium::Area>(0), block);
+  }
+
+  static const char* typeName(char type) {
+    return type == 'n' ? "node" : (type == 'w' ? "way" : "relation");
+  }
+
+  void feature(char type, osmium::object_id_type id, const osmium::OSMObject& object, FormattedBlock& block) {
+    std::string& out = block.data;
+    ++block.features;
+    if(mOptions.format == ExportOptions::Format::geojsonseq) {
+      out += "\x1e{\"type\":\"Feature\",\"id\":\"";
+      out += type;
+      out += std::to_string(id);
+      out += "\",\"geometry\":";
+      out += mGeometry;
+      out += ",\"properties\":{";
+      bool first = true;
+      auto property = [&out, &first](const char* key, const char* value) {
+        if(!first) {
+          out += ',';
+        }
+        first = false;
+        appendJsonString(out, key);
+        out += ':';
+        appendJsonString(out, value);
+      };
+      if(mOptions.columns.empty()) {
+        for(const osmium::Tag& tag : object.tags()) {
+          property(tag.key(), tag.value());
+        }
+      } else {
+        for(const std::string& column : mOptions.columns) {
+          const char* value = object.tags().get_value_by_key(column.c_str());
+          if(value != nullptr) {
+            property(column.c_str(), value);
+          }
+        }
+      }
+      out += "}}\n";
+    } else {
+      const char separator = mOptions.separator();
+      out += typeName(type);
+      out += separator;
+      out += std::to_string(id);
+      out += separator;
+      appendDelimitedField(out, mGeometry.c_str(), separator);
+      for(const std::string& column : mOptions.columns) {
+        out += separator;
+        const char* value = object.tags().get_value_by_key(column.c_str());
+        if(value != nullptr) {
+          appendDelimitedField(out, value, separator);
+        }
+      }
+      out += '\n';
+    }
+  }
+};
+
+// Formats the selected objects of a buffer, runs on the osmium thread pool
+struct ExportTask {
+  std::shared_ptr<const osmium::memory::Buffer> buffer;
+  std::vector<size_t> offsets;
+  std::shared_ptr<const ExportOptions> options;
+
+  FormattedBlock operator()() const {
+    FormattedBlock block;
+    block.data.reserve(offsets.size() * 256);
+    FeatureFormatter formatter(*options);
+    for(size_t offset : offsets) {
+      formatter.format(buffer->get<osmium::OSMObject>(offset), block);
+    }
+    return block;
+  }
+};
+
+/**
+ * Streams features to a GeoJSON text sequence or CSV/TSV file (compressed
+ * if the name ends with .gz or .bz2). The objects are selected on the
+ * calling thread in file order (the ObjectFilter may depend on the objects
+ * seen before, e.g. for bounding boxes) and the buffers are formatted on
+ * the osmium thread pool, like the XML and PBF writers do. The formatted
+ * blocks are written in the order the buffers were added.
+ */
+class FeatureExporter {
+public:
+
+  uint64_t features = 0;
+  uint64_t invalid_geometries = 0;
+  uint64_t bytes = 0;
+
+  FeatureExporter(const std::string& filename, const ExportOptions& options,
+                  std::shared_ptr<tagfilter::Command> filter, bool overwrite) :
+    mOptions(std::make_shared<ExportOptions>(options)),
+    mFilter(filter) {
+    const osmium::io::File file(filename);
+    const int fd = osmium::io::detail::open_for_writing(filename, overwrite ? osmium::io::overwrite::allow : osmium::io::overwrite::no);
+    mOutput = osmium::io::CompressionFactory::instance().create_compressor(file.compression(), fd, osmium::io::fsync::no);
+    if(mOptions->format != ExportOptions::Format::geojsonseq) {
+      write(FeatureFormatter::header(*mOptions));
+    }
+  }
+
+  ~FeatureExporter() {
+    try {
+      close();
+    } catch(...) {
+    }
+  }
+
+  // Selects the objects of the buffer to export and queues the buffer for formatting
+  void add(osmium::memory::Buffer&& buffer) {
+    std::vector<size_t> offsets;
+    for(auto it = buffer.cbegin<osmium::OSMObject>(); it != buffer.cend<osmium::OSMObject>(); ++it) {
+      if(selected(*it)) {
+        offsets.push_back(static_cast<size_t>(reinterpret_cast<const unsigned char*>(&*it) - buffer.data()));
+      }
+    }
+    if(offsets.empty()) {
+      return;
+    }
+    ExportTask task = {std::make_shared<const osmium::memory::Buffer>(std::move(buffer)), std::move(offsets), mOptions};
+    mPending.push_back(osmium::thread::Pool::instance().submit(std::move(task)));
+    writeFinished(mPending.size() > max_pending);
+  }
+
+  // Writes the remaining blocks and closes the file
+  void close() {
+    if(!mOutput) {
+      return;
+    }
+    while(!mPending.empty()) {
+      writeFinished(true);
+    }
+    mOutput->close();
+    mOutput.reset();
+  }
+
+private:
+  // Buffers formatted at the same time (each holds a buffer of the reader)
+  static const size_t max_pending = 16;
+
+  std::shared_ptr<const ExportOptions> mOptions;
+  std::shared_ptr<tagfilter::Command> mFilter;
+  std::unique_ptr<osmium::io::Compressor> mOutput;
+  std::deque<std::future<FormattedBlock>> mPending;
+
+  bool selected(const osmium::OSMObject& object) const {
+    bool wanted;
+    switch(object.type()) {
+      case osmium::item_type::node:
+        wanted = (mOptions->types & osmium::osm_entity_bits::node) != 0;
+        break;
+      case osmium::item_type::way:
+        wanted = (mOptions->types & osmium::osm_entity_bits::way) || mOptions->isWayArea(static_cast<const osmium::Way&>(object));
+        break;
+      case osmium::item_type::area:
+        wanted = (mOptions->types & osmium::osm_entity_bits::area) != 0;
+        break;
+      default:
+        wanted = false;
+    }
+    return wanted && !object.tags().empty() && (mFilter == nullptr || mFilter->execute(object));
+  }
+
+  void write(const std::string& data) {
+    bytes += data.size();
+    mOutput->write(data);
+  }
+
+  // Writes the finished blocks at the front of the queue, waits for the first one if wait is set
+  void writeFinished(bool wait) {
+    while(!mPending.empty() &&
+          (wait || mPending.front().wait_for(std::chrono::seconds(0)) == std::future_status::ready)) {
+      FormattedBlock block = mPending.front().get();
+      mPending.pop_front();
+      features += block.features;
+      invalid_geometries += block.invalid_geometries;
+      if(!block.data.empty()) {
+        write(block.data);
+      }
+      wait = false;
+    }
+  }
+};
+
+#endif // FEATUREEXPORTER_HPP
@@ -0,0 +1,203 @@
+
+// Rosmium: R bindings for the Osmium library
+// Copyright (C) 2016 Lukas Huwiler
+//
+// This file is part of Rosmium.
+//
+// Rosmium is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Rosmium is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Rosmium.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef GEOMETRYBENCHMARK_HPP
+#define GEOMETRYBENCHMARK_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <osmium/area/assembler.hpp>
+#include <osmium/geom/geojson.hpp>
+#include <osmium/geom/wkb.hpp>
+#include <osmium/geom/wkt.hpp>
+#include <osmium/handler.hpp>
+#include <osmium/handler/node_locations_for_ways.hpp>
+#include <osmium/io/reader.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/visitor.hpp>
+
+#include "GeometryCheck.hpp"
+#include "LocationIndex.hpp"
+
+struct GeometryBenchmarkResult {
+  std::string format;
+  std::string output;
+  uint64_t geometries = 0;
+  double seconds = 0;
+  uint64_t bytes = 0;
+  uint64_t allocations = 0;
+};
+
+/**
+ * Measures the conversion of OSM objects into WKB (hex), WKT and GeoJSON,
+ * once with a new string per geometry (as returned by the factories) and
+ * once with one output buffer which is reused for all geometries. The
+ * objects (tagged nodes, ways and the areas of closed ways) are read from a
+ * file into memory first, so only the conversion is measured.
+ *
+ * The allocations are counted on the output strings: a returned string
+ * which does not fit into the small string buffer needs at least one heap
+ * allocation, the reused buffer only allocates when it has to grow (counted
+ * as the number of times the largest capacity seen so far increased).
+ */
+class GeometryBenchmark {
+public:
+
+  GeometryBenchmark(const std::string& filename, const std::string& map_type) :
+    mNodes(buffer_size, osmium::memory::Buffer::auto_grow::yes),
+    mWays(buffer_size, osmium::memory::Buffer::auto_grow::yes),
+    mAreas(buffer_size, osmium::memory::Buffer::auto_grow::yes) {
+    LocationIndex index(map_type);
+    osmium::handler::NodeLocationsForWays<index_type> location_handler(index);
+    location_handler.ignore_errors();
+    Loader loader(*this);
+    osmium::io::Reader reader(filename, osmium::osm_entity_bits::node | osmium::osm_entity_bits::way);
+    osmium::apply(reader, location_handler, loader);
+    reader.close();
+  }
+
+  std::vector<GeometryBenchmarkResult> run(const std::string& format) {
+    std::vector<GeometryBenchmarkResult> results;
+    if(format == "wkb") {
+      osmium::geom::WKBFactory<> factory(osmium::geom::wkb_type::wkb, osmium::geom::out_type::hex);
+      results.push_back(runStrings(factory, format));
+      results.push_back(runBuffer(factory, format));
+    } else if(format == "wkt") {
+      osmium::geom::WKTFactory<> factory;
+      results.push_back(runStrings(factory, format));
+      results.push_back(runBuffer(factory, format));
+    } else if(format == "geojson") {
+      osmium::geom::GeoJSONFactory<> factory;
+      results.push_back(runStrings(factory, format));
+      results.push_back(runBuffer(factory, format));
+    } else {
+      throw std::invalid_argument("Unknown geometry format: " + format);
+    }
+    return results;
+  }
+
+private:
+  static constexpr size_t buffer_size = 1024 * 1024;
+
+  osmium::memory::Buffer mNodes;
+  osmium::memory::Buffer mWays;
+  osmium::memory::Buffer mAreas;
+
+  // Copies the objects with a valid geometry into the benchmark buffers
+  class Loader : public osmium::handler::Handler {
+  public:
+
+    explicit Loader(GeometryBenchmark& benchmark) : mBenchmark(benchmark) {}
+
+    void node(const osmium::Node& node) {
+      if(!node.tags().empty() && checkPoint(node) == GeometryProblem::none) {
+        mBenchmark.mNodes.add_item(node);
+        mBenchmark.mNodes.commit();
+      }
+    }
+
+    void way(const osmium::Way& way) {
+      if(checkLinestring(way) != GeometryProblem::none) {
+        return;
+      }
+      mBenchmark.mWays.add_item(way);
+      mBenchmark.mWays.commit();
+      if(way.is_closed() && checkPolygon(way) == GeometryProblem::none) {
+        osmium::area::Assembler assembler(mConfig);
+        assembler(way, mBenchmark.mAreas);
+      }
+    }
+
+  private:
+    GeometryBenchmark& mBenchmark;
+    osmium::area::Assembler::config_type mConfig;
+  };
+
+  template <typename TTimePoint>
+  static double seconds(const TTimePoint& start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  static void count(GeometryBenchmarkResult& result, const std::string& geometry) {
+    static const size_t inline_capacity = std::string().capacity();
+    ++result.geometries;
+    result.bytes += geometry.size();
+    result.allocations += geometry.capacity() > inline_capacity;
+  }
+
+  template <typename TFactory>
+  GeometryBenchmarkResult runStrings(TFactory& factory, const std::string& format) {
+    GeometryBenchmarkResult result;
+    result.format = format;
+    result.output = "string";
+    auto start = std::chrono::steady_clock::now();
+    for(auto it = mNodes.cbegin<osmium::Node>(); it != mNodes.cend<osmium::Node>(); ++it) {
+      count(result, factory.create_point(*it));
+    }
+    for(auto it = mWays.cbegin<osmium::Way>(); it != mWays.cend<osmium::Way>(); ++it) {
+      count(result, factory.create_linestring(*it));
+    }
+    for(auto it = mAreas.cbegin<osmium::Area>(); it != mAreas.cend<osmium::Area>(); ++it) {
+      if(checkMultipolygon(*it) == GeometryProblem::none) {
+        count(result, factory.create_multipolygon(*it));
+      }
+    }
+    result.seconds = seconds(start);
+    return result;
+  }
+
+  template <typename TFactory>
+  GeometryBenchmarkResult runBuffer(TFactory& factory, const std::string& format) {
+    GeometryBenchmarkResult result;
+    result.format = format;
+    result.output = "buffer";
+    std::string out;
+    size_t capacity = out.capacity();
+    auto countBuffer = [&result, &out, &capacity]() {
+      ++result.geometries;
+      result.bytes += out.size();
+      if(out.capacity() > capacity) {
+        capacity = out.capacity();
+        ++result.allocations;
+      }
+    };
+    auto start = std::chrono::steady_clock::now();
+    for(auto it = mNodes.cbegin<osmium::Node>(); it != mNodes.cend<osmium::Node>(); ++it) {
+      factory.create_point(*it, out);
+      countBuffer();
+    }
+    for(auto it = mWays.cbegin<osmium::Way>(); it != mWays.cend<osmium::Way>(); ++it) {
+      factory.create_linestring(*it, out);
+      countBuffer();
+    }
+    for(auto it = mAreas.cbegin<osmium::Area>(); it != mAreas.cend<osmium::Area>(); ++it) {
+      if(checkMultipolygon(*it) == GeometryProblem::none) {
+        factory.create_multipolygon(*it, out);
+        countBuffer();
+      }
+    }
+    result.seconds = seconds(start);
+    return result;
+  }
+};
+
+#endif // GEOMETRYBENCHMARK_HPP
@@ -0,0 +1,118 @@
+
+// Rosmium: R bindings for the Osmium library
+// Copyright (C) 2016 Lukas Huwiler
+//
+// This file is part of Rosmium.
+//
+// Rosmium is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Rosmium is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Rosmium.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef GEOMETRYCHECK_HPP
+#define GEOMETRYCHECK_HPP
+
+#include <cstdint>
+#include <osmium/osm/area.hpp>
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/node.hpp>
+#include <osmium/osm/node_ref_list.hpp>
+#include <osmium/osm/way.hpp>
+
+/**
+ * Checks done before a geometry is created with the osmium GeometryFactory.
+ * An object which passes the check can be converted without an exception,
+ * so the (expensive) exception path is not taken for the incomplete objects
+ * which are common in extracts.
+ */
+enum class GeometryProblem {
+  none,
+  missing_location,
+  too_few_points,
+  invalid_ring
+};
+
+// Number of points the factory creates (consecutive nodes with the same location count once)
+inline GeometryProblem countUniquePoints(const osmium::NodeRefList& nodes, size_t& points) {
+  points = 0;
+  osmium::Location last;
+  for(const osmium::NodeRef& node : nodes) {
+    if(!node.location().valid()) {
+      return GeometryProblem::missing_location;
+    }
+    if(node.location() != last) {
+      last = node.location();
+      ++points;
+    }
+  }
+  return GeometryProblem::none;
+}
+
+inline GeometryProblem checkPoint(const osmium::Node& node) {
+  return node.location().valid() ? GeometryProblem::none : GeometryProblem::missing_location;
+}
+
+inline GeometryProblem checkLinestring(const osmium::Way& way) {
+  size_t points;
+  GeometryProblem problem = countUniquePoints(way.nodes(), points);
+  if(problem == GeometryProblem::none && points < 2) {
+    problem = GeometryProblem::too_few_points;
+  }
+  return problem;
+}
+
+inline GeometryProblem checkPolygon(const osmium::Way& way) {
+  size_t points;
+  GeometryProblem problem = countUniquePoints(way.nodes(), points);
+  if(problem == GeometryProblem::none && points < 4) {
+    problem = GeometryProblem::too_few_points;
+  }
+  return problem;
+}
+
+// Every ring needs at least four points and an area at least one outer ring
+inline GeometryProblem checkMultipolygon(const osmium::Area& area) {
+  size_t outer_rings = 0;
+  for(auto it = area.cbegin(); it != area.cend(); ++it) {
+    if(it->type() != osmium::item_type::outer_ring && it->type() != osmium::item_type::inner_ring) {
+      continue;
+    }
+    outer_rings += it->type() == osmium::item_type::outer_ring;
+    size_t points;
+    GeometryProblem problem = countUniquePoints(static_cast<const osmium::NodeRefList&>(*it), points);
+    if(problem != GeometryProblem::none) {
+      return problem;
+    }
+    if(points < 4) {
+      return GeometryProblem::invalid_ring;
+    }
+  }
+  return outer_rings > 0 ? GeometryProblem::none : GeometryProblem::invalid_ring;
+}
+
+// Number of geometries created and of geometries which could not be created, by reason
+struct GeometryCounters {
+  uint64_t valid = 0;
+  uint64_t missing_location = 0;
+  uint64_t too_few_points = 0;
+  uint64_t invalid_ring = 0;
+
+  void count(GeometryProblem problem) {
+    switch(problem) {
+      case GeometryProblem::none: ++valid; break;
+      case GeometryProblem::missing_location: ++missing_location; break;
+      case GeometryProblem::too_few_points: ++too_few_points; break;
+      case GeometryProblem::invalid_ring: ++invalid_ring; break;
+    }
+  }
+};
+
+#endif // GEOMETRYCHECK_HPP
@@ -0,0 +1,221 @@
+
+// Rosmium: R bindings for the Osmium library
+// Copyright (C) 2016 Lukas Huwiler
+//
+// This file is part of Rosmium.
+//
+// Rosmium is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Rosmium is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Rosmium.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HANDLERCHAIN_HPP
+#define HANDLERCHAIN_HPP
+
+#include <tuple>
+#include <vector>
+#include <osmium/dynamic_handler.hpp>
+#include <osmium/handler.hpp>
+#include <osmium/osm.hpp>
+
+// Forwards all callbacks to a handler owned by someone else (used to put existing handlers into a DynamicHandler)
+template <typename THandler>
+class HandlerReference : public osmium::handler::Handler {
+public:
+
+  explicit HandlerReference(THandler& handler) : mHandler(handler) {}
+
+  void node(const osmium::Node& node) {
+    mHandler.node(node);
+  }
+
+  void way(const osmium::Way& way) {
+    mHandler.way(way);
+  }
+
+  void relation(const osmium::Relation& rel) {
+    mHandler.relation(rel);
+  }
+
+  void area(const osmium::Area& area) {
+    mHandler.area(area);
+  }
+
+  void flush() {
+    mHandler.flush();
+  }
+
+private:
+  THandler& mHandler;
+};
+
+/**
+ * Chain of handlers which is put together at run time. Every object is
+ * passed to all handlers in the order they were added, which costs one
+ * virtual call per handler and object. Used for combinations of handlers
+ * which have no pre-instantiated (static) chain.
+ */
+class DynamicChain : public osmium::handler::Handler {
+public:
+
+  template <typename THandler>
+  void add(THandler& handler) {
+    mHandlers.emplace_back();
+    mHandlers.back().set<HandlerReference<THandler> >(handler);
+  }
+
+  size_t size() const {
+    return mHandlers.size();
+  }
+
+  void node(const osmium::Node& node) {
+    for(osmium::handler::DynamicHandler& handler : mHandlers) {
+      handler.node(node);
+    }
+  }
+
+  void way(const osmium::Way& way) {
+    for(osmium::handler::DynamicHandler& handler : mHandlers) {
+      handler.way(way);
+    }
+  }
+
+  void relation(const osmium::Relation& rel) {
+    for(osmium::handler::DynamicHandler& handler : mHandlers) {
+      handler.relation(rel);
+    }
+  }
+
+  void area(const osmium::Area& area) {
+    for(osmium::handler::DynamicHandler& handler : mHandlers) {
+      handler.area(area);
+    }
+  }
+
+  void flush() {
+    for(osmium::handler::DynamicHandler& handler : mHandlers) {
+      handler.flush();
+    }
+  }
+
+private:
+  std::vector<osmium::handler::DynamicHandler> mHandlers;
+};
+
+namespace chain_detail {
+
+  // Calls a member function on every element of a tuple, starting at index N
+  template <size_t N, size_t SIZE>
+  struct ForEach {
+    template <typename TTuple, typename TFunction>
+    static void apply(TTuple& tuple, TFunction& function) {
+      function(std::get<N>(tuple));
+      ForEach<N + 1, SIZE>::apply(tuple, function);
+    }
+
+    template <typename TTuple>
+    static void merge(TTuple& tuple, const TTuple& other) {
+      std::get<N>(tuple).merge(std::get<N>(other));
+      ForEach<N + 1, SIZE>::merge(tuple, other);
+    }
+  };
+
+  template <size_t SIZE>
+  struct ForEach<SIZE, SIZE> {
+    template <typename TTuple, typename TFunction>
+    static void apply(TTuple&, TFunction&) {}
+
+    template <typename TTuple>
+    static void merge(TTuple&, const TTuple&) {}
+  };
+
+  template <typename THandler>
+  void call(THandler& handler, const osmium::Node& node) {
+    handler.node(node);
+  }
+
+  template <typename THandler>
+  void call(THandler& handler, const osmium::Way& way) {
+    handler.way(way);
+  }
+
+  template <typename THandler>
+  void call(THandler& handler, const osmium::Relation& rel) {
+    handler.relation(rel);
+  }
+
+  template <typename TObject>
+  struct Visit {
+    const TObject& object;
+
+    template <typename THandler>
+    void operator()(THandler& handler) {
+      call(handler, object);
+    }
+  };
+
+  struct Clear {
+    template <typename THandler>
+    void operator()(THandler& handler) {
+      handler.clear();
+    }
+  };
+
+} // namespace chain_detail
+
+/**
+ * Statically dispatched chain which holds copies of its handlers, so it can
+ * be copied, cleared and merged like a single handler and therefore be used
+ * with parallel_apply(). The results are read back with get<N>().
+ */
+template <typename... THandlers>
+class MergeableChain : public osmium::handler::Handler {
+public:
+
+  explicit MergeableChain(const THandlers&... handlers) : mHandlers(handlers...) {}
+
+  template <size_t N>
+  typename std::tuple_element<N, std::tuple<THandlers...> >::type& get() {
+    return std::get<N>(mHandlers);
+  }
+
+  void node(const osmium::Node& node) {
+    visit(node);
+  }
+
+  void way(const osmium::Way& way) {
+    visit(way);
+  }
+
+  void relation(const osmium::Relation& rel) {
+    visit(rel);
+  }
+
+  void merge(const MergeableChain& other) {
+    chain_detail::ForEach<0, sizeof...(THandlers)>::merge(mHandlers, other.mHandlers);
+  }
+
+  void clear() {
+    chain_detail::Clear clear;
+    chain_detail::ForEach<0, sizeof...(THandlers)>::apply(mHandlers, clear);
+  }
+
+private:
+  std::tuple<THandlers...> mHandlers;
+
+  template <typename TObject>
+  void visit(const TObject& object) {
+    chain_detail::Visit<TObject> visit = {object};
+    chain_detail::ForEach<0, sizeof...(THandlers)>::apply(mHandlers, visit);
+  }
+};
+
+#endif // HANDLERCHAIN_HPP
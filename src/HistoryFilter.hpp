@@ -0,0 +1,197 @@
+
+// Rosmium: R bindings for the Osmium library
+// Copyright (C) 2016 Lukas Huwiler
+//
+// This file is part of Rosmium.
+//
+// Rosmium is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Rosmium is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Rosmium.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HISTORYFILTER_HPP
+#define HISTORYFILTER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <osmium/diff_iterator.hpp>
+#include <osmium/io/input_iterator.hpp>
+#include <osmium/io/reader.hpp>
+#include <osmium/osm/diff_object.hpp>
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/node.hpp>
+#include <osmium/osm/object.hpp>
+#include <osmium/osm/timestamp.hpp>
+#include <osmium/osm/types.hpp>
+#include <osmium/osm/way.hpp>
+
+/**
+ * Selects object versions of a full-history file by time: either the
+ * versions visible at one point in time (a snapshot) or all visible
+ * versions valid at some time in the range [from, to).
+ */
+class TimeFilter {
+public:
+
+  enum class Mode {
+    none,
+    snapshot,
+    range
+  };
+
+  TimeFilter() = default;
+
+  static TimeFilter snapshot(const std::string& timestamp) {
+    TimeFilter filter;
+    filter.mMode = Mode::snapshot;
+    filter.mFrom = parse(timestamp);
+    filter.mTo = filter.mFrom;
+    return filter;
+  }
+
+  static TimeFilter range(const std::string& from, const std::string& to) {
+    TimeFilter filter;
+    filter.mMode = Mode::range;
+    filter.mFrom = parse(from);
+    filter.mTo = parse(to);
+    if(filter.mTo <= filter.mFrom) {
+      throw std::invalid_argument("The end of the time range has to be after its start");
+    }
+    return filter;
+  }
+
+  bool active() const {
+    return mMode != Mode::none;
+  }
+
+  Mode mode() const {
+    return mMode;
+  }
+
+  const osmium::Timestamp& from() const {
+    return mFrom;
+  }
+
+  bool accept(const osmium::DiffObject& diff) const {
+    switch(mMode) {
+      case Mode::snapshot: return diff.is_visible_at(mFrom);
+      case Mode::range: return diff.curr().visible() && diff.is_between(mFrom, mTo);
+      default: return true;
+    }
+  }
+
+private:
+  Mode mMode = Mode::none;
+  osmium::Timestamp mFrom;
+  osmium::Timestamp mTo;
+
+  static osmium::Timestamp parse(const std::string& timestamp) {
+    try {
+      return osmium::Timestamp(timestamp);
+    } catch(std::invalid_argument&) {
+      throw std::invalid_argument("Invalid timestamp (expected e.g. 2015-01-01T00:00:00Z): " + timestamp);
+    }
+  }
+};
+
+/**
+ * Streams the object versions of a history file accepted by the filter to
+ * the callback, which gets the DiffObject with the version and its validity
+ * interval. The file has to be sorted by type, id and version (as history
+ * files are). The DiffIterator looks at the previous and next version only,
+ * so at most two buffers of the reader are kept, never whole histories.
+ */
+template <typename TCallback>
+void applyHistory(osmium::io::Reader& reader, const TimeFilter& filter, TCallback callback) {
+  typedef osmium::io::InputIterator<osmium::io::Reader, osmium::OSMObject> object_iterator;
+  auto it = osmium::make_diff_iterator(object_iterator(reader), object_iterator());
+  auto end = osmium::make_diff_iterator(object_iterator(), object_iterator());
+  for(; it != end; ++it) {
+    if(filter.accept(*it)) {
+      callback(*it);
+    }
+  }
+}
+
+/**
+ * Node locations of a history file for a time range. A location index
+ * holds one location per node, which would give every way version the
+ * locations of the last node versions in the range. Here every node
+ * version passed to update() is kept with the time it became valid, and a
+ * way version gets the locations valid when it became valid (or at the
+ * start of the range if it was valid before). History files are sorted by
+ * type, so all nodes are seen before the first way.
+ */
+class HistoryLocations {
+public:
+
+  explicit HistoryLocations(const osmium::Timestamp& from) :
+    mFrom(from) {
+  }
+
+  // Remembers the location of a node version or sets the node locations of a way version
+  void update(osmium::OSMObject& object) {
+    if(object.type() == osmium::item_type::node) {
+      const osmium::Node& node = static_cast<const osmium::Node&>(object);
+      mVersions.push_back(Version{node.id(), uint32_t(node.timestamp()), node.location()});
+      mSorted = false;
+    } else if(object.type() == osmium::item_type::way) {
+      if(!mSorted) {
+        std::stable_sort(mVersions.begin(), mVersions.end());
+        mSorted = true;
+      }
+      osmium::Way& way = static_cast<osmium::Way&>(object);
+      const uint32_t at = std::max(uint32_t(way.timestamp()), uint32_t(mFrom));
+      for(osmium::NodeRef& ref : way.nodes()) {
+        ref.set_location(location(ref.ref(), at));
+      }
+    }
+  }
+
+  size_t usedMemory() const {
+    return mVersions.capacity() * sizeof(Version);
+  }
+
+private:
+  struct Version {
+    osmium::object_id_type id;
+    uint32_t timestamp;
+    osmium::Location location;
+
+    bool operator<(const Version& other) const {
+      return id < other.id || (id == other.id && timestamp < other.timestamp);
+    }
+  };
+
+  osmium::Timestamp mFrom;
+  std::vector<Version> mVersions;
+  bool mSorted = true;
+
+  // Location of the last version of the node which became valid at or before the time
+  osmium::Location location(osmium::object_id_type id, uint32_t at) const {
+    auto it = std::upper_bound(mVersions.begin(), mVersions.end(), Version{id, at, osmium::Location()});
+    if(it == mVersions.begin() || (--it)->id != id) {
+      return osmium::Location();
+    }
+    return it->location;
+  }
+};
+
+// The current version of the diff, writable so handlers like NodeLocationsForWays can be applied to it
+inline osmium::OSMObject& currentVersion(const osmium::DiffObject& diff) {
+  // The objects are in the buffers of the reader, which belong to the iterator only
+  return const_cast<osmium::OSMObject&>(diff.curr());
+}
+
+#endif // HISTORYFILTER_HPP
@@ -0,0 +1,159 @@
+
+// Rosmium: R bindings for the Osmium library
+// Copyright (C) 2016 Lukas Huwiler
+//
+// This file is part of Rosmium.
+//
+// Rosmium is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Rosmium is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Rosmium.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef INDEXBENCHMARK_HPP
+#define INDEXBENCHMARK_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#ifdef __GLIBC__
+# include <malloc.h>
+#endif
+
+#include "LocationIndex.hpp"
+#include "SyntheticData.hpp"
+
+struct IndexBenchmarkResult {
+  std::string map;
+  uint64_t nodes = 0;
+  double insert_seconds = 0;
+  double sort_seconds = 0;
+  double sequential_lookup_ns = 0;
+  double random_lookup_ns = 0;
+  size_t used_memory = 0;
+  long resident_memory = 0;
+  std::string error;
+};
+
+// Resident set size of this process in bytes (0 if not available)
+inline long residentMemory() {
+  long pages = 0;
+  long resident = 0;
+  FILE* statm = std::fopen("/proc/self/statm", "r");
+  if(statm == nullptr) {
+    return 0;
+  }
+  if(std::fscanf(statm, "%ld %ld", &pages, &resident) != 2) {
+    resident = 0;
+  }
+  std::fclose(statm);
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+/**
+ * Loads the given number of synthetic nodes into every map and measures
+ * insert throughput, sort time, the latency of sequential and random
+ * lookups and the memory used. Node ids are ascending with small gaps, as
+ * in a real OSM file.
+ */
+class IndexBenchmark {
+public:
+
+  IndexBenchmark(uint64_t nodes, uint64_t lookups, uint64_t seed) :
+    mLookups(lookups) {
+    SyntheticRandom rnd(seed);
+    mIds.reserve(nodes);
+    mLocations.reserve(nodes);
+    osmium::unsigned_object_id_type id = 0;
+    for(uint64_t i = 0; i < nodes; ++i) {
+      id += 1 + rnd.geometric(0.5);
+      mIds.push_back(id);
+      mLocations.emplace_back(rnd.uniform() * 360.0 - 180.0, rnd.uniform() * 180.0 - 90.0);
+    }
+    mRandomOrder.reserve(lookups);
+    for(uint64_t i = 0; i < lookups; ++i) {
+      mRandomOrder.push_back(static_cast<size_t>(rnd.below(nodes)));
+    }
+  }
+
+  IndexBenchmarkResult run(const std::string& map_type) {
+    typedef std::chrono::steady_clock clock;
+    IndexBenchmarkResult result;
+    result.map = map_type;
+    result.nodes = mIds.size();
+    try {
+      releaseMemory();
+      const long resident_before = residentMemory();
+      LocationIndex index(map_type);
+
+      clock::time_point start = clock::now();
+      for(size_t i = 0; i < mIds.size(); ++i) {
+        index.set(mIds[i], mLocations[i]);
+      }
+      result.insert_seconds = seconds(start);
+
+      start = clock::now();
+      index.sort();
+      result.sort_seconds = seconds(start);
+
+      result.used_memory = index.used_memory();
+      result.resident_memory = residentMemory() - resident_before;
+
+      const size_t lookups = mIds.empty() ? 0 : static_cast<size_t>(mLookups);
+      int64_t checksum = 0;
+      start = clock::now();
+      for(size_t i = 0; i < lookups; ++i) {
+        checksum += index.get(mIds[i % mIds.size()]).x();
+      }
+      result.sequential_lookup_ns = lookups ? seconds(start) * 1e9 / lookups : 0;
+
+      start = clock::now();
+      for(size_t i = 0; i < lookups; ++i) {
+        checksum += index.get(mIds[mRandomOrder[i]]).x();
+      }
+      result.random_lookup_ns = lookups ? seconds(start) * 1e9 / lookups : 0;
+
+      // the lookups are checked after the timing to keep them out of the measurement
+      for(size_t i = 0; i < lookups; ++i) {
+        checksum -= static_cast<int64_t>(mLocations[i % mIds.size()].x()) + mLocations[mRandomOrder[i]].x();
+      }
+      if(checksum != 0) {
+        result.error = "lookup returned wrong locations";
+      }
+    } catch(std::exception& e) {
+      result.error = e.what();
+    }
+    return result;
+  }
+
+private:
+  uint64_t mLookups;
+  std::vector<osmium::unsigned_object_id_type> mIds;
+  std::vector<osmium::Location> mLocations;
+  std::vector<size_t> mRandomOrder;
+
+  template <typename TTimePoint>
+  static double seconds(const TTimePoint& start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  // give memory of previous runs back to the OS, so the resident memory is comparable
+  static void releaseMemory() {
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+  }
+};
+
+#endif // INDEXBENCHMARK_HPP
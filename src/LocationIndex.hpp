@@ -0,0 +1,150 @@
+
+// Rosmium: R bindings for the Osmium library
+// Copyright (C) 2016 Lukas Huwiler
+//
+// This file is part of Rosmium.
+//
+// Rosmium is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Rosmium is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Rosmium.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef LOCATIONINDEX_HPP
+#define LOCATIONINDEX_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/types.hpp>
+#include <osmium/index/map/all.hpp>
+#include <osmium/index/node_locations_map.hpp>
+
+typedef osmium::index::map::Map<osmium::unsigned_object_id_type, osmium::Location> index_type;
+typedef osmium::index::MapFactory<osmium::unsigned_object_id_type, osmium::Location> index_factory;
+
+/**
+ * Node location index which delegates to one of the maps registered in the
+ * osmium MapFactory (e.g. "sparse_mem_array", "dense_mmap_array",
+ * "sparse_file_array,/tmp/nodes.idx"). The in-memory array maps can be moved
+ * to their file-backed counterpart while the index is being filled, which
+ * is used when a job exceeds its memory budget.
+ */
+class LocationIndex : public index_type {
+public:
+
+  explicit LocationIndex(const std::string& type) {
+    mType = type.empty() ? "sparse_mem_array" : type;
+    if(!index_factory::instance().has_map_type(mapName(mType))) {
+      throw std::runtime_error("Unknown location index type '" + mType + "'");
+    }
+    mMap = index_factory::instance().create_map(mType);
+  }
+
+  void reserve(const size_t size) final {
+    mMap->reserve(size);
+  }
+
+  void set(const osmium::unsigned_object_id_type id, const osmium::Location value) final {
+    mMap->set(id, value);
+  }
+
+  const osmium::Location get(const osmium::unsigned_object_id_type id) const final {
+    return mMap->get(id);
+  }
+
+  size_t size() const final {
+    return mMap->size();
+  }
+
+  size_t used_memory() const final {
+    return mMap->used_memory();
+  }
+
+  void clear() final {
+    mMap->clear();
+  }
+
+  void sort() final {
+    mMap->sort();
+  }
+
+  const std::string& type() const {
+    return mType;
+  }
+
+  bool isFileBacked() const {
+    const std::string name = mapName(mType);
+    return name == "sparse_file_array" || name == "dense_file_array";
+  }
+
+  /**
+   * Main memory used by the index. File-backed maps report their size on
+   * disk as used_memory(), which is not accounted for here.
+   */
+  size_t residentMemory() const {
+    return isFileBacked() ? 0 : mMap->used_memory();
+  }
+
+  /**
+   * Move the content of an in-memory array map into a file-backed map of the
+   * same layout (stored in an anonymous temporary file).
+   *
+   * @returns true if the index was moved, false if the index type has no
+   *          file-backed counterpart.
+   */
+  bool spillToFile() {
+    typedef osmium::index::map::SparseMemArray<osmium::unsigned_object_id_type, osmium::Location> sparse_mem_array;
+    typedef osmium::index::map::DenseMemArray<osmium::unsigned_object_id_type, osmium::Location> dense_mem_array;
+
+    std::unique_ptr<index_type> file_map;
+    std::string file_type;
+    if(sparse_mem_array* mem_map = dynamic_cast<sparse_mem_array*>(mMap.get())) {
+      file_type = "sparse_file_array";
+      file_map = index_factory::instance().create_map(file_type);
+      for(const auto& element : *mem_map) {
+        file_map->set(element.first, element.second);
+      }
+    } else if(dense_mem_array* mem_map = dynamic_cast<dense_mem_array*>(mMap.get())) {
+      file_type = "dense_file_array";
+      file_map = index_factory::instance().create_map(file_type);
+      file_map->reserve(mem_map->size());
+      osmium::unsigned_object_id_type id = 0;
+      for(const osmium::Location& location : *mem_map) {
+        if(location) {
+          file_map->set(id, location);
+        }
+        ++id;
+      }
+    } else {
+      return false;
+    }
+    mMap->clear();
+    mMap = std::move(file_map);
+    mType = file_type;
+    return true;
+  }
+
+  static std::vector<std::string> types() {
+    return index_factory::instance().map_types();
+  }
+
+private:
+  std::string mType;
+  std::unique_ptr<index_type> mMap;
+
+  // strip the optional ",filename" part of a map configuration string
+  static std::string mapName(const std::string& type) {
+    return type.substr(0, type.find(','));
+  }
+};
+
+#endif // LOCATIONINDEX_HPP
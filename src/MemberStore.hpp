@@ -0,0 +1,148 @@
+
+// Rosmium: R bindings for the Osmium library
+// Copyright (C) 2016 Lukas Huwiler
+//
+// This file is part of Rosmium.
+//
+// Rosmium is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Rosmium is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Rosmium.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef MEMBERSTORE_HPP
+#define MEMBERSTORE_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+#include <osmium/io/detail/read_write.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/object.hpp>
+#include <osmium/osm/types.hpp>
+
+#include "PositionalRead.hpp"
+
+/**
+ * Stores OSM objects of one type in an anonymous temporary file, similar to
+ * osmium::handler::DiskStore. The objects are appended in their buffer
+ * representation and can be copied back into a buffer by id after sort()
+ * has been called. Only the index (id, offset and size, 24 bytes per
+ * object) is kept in memory.
+ */
+class MemberStore {
+public:
+
+  MemberStore() {
+    mFile = std::tmpfile();
+    if(mFile == nullptr) {
+      throw std::system_error(errno, std::system_category(), "Could not create temporary file for relation members");
+    }
+    mFd = fileno(mFile);
+    mWriteBuffer.reserve(write_buffer_size);
+  }
+
+  MemberStore(const MemberStore&) = delete;
+  MemberStore& operator=(const MemberStore&) = delete;
+
+  ~MemberStore() {
+    std::fclose(mFile);
+  }
+
+  void add(const osmium::OSMObject& object) {
+    const size_t size = object.padded_size();
+    mIndex.push_back({object.id(), mOffset, static_cast<uint32_t>(size)});
+    mWriteBuffer.insert(mWriteBuffer.end(), object.data(), object.data() + size);
+    mOffset += size;
+    if(mWriteBuffer.size() >= write_buffer_size) {
+      flushWrites();
+    }
+  }
+
+  // Has to be called after the last add() and before the first get()
+  void sort() {
+    flushWrites();
+    std::stable_sort(mIndex.begin(), mIndex.end());
+  }
+
+  bool contains(osmium::object_id_type id) const {
+    return std::binary_search(mIndex.begin(), mIndex.end(), IndexEntry{id, 0, 0});
+  }
+
+  /**
+   * Copy the object with the given id into the buffer and commit it.
+   *
+   * @returns the offset of the object in the buffer or -1 if the object
+   *          is not in the store.
+   */
+  long get(osmium::object_id_type id, osmium::memory::Buffer& buffer) const {
+    auto it = std::lower_bound(mIndex.begin(), mIndex.end(), IndexEntry{id, 0, 0});
+    if(it == mIndex.end() || it->id != id) {
+      return -1;
+    }
+    unsigned char* target = buffer.reserve_space(it->size);
+    size_t done = 0;
+    while(done < it->size) {
+      ssize_t length = readAtOffset(mFd, target + done, it->size - done, it->offset + done);
+      if(length < 0 && errno == EINTR) {
+        continue;
+      }
+      if(length <= 0) {
+        throw std::system_error(errno, std::system_category(), "Reading relation member from temporary file failed");
+      }
+      done += static_cast<size_t>(length);
+    }
+    return static_cast<long>(buffer.commit());
+  }
+
+  size_t size() const {
+    return mIndex.size();
+  }
+
+  // Size of the data on disk
+  uint64_t bytes() const {
+    return mOffset;
+  }
+
+  size_t used_memory() const {
+    return mIndex.capacity() * sizeof(IndexEntry) + mWriteBuffer.capacity();
+  }
+
+private:
+  static constexpr size_t write_buffer_size = 1024 * 1024;
+
+  struct IndexEntry {
+    osmium::object_id_type id;
+    uint64_t offset;
+    uint32_t size;
+
+    bool operator<(const IndexEntry& other) const {
+      return id < other.id;
+    }
+  };
+
+  std::FILE* mFile;
+  int mFd;
+  uint64_t mOffset = 0;
+  std::vector<IndexEntry> mIndex;
+  std::vector<unsigned char> mWriteBuffer;
+
+  void flushWrites() {
+    if(!mWriteBuffer.empty()) {
+      osmium::io::detail::reliable_write(mFd, mWriteBuffer.data(), mWriteBuffer.size());
+      mWriteBuffer.clear();
+    }
+  }
+};
+
+#endif // MEMBERSTORE_HPP
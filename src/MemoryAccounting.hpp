@@ -0,0 +1,220 @@
+
+// Rosmium: R bindings for the Osmium library
+// Copyright (C) 2016 Lukas Huwiler
+//
+// This file is part of Rosmium.
+//
+// Rosmium is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Rosmium is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Rosmium.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef MEMORYACCOUNTING_HPP
+#define MEMORYACCOUNTING_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+class MemoryBudgetExceeded : public std::runtime_error {
+public:
+  explicit MemoryBudgetExceeded(const std::string& report) : std::runtime_error(report) {}
+};
+
+// Approximate heap usage of an id set (nodes plus bucket array).
+template <typename T>
+inline size_t usedMemory(const std::unordered_set<T>& ids) {
+  return ids.size() * (sizeof(T) + 2 * sizeof(void*)) + ids.bucket_count() * sizeof(void*);
+}
+
+struct MemoryComponent {
+  typedef std::function<size_t()> probe_type;
+  typedef std::function<bool()> relief_type;
+
+  std::string name;
+  probe_type probe;
+  relief_type relief;
+  size_t current = 0;
+  size_t peak = 0;
+};
+
+/**
+ * Keeps track of the memory used by the components of a job (location
+ * indexes, collector buffers, id sets, results passed to R). Every
+ * component registers a probe which returns its current size in bytes.
+ * The probes are sampled by check(), which is called once per buffer.
+ *
+ * If a budget is set and the sum of all components exceeds it, the
+ * registered reliefs (e.g. moving an index to disk) are tried first.
+ * If the job is still over budget a MemoryBudgetExceeded exception with
+ * a report of all components is thrown.
+ */
+class MemoryTracker {
+public:
+
+  void setBudget(size_t bytes, bool use_reliefs = true) {
+    mBudget = bytes;
+    mUseReliefs = use_reliefs;
+  }
+
+  size_t getBudget() const {
+    return mBudget;
+  }
+
+  /**
+   * Register a component. If a component with the same name is already
+   * known, its probe is replaced but its peak value is kept, so peaks
+   * survive several runs on the same reader.
+   */
+  void track(const std::string& name, MemoryComponent::probe_type probe, MemoryComponent::relief_type relief = nullptr) {
+    MemoryComponent& component = find(name);
+    component.probe = probe;
+    component.relief = relief;
+    update(component);
+  }
+
+  /**
+   * Take a last sample of the component and stop tracking it. Has to be
+   * called before the object the probe refers to goes out of scope.
+   */
+  void release(const std::string& name) {
+    MemoryComponent& component = find(name);
+    update(component);
+    component.probe = nullptr;
+    component.relief = nullptr;
+    component.current = 0;
+  }
+
+  size_t sample() {
+    size_t total = 0;
+    for(MemoryComponent& component : mComponents) {
+      total += update(component);
+    }
+    mPeak = std::max(mPeak, total);
+    return total;
+  }
+
+  void check() {
+    size_t total = sample();
+    if(mBudget == 0 || total <= mBudget) {
+      return;
+    }
+    if(mUseReliefs) {
+      bool relieved = false;
+      for(MemoryComponent& component : mComponents) {
+        if(component.relief != nullptr && component.relief()) {
+          relieved = true;
+        }
+      }
+      if(relieved) {
+        total = sample();
+      }
+    }
+    if(total > mBudget) {
+      throw MemoryBudgetExceeded(report());
+    }
+  }
+
+  size_t current() const {
+    size_t total = 0;
+    for(const MemoryComponent& component : mComponents) {
+      total += component.current;
+    }
+    return total;
+  }
+
+  size_t peak() const {
+    return mPeak;
+  }
+
+  const std::vector<MemoryComponent>& components() const {
+    return mComponents;
+  }
+
+  std::string report() const {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    out << "Memory budget of " << toMB(mBudget) << " MB exceeded (" << toMB(current()) << " MB in use)\n";
+    for(const MemoryComponent& component : mComponents) {
+      out << "  " << std::left << std::setw(24) << component.name
+          << std::right << std::setw(10) << toMB(component.current) << " MB current"
+          << std::setw(10) << toMB(component.peak) << " MB peak\n";
+    }
+    return out.str();
+  }
+
+  void reset() {
+    mComponents.clear();
+    mPeak = 0;
+  }
+
+private:
+  std::vector<MemoryComponent> mComponents;
+  size_t mBudget = 0;
+  size_t mPeak = 0;
+  bool mUseReliefs = true;
+
+  MemoryComponent& find(const std::string& name) {
+    for(MemoryComponent& component : mComponents) {
+      if(component.name == name) {
+        return component;
+      }
+    }
+    mComponents.push_back(MemoryComponent());
+    mComponents.back().name = name;
+    return mComponents.back();
+  }
+
+  static size_t update(MemoryComponent& component) {
+    if(component.probe != nullptr) {
+      component.current = component.probe();
+      component.peak = std::max(component.peak, component.current);
+    }
+    return component.current;
+  }
+
+  static double toMB(size_t bytes) {
+    return bytes / (1024.0 * 1024.0);
+  }
+};
+
+/**
+ * Tracks a component for the lifetime of this object. Declare it right after
+ * the object the probe refers to, so the probe is released before the object
+ * is destroyed (also when an exception is thrown).
+ */
+class TrackedComponent {
+public:
+  TrackedComponent(MemoryTracker& tracker, const std::string& name,
+                   MemoryComponent::probe_type probe, MemoryComponent::relief_type relief = nullptr) :
+    mTracker(tracker), mName(name) {
+    mTracker.track(name, probe, relief);
+  }
+
+  TrackedComponent(const TrackedComponent&) = delete;
+  TrackedComponent& operator=(const TrackedComponent&) = delete;
+
+  ~TrackedComponent() {
+    mTracker.release(mName);
+  }
+
+private:
+  MemoryTracker& mTracker;
+  std::string mName;
+};
+
+#endif // MEMORYACCOUNTING_HPP
@@ -0,0 +1,108 @@
+
+// Rosmium: R bindings for the Osmium library
+// Copyright (C) 2016 Lukas Huwiler
+//
+// This file is part of Rosmium.
+//
+// Rosmium is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Rosmium is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Rosmium.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef NATIVEEXTENSION_HPP
+#define NATIVEEXTENSION_HPP
+
+#include <stdexcept>
+#include <string>
+#include <Rcpp.h>
+#include <osmium/handler.hpp>
+#include <Rosmium/native.hpp>
+
+#include "object_filter/command.h"
+
+// The struct behind an external pointer of rosmium::make_predicate() or make_handler(), checked by tag and ABI version
+template <typename T>
+T* nativeObject(SEXP pointer, const char* tag, const std::string& maker) {
+  if(TYPEOF(pointer) != EXTPTRSXP || R_ExternalPtrTag(pointer) != Rf_install(tag)) {
+    throw std::invalid_argument("Expected an external pointer created with rosmium::" + maker + "()");
+  }
+  T* object = static_cast<T*>(R_ExternalPtrAddr(pointer));
+  if(object == nullptr) {
+    throw std::invalid_argument("The native object has been released (e.g. by saving and reloading the session)");
+  }
+  if(object->abi_version != rosmium::native_abi_version) {
+    throw std::invalid_argument("The native object was compiled against another version of Rosmium, recompile it");
+  }
+  return object;
+}
+
+// Filter leaf calling a user-compiled predicate
+class NativePredicateCommand : public tagfilter::Command {
+public:
+
+  explicit NativePredicateCommand(SEXP pointer) :
+    mPointer(pointer),
+    mPredicate(nativeObject<rosmium::NativePredicate>(pointer, rosmium::predicate_tag(), "make_predicate")) {
+  }
+
+  bool execute(const osmium::OSMObject& obj) {
+    return mPredicate->predicate(obj, mPredicate->data);
+  }
+
+private:
+  // Keeps the external pointer (and so the predicate) alive as long as the filter
+  Rcpp::RObject mPointer;
+  rosmium::NativePredicate* mPredicate;
+};
+
+// Osmium handler forwarding the objects to a user-compiled handler
+class NativeHandlerAdapter : public osmium::handler::Handler {
+public:
+
+  explicit NativeHandlerAdapter(SEXP pointer) :
+    mPointer(pointer),
+    mHandler(nativeObject<rosmium::NativeHandler>(pointer, rosmium::handler_tag(), "make_handler")) {
+  }
+
+  void node(const osmium::Node& node) {
+    if(mHandler->node != nullptr) {
+      mHandler->node(node, mHandler->data);
+    }
+  }
+
+  void way(const osmium::Way& way) {
+    if(mHandler->way != nullptr) {
+      mHandler->way(way, mHandler->data);
+    }
+  }
+
+  void relation(const osmium::Relation& relation) {
+    if(mHandler->relation != nullptr) {
+      mHandler->relation(relation, mHandler->data);
+    }
+  }
+
+  void flush() {
+    if(mHandler->flush != nullptr) {
+      mHandler->flush(mHandler->data);
+    }
+  }
+
+private:
+  Rcpp::RObject mPointer;
+  rosmium::NativeHandler* mHandler;
+};
+
+inline bool isNativeHandler(SEXP pointer) {
+  return TYPEOF(pointer) == EXTPTRSXP && R_ExternalPtrTag(pointer) == Rf_install(rosmium::handler_tag());
+}
+
+#endif // NATIVEEXTENSION_HPP
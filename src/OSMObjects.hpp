@@ -21,6 +21,7 @@
 #define OSMOBJECTS_HPP
 
 #include <Rcpp.h>
+#include <cstring>
 #include <osmium/osm/object.hpp>
 #include <osmium/osm/node.hpp>
 #include <osmium/osm/way.hpp>
@@ -29,6 +30,8 @@
 #include <osmium/geom/factory.hpp>
 #include <osmium/geom/wkb.hpp>
 
+#include "GeometryCheck.hpp"
+
 //Rcpp::NumericVector getLocation(const Rcpp::XPtr<const osmium::Node>& node) {
 //  osmium::Location loc = node->location();
 //  // SEXP ret = Rcpp::NumericVector::create(Rcpp::Named("lon") = loc.lon(), Rcpp::Named("lat") = loc.lat());
@@ -121,21 +124,48 @@ public:
   
   Rcpp::List createRArea(const osmium::Area& area) {
     Rcpp::List ret = Rcpp::List::create(Rcpp::Named("id") = getId(area), Rcpp::Named("tags") = getTags(area),
-                                        Rcpp::Named("geom") = createWKB(area));
+                                        Rcpp::Named("geom") = mGeomFactory != nullptr ? createWKB(area) : Rcpp::CharacterVector());
     ret.attr("class") = "area";
     return ret;   
   }
   
+  // Area from a closed way, with the same id as an area assembled by osmium from this way
+  Rcpp::List createRArea(const osmium::Way& way) {
+    mEstimatedSize += 3 * sexp_size;
+    Rcpp::CharacterVector id = Rcpp::CharacterVector::create(std::to_string(osmium::object_id_to_area_id(way.id(), osmium::item_type::way)));
+    Rcpp::List ret = Rcpp::List::create(Rcpp::Named("id") = id, Rcpp::Named("tags") = getTags(way),
+                                        Rcpp::Named("geom") = mGeomFactory != nullptr ? createWKB(way, true) : Rcpp::CharacterVector());
+    ret.attr("class") = "area";
+    return ret;
+  }
+  
+  const GeometryCounters& geometryCounters() const {
+    return mGeometryCounters;
+  }
+  
+  // Rough estimate of the memory (in bytes) used by all objects created so far
+  size_t estimatedSize() const {
+    return mEstimatedSize;
+  }
+  
 private:
   
+  // Approximate size of a SEXP header (vector or CHARSXP) 
+  static constexpr size_t sexp_size = 56;
+  
+  
   std::shared_ptr<osmium::geom::WKBFactory<>> mGeomFactory = nullptr;
   bool mIncludeId = false;
   bool mIncludeTags = false;
   bool mIncludeLocation = false;
   bool mIncludeNodeRefs = false;
   bool mIncludeMembers = false;
+  size_t mEstimatedSize = 0;
+  GeometryCounters mGeometryCounters;
+  std::string mWKB;
 
   Rcpp::CharacterVector getId(const osmium::OSMObject& obj) {
+    mEstimatedSize += 3 * sexp_size;
     return Rcpp::CharacterVector::create(std::to_string(obj.id()));
   }
   
@@ -143,8 +173,10 @@ private:
     const osmium::TagList& tags = obj.tags();
     Rcpp::CharacterMatrix ret(tags.size(), 2);
     colnames(ret) = Rcpp::CharacterVector::create("key","value");
+    mEstimatedSize += sexp_size + tags.size() * 2 * (sizeof(SEXP) + sexp_size);
     int row = 0;
     for(auto it = tags.cbegin(); it != tags.cend(); ++it) {
+      mEstimatedSize += std::strlen(it->key()) + std::strlen(it->value());
       ret(row, 0) = Rcpp::String(it->key());
       ret(row, 1) = Rcpp::String(it->value());
       row++;
@@ -154,6 +186,7 @@ private:
   
   Rcpp::NumericMatrix getNodeRefs(const osmium::Way& way) {
     Rcpp::NumericMatrix ret(way.nodes().size(), 2);
+    mEstimatedSize += 2 * sexp_size + way.nodes().size() * (2 * sizeof(double) + sizeof(SEXP) + sexp_size);
     std::fill(ret.begin(), ret.end(), Rcpp::NumericVector::get_na());
     int row = 0;
     colnames(ret) = Rcpp::CharacterVector::create("lon","lat");
@@ -182,6 +215,7 @@ private:
   Rcpp::CharacterMatrix getRelMembers(const osmium::Relation& rel) {
     const osmium::RelationMemberList& members = rel.members(); 
     Rcpp::CharacterMatrix ret(members.size(), 2);
+    mEstimatedSize += 2 * sexp_size + members.size() * (3 * sizeof(SEXP) + sexp_size);
     std::fill(ret.begin(), ret.end(), Rcpp::CharacterVector::get_na());
     colnames(ret) = Rcpp::CharacterVector::create("entity_type","role");
     Rcpp::CharacterVector row_names = Rcpp::CharacterVector(members.size());
@@ -203,48 +237,60 @@ private:
   }
   
   Rcpp::CharacterVector createWKB(const osmium::Node& node) {
-    Rcpp::CharacterVector ret(1);
-    try {
-      ret[0] = mGeomFactory->create_point(node);
-      ret.attr("class") = "wkb";
-      return ret; 
-    } catch(std::exception& e) {
-      ret[0] = e.what();
-      ret.attr("class") = "invalid_geometry";
-      return ret;
+    GeometryProblem problem = checkPoint(node);
+    if(problem == GeometryProblem::none) {
+      mGeomFactory->create_point(node, mWKB);
+      return wrapWKB();
     }
+    return invalidGeometry(problem);
   }
   
-  Rcpp::CharacterVector createWKB(const osmium::Way& way) {
-//    if(way.is_closed()) {
-//      // return mGeomFactory->create_polygon(way);
-//    } else {
-    Rcpp::CharacterVector ret(1);
-    try {
-      ret[0] = mGeomFactory->create_linestring(way); 
-      ret.attr("class") = "wkb";
-      return ret; 
-    } catch(std::exception& e) {
-      ret[0] = e.what();
-      ret.attr("class") = "invalid_geometry";
-      return ret;
-    }
-//    }
+  Rcpp::CharacterVector createWKB(const osmium::Way& way, bool as_polygon = false) {
+    if(as_polygon && way.is_closed()) {
+      GeometryProblem problem = checkPolygon(way);
+      if(problem == GeometryProblem::none) {
+        mGeomFactory->create_polygon(way, mWKB);
+        return wrapWKB();
+      }
+      return invalidGeometry(problem);
+    }
+    GeometryProblem problem = checkLinestring(way);
+    if(problem == GeometryProblem::none) {
+      mGeomFactory->create_linestring(way, mWKB);
+      return wrapWKB();
+    }
+    return invalidGeometry(problem);
   }
   
   Rcpp::CharacterVector createWKB(const osmium::Area& area) {
-    Rcpp::CharacterVector ret(1);
-    try {
-      ret[0] = mGeomFactory->create_multipolygon(area);
-      ret.attr("class") = "wkb"; 
-      return ret; 
-    } catch(std::exception& e) {
-      ret[0] = e.what();
-      ret.attr("class") = "invalid_geometry";
-      return ret;
+    GeometryProblem problem = checkMultipolygon(area);
+    if(problem == GeometryProblem::none) {
+      mGeomFactory->create_multipolygon(area, mWKB);
+      return wrapWKB();
     }
+    return invalidGeometry(problem);
   } 
   
+  // The factory writes every geometry into the same buffer, which is copied directly into the CHARSXP
+  Rcpp::CharacterVector wrapWKB() {
+    mGeometryCounters.count(GeometryProblem::none);
+    mEstimatedSize += 2 * sexp_size + mWKB.size();
+    Rcpp::CharacterVector ret(1);
+    SET_STRING_ELT(ret, 0, Rf_mkCharLen(mWKB.data(), static_cast<int>(mWKB.size())));
+    ret.attr("class") = "wkb";
+    return ret;
+  }
+  
+  // Objects failing the checks get an NA geometry, the reason is only counted
+  Rcpp::CharacterVector invalidGeometry(GeometryProblem problem) {
+    mGeometryCounters.count(problem);
+    mEstimatedSize += 2 * sexp_size;
+    Rcpp::CharacterVector ret(1);
+    ret[0] = NA_STRING;
+    ret.attr("class") = "invalid_geometry";
+    return ret;
+  }
+  
 };
 
 #endif // OSMOBJECTS_HPP
\ No newline at end of file
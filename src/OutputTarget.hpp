@@ -0,0 +1,158 @@
+
+// Rosmium: R bindings for the Osmium library
+// Copyright (C) 2016 Lukas Huwiler
+//
+// This file is part of Rosmium.
+//
+// Rosmium is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Rosmium is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Rosmium.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef OUTPUTTARGET_HPP
+#define OUTPUTTARGET_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <osmium/io/compression.hpp>
+#include <osmium/io/file.hpp>
+#include <osmium/io/writer.hpp>
+
+// Encoded data of a writer waiting to be passed on by the main thread (e.g. to an R connection)
+class SinkQueue {
+public:
+
+  void push(const std::string& data) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mChunks.push_back(data);
+    mPending += data.size();
+  }
+
+  // Bytes not taken yet
+  size_t pending() const {
+    return mPending;
+  }
+
+  std::deque<std::string> take() {
+    std::deque<std::string> chunks;
+    std::lock_guard<std::mutex> lock(mMutex);
+    chunks.swap(mChunks);
+    mPending = 0;
+    return chunks;
+  }
+
+private:
+  std::mutex mMutex;
+  std::deque<std::string> mChunks;
+  std::atomic<size_t> mPending{0};
+};
+
+/**
+ * Compressor which hands the data of the write thread over to a SinkQueue.
+ * It never blocks the write thread: the main thread, which feeds the writer,
+ * empties the queue whenever it holds more than a limit, so the writer can
+ * not deadlock while its output queue is full.
+ */
+class SinkCompressor : public osmium::io::Compressor {
+public:
+
+  explicit SinkCompressor(std::shared_ptr<SinkQueue> queue) :
+    osmium::io::Compressor(osmium::io::fsync::no),
+    mQueue(queue) {
+  }
+
+  void write(const std::string& data) override {
+    mQueue->push(data);
+  }
+
+  void close() override {
+  }
+
+private:
+  std::shared_ptr<SinkQueue> mQueue;
+};
+
+/**
+ * Where a WriteHandler writes to: a file (a named pipe is opened for
+ * writing without being truncated), an open file descriptor (e.g. stdout)
+ * or a SinkQueue. Only files get their format from the suffix of the name.
+ * A file descriptor is duplicated, so the writer never closes the original.
+ */
+struct OutputTarget {
+  enum class Kind {
+    file,
+    fd,
+    sink
+  };
+
+  Kind kind = Kind::file;
+  std::string filename;
+  // Format and compression (e.g. "pbf" or "osm.gz"), overrides the suffix of the file name
+  std::string format;
+  int fd = -1;
+  bool overwrite = false;
+
+  std::shared_ptr<osmium::io::Writer> open(std::shared_ptr<SinkQueue>& sink) const {
+    if(kind == Kind::file && filename != "" && filename != "-" && !isPipe(filename)) {
+      osmium::io::File file(filename, format);
+      return std::make_shared<osmium::io::Writer>(file, overwrite ? osmium::io::overwrite::allow : osmium::io::overwrite::no);
+    }
+    if(format.empty()) {
+      throw std::invalid_argument("The format of the output (e.g. \"pbf\" or \"osm.gz\") is needed for pipes, file descriptors and connections");
+    }
+    osmium::io::File file("", format);
+    std::unique_ptr<osmium::io::Compressor> compressor;
+    if(kind == Kind::sink) {
+      if(file.compression() != osmium::io::file_compression::none) {
+        throw std::invalid_argument("Connections are written uncompressed, use a compressing connection (e.g. gzfile()) instead");
+      }
+      sink = std::make_shared<SinkQueue>();
+      compressor.reset(new SinkCompressor(sink));
+    } else {
+      compressor = osmium::io::CompressionFactory::instance().create_compressor(file.compression(), openDescriptor(), osmium::io::fsync::no);
+    }
+    return std::make_shared<osmium::io::Writer>(file, std::move(compressor));
+  }
+
+private:
+  static bool isPipe(const std::string& filename) {
+    struct stat info;
+    return ::stat(filename.c_str(), &info) == 0 && S_ISFIFO(info.st_mode);
+  }
+
+  int openDescriptor() const {
+    int result;
+    if(kind == Kind::fd) {
+      result = ::dup(fd);
+    } else if(filename == "" || filename == "-") {
+      result = ::dup(1);
+    } else {
+      // Blocks until the pipe has a reader
+      result = ::open(filename.c_str(), O_WRONLY);
+    }
+    if(result < 0) {
+      throw std::system_error(errno, std::system_category(), "Can not open the output " +
+                              (kind == Kind::fd ? "file descriptor " + std::to_string(fd) : filename));
+    }
+    return result;
+  }
+};
+
+#endif // OUTPUTTARGET_HPP
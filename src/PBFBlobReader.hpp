@@ -0,0 +1,185 @@
+
+// Rosmium: R bindings for the Osmium library
+// Copyright (C) 2016 Lukas Huwiler
+//
+// This file is part of Rosmium.
+//
+// Rosmium is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Rosmium is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Rosmium.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PBFBLOBREADER_HPP
+#define PBFBLOBREADER_HPP
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <protozero/pbf_message.hpp>
+#include <osmium/io/detail/pbf.hpp>
+#include <osmium/io/detail/pbf_decoder.hpp>
+#include <osmium/io/detail/protobuf_tags.hpp>
+#include <osmium/io/detail/read_write.hpp>
+#include <osmium/io/error.hpp>
+#include <osmium/io/file.hpp>
+
+#include "PositionalRead.hpp"
+
+// A data blob of a PBF file with its position (offset of the length prefix and size including the BlobHeader)
+struct PBFBlob {
+  uint64_t offset = 0;
+  uint64_t size = 0;
+  std::string data;
+
+  uint64_t end() const {
+    return offset + size;
+  }
+};
+
+/**
+ * Reads the data blobs of an uncompressed PBF file one by one and knows
+ * where each of them starts, so reading can continue at any blob. The
+ * osmium::io::Reader hides the blob structure. The blobs are decoded with
+ * osmium's PBFDataBlobDecoder, e.g. on the osmium thread pool.
+ */
+class PBFBlobReader {
+public:
+
+  explicit PBFBlobReader(const std::string& filename) :
+    mFilename(filename) {
+    const osmium::io::File file(filename);
+    if(file.format() != osmium::io::file_format::pbf || file.compression() != osmium::io::file_compression::none) {
+      throw std::invalid_argument("Reading by blobs needs an uncompressed PBF file: " + filename);
+    }
+    mFd = osmium::io::detail::open_for_reading(filename);
+    PBFBlob header;
+    if(!readBlob(header, "OSMHeader", false)) {
+      ::close(mFd);
+      throw osmium::pbf_error("no OSMHeader blob in " + filename);
+    }
+    mDataStart = header.end();
+    mOffset = mDataStart;
+  }
+
+  PBFBlobReader(const PBFBlobReader&) = delete;
+  PBFBlobReader& operator=(const PBFBlobReader&) = delete;
+
+  ~PBFBlobReader() {
+    ::close(mFd);
+  }
+
+  // Offset of the first data blob
+  uint64_t dataStart() const {
+    return mDataStart;
+  }
+
+  // Offset of the next blob next() returns
+  uint64_t offset() const {
+    return mOffset;
+  }
+
+  // Continues at the blob starting at the offset (which has to be the start of a blob)
+  void seek(uint64_t offset) {
+    if(offset < mDataStart) {
+      throw std::invalid_argument("Offset " + std::to_string(offset) + " is in the header of " + mFilename);
+    }
+    mOffset = offset;
+  }
+
+  // Reads the next data blob, false at the end of the file
+  bool next(PBFBlob& blob) {
+    return readBlob(blob, "OSMData", true);
+  }
+
+  // Steps over the next data blob, setting only its position (for listing the blobs of a file)
+  bool skip(PBFBlob& blob) {
+    return readBlob(blob, "OSMData", false);
+  }
+
+private:
+  std::string mFilename;
+  int mFd = -1;
+  uint64_t mDataStart = 0;
+  uint64_t mOffset = 0;
+
+  // Reads exactly size bytes at the offset, false if the file ends before the first byte
+  bool readAt(uint64_t offset, char* data, size_t size) {
+    size_t done = 0;
+    while(done < size) {
+      const ssize_t n = readAtOffset(mFd, data + done, size - done, offset + done);
+      if(n < 0) {
+        if(errno == EINTR) {
+          continue;
+        }
+        throw std::system_error(errno, std::system_category(), "Read failed for '" + mFilename + "'");
+      }
+      if(n == 0) {
+        if(done == 0) {
+          return false;
+        }
+        throw osmium::pbf_error("truncated data (EOF encountered) at offset " + std::to_string(offset));
+      }
+      done += static_cast<size_t>(n);
+    }
+    return true;
+  }
+
+  bool readBlob(PBFBlob& blob, const char* expected_type, bool with_data) {
+    uint32_t size_in_network_byte_order;
+    if(!readAt(mOffset, reinterpret_cast<char*>(&size_in_network_byte_order), sizeof(size_in_network_byte_order))) {
+      return false;
+    }
+    const uint32_t header_size = ntohl(size_in_network_byte_order);
+    if(header_size > static_cast<uint32_t>(osmium::io::detail::max_blob_header_size)) {
+      throw osmium::pbf_error("invalid BlobHeader size at offset " + std::to_string(mOffset) +
+                              " (not the start of a blob?)");
+    }
+    std::string header(header_size, '\0');
+    if(!readAt(mOffset + sizeof(uint32_t), &header[0], header_size)) {
+      throw osmium::pbf_error("truncated data (EOF encountered)");
+    }
+    std::string type;
+    size_t data_size = 0;
+    protozero::pbf_message<osmium::io::detail::FileFormat::BlobHeader> pbf_blob_header(header);
+    while(pbf_blob_header.next()) {
+      switch(pbf_blob_header.tag()) {
+        case osmium::io::detail::FileFormat::BlobHeader::required_string_type:
+          type = pbf_blob_header.get_string();
+          break;
+        case osmium::io::detail::FileFormat::BlobHeader::required_int32_datasize:
+          data_size = static_cast<size_t>(pbf_blob_header.get_int32());
+          break;
+        default:
+          pbf_blob_header.skip();
+      }
+    }
+    if(type != expected_type || data_size == 0 || data_size > osmium::io::detail::max_uncompressed_blob_size) {
+      throw osmium::pbf_error("invalid blob at offset " + std::to_string(mOffset) + " (expected " + expected_type + ")");
+    }
+    blob.offset = mOffset;
+    blob.size = sizeof(uint32_t) + header_size + data_size;
+    if(with_data) {
+      blob.data.resize(data_size);
+      if(!readAt(mOffset + sizeof(uint32_t) + header_size, &blob.data[0], data_size)) {
+        throw osmium::pbf_error("truncated data (EOF encountered)");
+      }
+    } else {
+      blob.data.clear();
+    }
+    mOffset = blob.end();
+    return true;
+  }
+};
+
+#endif // PBFBLOBREADER_HPP
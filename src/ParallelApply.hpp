@@ -0,0 +1,126 @@
+
+// Rosmium: R bindings for the Osmium library
+// Copyright (C) 2016 Lukas Huwiler
+//
+// This file is part of Rosmium.
+//
+// Rosmium is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Rosmium is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Rosmium.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PARALLELAPPLY_HPP
+#define PARALLELAPPLY_HPP
+
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <osmium/io/reader.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/visitor.hpp>
+
+// Number of worker threads used if 0 is requested
+inline size_t defaultApplyThreads() {
+  const unsigned int cores = std::thread::hardware_concurrency();
+  return cores == 0 ? 1 : cores;
+}
+
+// Default combine step: the handler merges the result of another worker itself
+struct MergeCombine {
+  template <typename THandler>
+  void operator()(THandler& result, THandler& part) const {
+    result.merge(part);
+  }
+};
+
+/**
+ * Map-reduce version of osmium::apply(). Every worker thread has its own
+ * handler and takes buffers from the reader as soon as they are decoded
+ * (the reader is switched to unordered reads, so a block which is slow to
+ * decode does not hold up the ones after it).
+ * The first worker uses the given handler, the others use copies of it
+ * which are cleared before the start (so configuration is kept, but not
+ * earlier results). When the file is exhausted the copies are folded into
+ * the handler with the combine step (by default handler.merge(other)).
+ *
+ * Buffers are processed in no particular order, so the handler must not
+ * depend on the order of the objects and the combine step has to be
+ * associative and commutative (e.g. sums, minima, maxima, set unions).
+ * Exceptions thrown in a worker stop all workers and are rethrown here.
+ *
+ * @param reader  The reader, buffers are taken from it under a lock.
+ * @param handler Copyable handler with a clear() method, receives the
+ *                combined result.
+ * @param threads Number of worker threads, 0 to use one per core.
+ * @param combine Functor called as combine(handler, worker_handler).
+ */
+template <typename THandler, typename TCombine = MergeCombine>
+void parallel_apply(osmium::io::Reader& reader, THandler& handler, size_t threads = 0,
+                    TCombine combine = TCombine()) {
+  if(threads == 0) {
+    threads = defaultApplyThreads();
+  }
+  reader.set_read_order(osmium::io::read_order::unordered);
+  if(threads == 1) {
+    osmium::apply(reader, handler);
+    return;
+  }
+
+  THandler prototype(handler);
+  prototype.clear();
+  std::vector<THandler> copies(threads - 1, prototype);
+  std::vector<std::thread> workers;
+  std::vector<std::exception_ptr> errors(threads);
+  std::mutex read_mutex;
+  bool done = false;
+
+  for(size_t i = 0; i < threads; ++i) {
+    THandler* worker_handler = i == 0 ? &handler : &copies[i - 1];
+    workers.emplace_back([&, i, worker_handler]() {
+      try {
+        while(true) {
+          osmium::memory::Buffer buffer;
+          {
+            std::lock_guard<std::mutex> lock(read_mutex);
+            if(done) {
+              return;
+            }
+            buffer = reader.read();
+            if(!buffer) {
+              done = true;
+              return;
+            }
+          }
+          osmium::apply(buffer, *worker_handler);
+        }
+      } catch(...) {
+        errors[i] = std::current_exception();
+        std::lock_guard<std::mutex> lock(read_mutex);
+        done = true;
+      }
+    });
+  }
+  for(std::thread& worker : workers) {
+    worker.join();
+  }
+  for(const std::exception_ptr& error : errors) {
+    if(error) {
+      std::rethrow_exception(error);
+    }
+  }
+  for(THandler& copy : copies) {
+    combine(handler, copy);
+  }
+}
+
+#endif // PARALLELAPPLY_HPP
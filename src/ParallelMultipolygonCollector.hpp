@@ -0,0 +1,412 @@
+
+// Rosmium: R bindings for the Osmium library
+// Copyright (C) 2016 Lukas Huwiler
+//
+// This file is part of Rosmium.
+//
+// Rosmium is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Rosmium is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Rosmium.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PARALLELMULTIPOLYGONCOLLECTOR_HPP
+#define PARALLELMULTIPOLYGONCOLLECTOR_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <osmium/area/assembler.hpp>
+#include <osmium/handler.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/item_type.hpp>
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/relation.hpp>
+#include <osmium/osm/way.hpp>
+#include <osmium/relations/collector.hpp>
+#include <osmium/relations/detail/member_meta.hpp>
+#include <osmium/thread/pool.hpp>
+
+#include "AreaStatistics.hpp"
+#include "MemberStore.hpp"
+
+struct AreaAssemblyResult {
+  osmium::memory::Buffer areas;
+  AreaAssemblyStats stats;
+};
+
+/**
+ * Assembles one relation or a batch of closed ways. The input buffer is
+ * self-contained (the relation is followed by copies of its member ways),
+ * so the task can run on any thread. With collect_stats, the problems are
+ * counted by a reporter of the task and the assembly is timed.
+ */
+template <typename TAssembler>
+struct AreaAssemblyTask {
+  typedef typename TAssembler::config_type assembler_config_type;
+
+  assembler_config_type config;
+  std::shared_ptr<osmium::memory::Buffer> input;
+  std::vector<size_t> members;
+  bool is_relation;
+  bool collect_stats;
+
+  AreaAssemblyResult operator()() const {
+    AreaAssemblyResult result;
+    result.areas = osmium::memory::Buffer(input->committed() + 1024, osmium::memory::Buffer::auto_grow::yes);
+    osmium::memory::Buffer& output = result.areas;
+    CountingProblemReporter reporter;
+    assembler_config_type task_config = config;
+    if(collect_stats) {
+      task_config.problem_reporter = &reporter;
+      task_config.timings = true;
+    }
+    if(is_relation) {
+      const osmium::Relation& relation = input->get<osmium::Relation>(0);
+      const size_t offset = output.committed();
+      TAssembler assembler(task_config);
+      bool valid = false;
+      try {
+        assembler(relation, members, *input, output);
+        valid = hasRings(output, offset);
+      } catch(osmium::invalid_location&) {
+        // relations with missing node locations are ignored, as in the MultipolygonCollector
+      }
+      if(collect_stats) {
+        const osmium::area::AssemblerTimings& timings = assembler.timings();
+        result.stats.relations.push_back({relation.id(), static_cast<uint32_t>(members.size()),
+                                          static_cast<uint32_t>(timings.segments), timings.extract_segments,
+                                          timings.create_rings, timings.build_area,
+                                          static_cast<uint32_t>(reporter.counts.total()), valid});
+      }
+    } else {
+      for(auto it = input->cbegin<osmium::Way>(); it != input->cend<osmium::Way>(); ++it) {
+        const osmium::Way& way = *it;
+        const size_t offset = output.committed();
+        TAssembler assembler(task_config);
+        try {
+          assembler(way, output);
+          result.stats.valid_ways += collect_stats && hasRings(output, offset);
+        } catch(osmium::invalid_location&) {
+        }
+        if(collect_stats) {
+          ++result.stats.ways;
+          result.stats.way_seconds += assembler.timings().total();
+        }
+      }
+    }
+    result.stats.problems = reporter.counts;
+    return result;
+  }
+
+  static bool hasRings(const osmium::memory::Buffer& output, size_t offset) {
+    return output.committed() > offset && output.get<osmium::Area>(offset).num_rings().first > 0;
+  }
+};
+
+/**
+ * Drop-in replacement for osmium::area::MultipolygonCollector which assembles
+ * the areas on the threads of the osmium pool instead of the thread reading
+ * the file. Every completed relation is copied together with its member ways
+ * into its own buffer and submitted to the pool; closed ways which are not
+ * members of a multipolygon are submitted in batches (one per input buffer).
+ *
+ * The assembled areas are passed to the callback of the second pass handler
+ * on the reading thread as soon as they are ready, either in the order the
+ * relations were completed (ordered) or in the order the assembly finished
+ * (unordered, a slow relation does not hold back the others). At most
+ * max_pending assemblies are in flight, after that the reading thread waits.
+ * finish() has to be called after the second pass to wait for the remaining
+ * assemblies.
+ *
+ * The member ways of relations which are not complete yet are kept in memory
+ * by the relations::Collector. After startSpill() (e.g. called as relief of
+ * the memory tracker) they are moved to a MemberStore on disk instead, and
+ * all member ways coming along afterwards are written there as well. The
+ * relations which were not complete at that point are assembled in
+ * finish(), reading their members back from disk one relation at a time.
+ */
+template <typename TAssembler>
+class ParallelMultipolygonCollector :
+  public osmium::relations::Collector<ParallelMultipolygonCollector<TAssembler>, false, true, false> {
+
+  typedef osmium::relations::Collector<ParallelMultipolygonCollector<TAssembler>, false, true, false> collector_type;
+  typedef typename TAssembler::config_type assembler_config_type;
+
+  struct PendingAssembly {
+    std::future<AreaAssemblyResult> result;
+    size_t input_size;
+  };
+
+public:
+
+  typedef std::function<void(osmium::memory::Buffer&&)> callback_func_type;
+
+  /**
+   * Second pass handler, which passes the ways to the relations::Collector
+   * or, after startSpill(), writes member ways to the MemberStore.
+   */
+  class SecondPassHandler : public osmium::handler::Handler {
+  public:
+
+    SecondPassHandler(ParallelMultipolygonCollector& collector,
+                      typename collector_type::HandlerPass2& handler) :
+      mCollector(collector), mHandler(handler) {
+    }
+
+    void way(const osmium::Way& way) {
+      if(mCollector.mStore == nullptr) {
+        mHandler.way(way);
+      } else if(std::binary_search(mCollector.mSpillIds.begin(), mCollector.mSpillIds.end(), way.id())) {
+        mCollector.mStore->add(way);
+      } else {
+        mCollector.way_not_in_any_relation(way);
+      }
+    }
+
+    void flush() {
+      mHandler.flush();
+    }
+
+  private:
+    ParallelMultipolygonCollector& mCollector;
+    typename collector_type::HandlerPass2& mHandler;
+  };
+
+  static constexpr size_t default_max_pending = 64;
+
+  explicit ParallelMultipolygonCollector(const assembler_config_type& assembler_config, bool ordered = true,
+                                         size_t max_pending = default_max_pending) :
+    collector_type(),
+    mAssemblerConfig(assembler_config),
+    mOrdered(ordered),
+    mMaxPending(max_pending == 0 ? 1 : max_pending),
+    mWays(new osmium::memory::Buffer(initial_batch_size, osmium::memory::Buffer::auto_grow::yes)) {
+  }
+
+  bool keep_relation(const osmium::Relation& relation) const {
+    const char* type = relation.tags().get_value_by_key("type");
+    return type && (!std::strcmp(type, "multipolygon") || !std::strcmp(type, "boundary"));
+  }
+
+  bool keep_member(const osmium::relations::RelationMeta&, const osmium::RelationMember& member) const {
+    return member.type() == osmium::item_type::way;
+  }
+
+  void way_not_in_any_relation(const osmium::Way& way) {
+    // you need at least 4 nodes to make up a polygon
+    if(way.nodes().size() <= 3 || !way.nodes().front().location() || !way.nodes().back().location()) {
+      return;
+    }
+    if(way.ends_have_same_location()) {
+      mWays->add_item(way);
+      mWays->commit();
+    }
+  }
+
+  void complete_relation(osmium::relations::RelationMeta& relation_meta) {
+    const osmium::Relation& relation = this->get_relation(relation_meta);
+    std::shared_ptr<osmium::memory::Buffer> input(
+      new osmium::memory::Buffer(relation.byte_size() + initial_batch_size, osmium::memory::Buffer::auto_grow::yes));
+    input->add_item(relation);
+    input->commit();
+    std::vector<size_t> members;
+    for(const auto& member : relation.members()) {
+      if(member.ref() != 0) {
+        members.push_back(input->committed());
+        input->add_item(this->get_member(this->get_offset(member.type(), member.ref())));
+        input->commit();
+      }
+    }
+    submit(input, std::move(members), true);
+  }
+
+  SecondPassHandler& handler(const callback_func_type& callback = nullptr) {
+    mSecondPass.reset(new SecondPassHandler(*this, collector_type::handler(callback)));
+    return *mSecondPass;
+  }
+
+  /**
+   * Move the members collected so far to disk and write all further members
+   * there. Can be called before or during the second pass.
+   *
+   * @returns false if the members are already spilled
+   */
+  bool startSpill() {
+    if(mStore != nullptr) {
+      return false;
+    }
+    mStore.reset(new MemberStore());
+    for(const auto& relation_meta : this->relations()) {
+      if(!relation_meta.has_all_members()) {
+        for(const auto& member : this->get_relation(relation_meta).members()) {
+          if(member.ref() != 0) {
+            mSpillIds.push_back(member.ref());
+          }
+        }
+      }
+    }
+    std::sort(mSpillIds.begin(), mSpillIds.end());
+    mSpillIds.erase(std::unique(mSpillIds.begin(), mSpillIds.end()), mSpillIds.end());
+    mSpillIds.shrink_to_fit();
+
+    for(auto it = this->members_buffer().template cbegin<osmium::Way>(); it != this->members_buffer().template cend<osmium::Way>(); ++it) {
+      if(!it->removed()) {
+        mStore->add(*it);
+      }
+    }
+    osmium::memory::Buffer empty(initial_batch_size, osmium::memory::Buffer::auto_grow::yes);
+    std::swap(this->members_buffer(), empty);
+    return true;
+  }
+
+  bool isSpilling() const {
+    return mStore != nullptr;
+  }
+  
+  // Count the problems and time the assembly of every relation, see stats()
+  void collectStats(bool collect = true) {
+    mCollectStats = collect;
+  }
+  
+  // Statistics of the assemblies delivered so far
+  AreaAssemblyStats& stats() {
+    return mStats;
+  }
+
+  // Called after every input buffer: submit the collected closed ways and pass on finished areas
+  void flush() {
+    submitWays();
+    deliver(false);
+  }
+
+  // Assemble the spilled relations, wait for all assemblies and pass on their results
+  void finish() {
+    submitWays();
+    if(mStore != nullptr) {
+      assembleSpilled();
+    }
+    deliver(true);
+  }
+
+  size_t pending() const {
+    return mPending.size();
+  }
+
+  // Memory of the collector including the input buffers of the assemblies in flight
+  uint64_t used_memory() const {
+    uint64_t pending_memory = mWays->capacity();
+    for(const PendingAssembly& assembly : mPending) {
+      pending_memory += assembly.input_size;
+    }
+    if(mStore != nullptr) {
+      pending_memory += mStore->used_memory() + mSpillIds.capacity() * sizeof(osmium::object_id_type);
+    }
+    return collector_type::used_memory() + pending_memory;
+  }
+
+private:
+  static constexpr size_t initial_batch_size = 64 * 1024;
+
+  const assembler_config_type mAssemblerConfig;
+  bool mOrdered;
+  size_t mMaxPending;
+  std::shared_ptr<osmium::memory::Buffer> mWays;
+  std::deque<PendingAssembly> mPending;
+  std::unique_ptr<SecondPassHandler> mSecondPass;
+  std::unique_ptr<MemberStore> mStore;
+  std::vector<osmium::object_id_type> mSpillIds;
+  bool mCollectStats = false;
+  AreaAssemblyStats mStats;
+
+  // Relations with missing members (not in the file) are skipped, as in the relations::Collector
+  void assembleSpilled() {
+    mStore->sort();
+    for(const auto& relation_meta : this->relations()) {
+      if(relation_meta.has_all_members()) {
+        continue;
+      }
+      const osmium::Relation& relation = this->get_relation(relation_meta);
+      std::shared_ptr<osmium::memory::Buffer> input(
+        new osmium::memory::Buffer(relation.byte_size() + initial_batch_size, osmium::memory::Buffer::auto_grow::yes));
+      input->add_item(relation);
+      input->commit();
+      std::vector<size_t> members;
+      bool complete = true;
+      for(const auto& member : relation.members()) {
+        if(member.ref() != 0) {
+          long offset = mStore->get(member.ref(), *input);
+          if(offset < 0) {
+            complete = false;
+            break;
+          }
+          members.push_back(static_cast<size_t>(offset));
+        }
+      }
+      if(complete) {
+        submit(input, std::move(members), true);
+      }
+    }
+  }
+
+  void submitWays() {
+    if(mWays->committed() == 0) {
+      return;
+    }
+    std::shared_ptr<osmium::memory::Buffer> ways = mWays;
+    mWays.reset(new osmium::memory::Buffer(initial_batch_size, osmium::memory::Buffer::auto_grow::yes));
+    submit(ways, std::vector<size_t>(), false);
+  }
+
+  void submit(std::shared_ptr<osmium::memory::Buffer> input, std::vector<size_t>&& members, bool is_relation) {
+    AreaAssemblyTask<TAssembler> task = {mAssemblerConfig, input, std::move(members), is_relation, mCollectStats};
+    PendingAssembly assembly;
+    assembly.input_size = input->capacity();
+    assembly.result = osmium::thread::Pool::instance().submit(task);
+    mPending.push_back(std::move(assembly));
+    deliver(false);
+    while(mPending.size() >= mMaxPending) {
+      mPending.front().result.wait();
+      deliver(false);
+    }
+  }
+
+  static bool isReady(const PendingAssembly& assembly) {
+    return assembly.result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+  }
+
+  void deliver(bool wait) {
+    auto it = mPending.begin();
+    while(it != mPending.end()) {
+      if(wait || isReady(*it)) {
+        AreaAssemblyResult result = it->result.get();
+        it = mPending.erase(it);
+        if(mCollectStats) {
+          mStats.merge(result.stats);
+        }
+        if(result.areas.committed() > 0 && this->callback()) {
+          this->callback()(std::move(result.areas));
+        }
+      } else if(mOrdered) {
+        return;
+      } else {
+        ++it;
+      }
+    }
+  }
+};
+
+#endif // PARALLELMULTIPOLYGONCOLLECTOR_HPP
@@ -0,0 +1,50 @@
+
+// Rosmium: R bindings for the Osmium library
+// Copyright (C) 2016 Lukas Huwiler
+//
+// This file is part of Rosmium.
+//
+// Rosmium is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Rosmium is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Rosmium.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef POSITIONALREAD_HPP
+#define POSITIONALREAD_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <sys/types.h>
+#ifdef _WIN32
+# include <io.h>
+#else
+# include <unistd.h>
+#endif
+
+/**
+ * Reads up to size bytes at the offset of the file, like pread(). mingw has
+ * no pread(), so on Windows the file position is moved with _lseeki64()
+ * first. There, reads of the same descriptor must not run concurrently.
+ */
+inline ssize_t readAtOffset(int fd, void* data, size_t size, uint64_t offset) {
+#ifdef _WIN32
+  if(_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) < 0) {
+    return -1;
+  }
+  const size_t max_read = 0x7fffffff;
+  return _read(fd, data, static_cast<unsigned int>(size < max_read ? size : max_read));
+#else
+  return ::pread(fd, data, size, static_cast<off_t>(offset));
+#endif
+}
+
+#endif // POSITIONALREAD_HPP
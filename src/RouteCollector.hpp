@@ -0,0 +1,414 @@
+
+// Rosmium: R bindings for the Osmium library
+// Copyright (C) 2016 Lukas Huwiler
+//
+// This file is part of Rosmium.
+//
+// Rosmium is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Rosmium is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Rosmium.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ROUTECOLLECTOR_HPP
+#define ROUTECOLLECTOR_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <limits>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <osmium/geom/haversine.hpp>
+#include <osmium/geom/wkb.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/item_type.hpp>
+#include <osmium/osm/node_ref.hpp>
+#include <osmium/osm/relation.hpp>
+#include <osmium/osm/way.hpp>
+#include <osmium/relations/collector.hpp>
+#include <osmium/relations/detail/member_meta.hpp>
+#include <osmium/thread/pool.hpp>
+
+typedef std::vector<osmium::NodeRef> RouteLine;
+
+// Offset of a member way which is not in the file
+static const size_t missing_route_member = std::numeric_limits<size_t>::max();
+
+// Geometry and stitching diagnostics of one route or superroute relation
+struct RouteResult {
+  osmium::object_id_type id = 0;
+  bool superroute = false;
+  std::string route;
+  std::string name;
+  std::string ref;
+  // hex encoded WKB multilinestring, empty if no line could be built
+  std::string wkb;
+  // for superroutes the ways are the child routes
+  uint32_t members = 0;
+  uint32_t ways = 0;
+  uint32_t missing_ways = 0;
+  uint32_t invalid_ways = 0;
+  uint32_t ignored_members = 0;
+  uint32_t segments = 0;
+  uint32_t gaps = 0;
+  uint32_t reversed = 0;
+  double length = 0;
+  // only kept for routes which are members of a superroute
+  std::vector<RouteLine> lines;
+};
+
+/**
+ * Part of a route: the nodes of a member way (or of a line of a child route)
+ * and the direction in which it has to be used. Ways with the role
+ * "forward" are only used in their own direction, ways with the role
+ * "backward" only against it.
+ */
+struct RoutePiece {
+  enum direction_type { any, forward, backward };
+
+  const osmium::NodeRef* begin;
+  const osmium::NodeRef* end;
+  direction_type direction;
+};
+
+/**
+ * Stitches the pieces of a route in member order into as few lines as
+ * possible. A piece is attached to the current line if one of its ends
+ * matches the end of the line (the same node). The first piece of a line
+ * is turned around if the second piece only fits to its start. If no end
+ * matches, a new line is started and a gap is counted.
+ */
+inline void stitchRoute(const std::vector<RoutePiece>& pieces, RouteResult& result) {
+  std::vector<RouteLine> lines;
+  bool single_piece = false;
+  bool fixed_direction = false;
+  for(const RoutePiece& piece : pieces) {
+    RouteLine nodes(piece.begin, piece.end);
+    if(piece.direction == RoutePiece::backward) {
+      std::reverse(nodes.begin(), nodes.end());
+    }
+    if(lines.empty()) {
+      lines.push_back(nodes);
+      single_piece = true;
+      fixed_direction = piece.direction != RoutePiece::any;
+      continue;
+    }
+    RouteLine& line = lines.back();
+    if(single_piece && !fixed_direction && nodes.front().ref() != line.back().ref() &&
+       nodes.back().ref() != line.back().ref() &&
+       (nodes.front().ref() == line.front().ref() || nodes.back().ref() == line.front().ref())) {
+      std::reverse(line.begin(), line.end());
+      ++result.reversed;
+    }
+    if(nodes.front().ref() == line.back().ref()) {
+      line.insert(line.end(), nodes.begin() + 1, nodes.end());
+    } else if(piece.direction == RoutePiece::any && nodes.back().ref() == line.back().ref()) {
+      line.insert(line.end(), nodes.rbegin() + 1, nodes.rend());
+      ++result.reversed;
+    } else {
+      ++result.gaps;
+      lines.push_back(nodes);
+      single_piece = true;
+      fixed_direction = piece.direction != RoutePiece::any;
+      continue;
+    }
+    single_piece = false;
+  }
+
+  result.segments = static_cast<uint32_t>(lines.size());
+  result.length = 0;
+  for(const RouteLine& line : lines) {
+    for(size_t i = 1; i < line.size(); ++i) {
+      result.length += osmium::geom::haversine::distance(line[i - 1].location(), line[i].location());
+    }
+  }
+  result.wkb.clear();
+  if(!lines.empty()) {
+    using osmium::geom::detail::str_push;
+    std::string data;
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+    const uint8_t byte_order = 1;
+#else
+    const uint8_t byte_order = 0;
+#endif
+    str_push(data, byte_order);
+    str_push(data, static_cast<uint32_t>(5)); // MultiLineString
+    str_push(data, static_cast<uint32_t>(lines.size()));
+    for(const RouteLine& line : lines) {
+      str_push(data, byte_order);
+      str_push(data, static_cast<uint32_t>(2)); // LineString
+      str_push(data, static_cast<uint32_t>(line.size()));
+      for(const osmium::NodeRef& node : line) {
+        str_push(data, node.location().lon_without_check());
+        str_push(data, node.location().lat_without_check());
+      }
+    }
+    result.wkb = osmium::geom::detail::convert_to_hex(data);
+  }
+  result.lines.swap(lines);
+}
+
+inline bool isRouteStopRole(const char* role) {
+  return !std::strncmp(role, "platform", 8) || !std::strncmp(role, "stop", 4);
+}
+
+inline void setRouteTags(const osmium::Relation& relation, RouteResult& result) {
+  const osmium::TagList& tags = relation.tags();
+  result.id = relation.id();
+  result.route = tags.get_value_by_key("route", "");
+  result.name = tags.get_value_by_key("name", "");
+  result.ref = tags.get_value_by_key("ref", "");
+}
+
+/**
+ * Stitches one route relation. The input buffer is self-contained: the
+ * relation followed by copies of the member ways which are available. The
+ * offsets are given for every way member of the relation in member order,
+ * missing ways have the offset missing_route_member.
+ */
+struct RouteAssemblyTask {
+  std::shared_ptr<osmium::memory::Buffer> input;
+  std::vector<size_t> members;
+  bool keep_lines;
+
+  RouteResult operator()() const {
+    RouteResult result;
+    const osmium::Relation& relation = input->get<osmium::Relation>(0);
+    setRouteTags(relation, result);
+    std::vector<RoutePiece> pieces;
+    size_t member_index = 0;
+    for(const osmium::RelationMember& member : relation.members()) {
+      ++result.members;
+      if(member.ref() == 0) {
+        ++result.ignored_members;
+        continue;
+      }
+      ++result.ways;
+      const size_t offset = members[member_index++];
+      if(offset == missing_route_member) {
+        ++result.missing_ways;
+        continue;
+      }
+      const osmium::WayNodeList& nodes = input->get<osmium::Way>(offset).nodes();
+      bool valid = nodes.size() >= 2;
+      for(const osmium::NodeRef& node : nodes) {
+        valid = valid && node.location().valid();
+      }
+      if(!valid) {
+        ++result.invalid_ways;
+        continue;
+      }
+      RoutePiece::direction_type direction = RoutePiece::any;
+      if(!std::strcmp(member.role(), "forward")) {
+        direction = RoutePiece::forward;
+      } else if(!std::strcmp(member.role(), "backward")) {
+        direction = RoutePiece::backward;
+      }
+      pieces.push_back({&*nodes.cbegin(), &*nodes.cbegin() + nodes.size(), direction});
+    }
+    stitchRoute(pieces, result);
+    if(!keep_lines) {
+      result.lines.clear();
+    }
+    return result;
+  }
+};
+
+/**
+ * Collects the member ways of all type=route relations and assembles their
+ * lines (see stitchRoute()) on the threads of the osmium pool, one task per
+ * relation. Members with a platform or stop role and node members are
+ * ignored. Routes with ways missing in the file are assembled at the end
+ * from the ways which are available.
+ *
+ * Relations with type=superroute are not collected, instead they are
+ * stitched in finish() from the lines of their child routes (which can be
+ * superroutes themselves).
+ *
+ * Usage: read_relations() on a first reader, the second pass handler
+ * together with a node location handler on a second reader, then finish()
+ * and results().
+ */
+class RouteCollector : public osmium::relations::Collector<RouteCollector, false, true, false> {
+
+  typedef osmium::relations::Collector<RouteCollector, false, true, false> collector_type;
+
+  struct Superroute {
+    RouteResult result;
+    std::vector<osmium::object_id_type> children;
+  };
+
+public:
+
+  static constexpr size_t max_pending = 64;
+
+  RouteCollector() : collector_type() {}
+
+  bool keep_relation(const osmium::Relation& relation) {
+    const char* type = relation.tags().get_value_by_key("type");
+    if(type == nullptr) {
+      return false;
+    }
+    if(!std::strcmp(type, "superroute")) {
+      Superroute superroute;
+      setRouteTags(relation, superroute.result);
+      superroute.result.superroute = true;
+      for(const osmium::RelationMember& member : relation.members()) {
+        ++superroute.result.members;
+        if(member.type() == osmium::item_type::relation) {
+          superroute.children.push_back(member.ref());
+          mChildren.insert(member.ref());
+        } else {
+          ++superroute.result.ignored_members;
+        }
+      }
+      mSuperroutes.push_back(std::move(superroute));
+      return false;
+    }
+    return !std::strcmp(type, "route");
+  }
+
+  bool keep_member(const osmium::relations::RelationMeta&, const osmium::RelationMember& member) const {
+    return member.type() == osmium::item_type::way && !isRouteStopRole(member.role());
+  }
+
+  void complete_relation(osmium::relations::RelationMeta& relation_meta) {
+    submit(this->get_relation(relation_meta));
+  }
+
+  void flush() {
+    collect(false);
+  }
+
+  // Assemble the incomplete routes and the superroutes and wait for all results
+  void finish() {
+    for(const auto& relation_meta : this->relations()) {
+      if(!relation_meta.has_all_members()) {
+        submit(this->get_relation(relation_meta));
+      }
+    }
+    collect(true);
+    assembleSuperroutes();
+  }
+
+  // The results ordered by relation id
+  std::vector<RouteResult>& results() {
+    return mResults;
+  }
+
+private:
+  std::deque<std::future<RouteResult> > mPending;
+  std::vector<RouteResult> mResults;
+  std::vector<Superroute> mSuperroutes;
+  std::unordered_set<osmium::object_id_type> mChildren;
+
+  // Copy the relation and the member ways found so far into a buffer and assemble it on the pool
+  void submit(const osmium::Relation& relation) {
+    std::shared_ptr<osmium::memory::Buffer> input(
+      new osmium::memory::Buffer(relation.byte_size() + 64 * 1024, osmium::memory::Buffer::auto_grow::yes));
+    input->add_item(relation);
+    input->commit();
+    std::vector<size_t> members;
+    for(const osmium::RelationMember& member : relation.members()) {
+      if(member.ref() == 0) {
+        continue;
+      }
+      const size_t offset = this->get_offset(member.type(), member.ref());
+      if(offset < this->members_buffer().committed() && this->get_member(offset).id() == member.ref() &&
+         this->get_member(offset).type() == osmium::item_type::way) {
+        members.push_back(input->committed());
+        input->add_item(this->get_member(offset));
+        input->commit();
+      } else {
+        members.push_back(missing_route_member);
+      }
+    }
+    RouteAssemblyTask task = {input, std::move(members), mChildren.count(relation.id()) > 0};
+    mPending.push_back(osmium::thread::Pool::instance().submit(task));
+    while(mPending.size() >= max_pending) {
+      mPending.front().wait();
+      collect(false);
+    }
+  }
+
+  void collect(bool wait) {
+    while(!mPending.empty() &&
+          (wait || mPending.front().wait_for(std::chrono::seconds(0)) == std::future_status::ready)) {
+      mResults.push_back(mPending.front().get());
+      mPending.pop_front();
+    }
+  }
+
+  void assembleSuperroutes() {
+    std::unordered_map<osmium::object_id_type, const std::vector<RouteLine>*> lines;
+    for(const RouteResult& result : mResults) {
+      if(!result.lines.empty()) {
+        lines[result.id] = &result.lines;
+      }
+    }
+    std::unordered_map<osmium::object_id_type, Superroute*> superroutes;
+    for(Superroute& superroute : mSuperroutes) {
+      superroutes[superroute.result.id] = &superroute;
+    }
+    std::unordered_set<osmium::object_id_type> visiting;
+    for(Superroute& superroute : mSuperroutes) {
+      assembleSuperroute(superroute, lines, superroutes, visiting);
+    }
+    for(Superroute& superroute : mSuperroutes) {
+      mResults.push_back(std::move(superroute.result));
+    }
+    mSuperroutes.clear();
+    for(RouteResult& result : mResults) {
+      result.lines.clear();
+      result.lines.shrink_to_fit();
+    }
+    std::sort(mResults.begin(), mResults.end(), [](const RouteResult& a, const RouteResult& b) {
+      return a.id < b.id;
+    });
+  }
+
+  // Child superroutes are assembled first, cycles are broken by treating the child as missing
+  void assembleSuperroute(Superroute& superroute,
+                          std::unordered_map<osmium::object_id_type, const std::vector<RouteLine>*>& lines,
+                          std::unordered_map<osmium::object_id_type, Superroute*>& superroutes,
+                          std::unordered_set<osmium::object_id_type>& visiting) {
+    RouteResult& result = superroute.result;
+    if(lines.count(result.id) || !visiting.insert(result.id).second) {
+      return;
+    }
+    std::vector<RoutePiece> pieces;
+    for(osmium::object_id_type child : superroute.children) {
+      ++result.ways;
+      auto nested = superroutes.find(child);
+      if(nested != superroutes.end()) {
+        assembleSuperroute(*nested->second, lines, superroutes, visiting);
+      }
+      auto child_lines = lines.find(child);
+      if(child_lines == lines.end() || child_lines->second->empty()) {
+        ++result.missing_ways;
+        continue;
+      }
+      for(const RouteLine& line : *child_lines->second) {
+        pieces.push_back({line.data(), line.data() + line.size(), RoutePiece::any});
+      }
+    }
+    stitchRoute(pieces, result);
+    lines[result.id] = &result.lines;
+  }
+};
+
+#endif // ROUTECOLLECTOR_HPP
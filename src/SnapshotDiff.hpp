@@ -0,0 +1,272 @@
+
+// Rosmium: R bindings for the Osmium library
+// Copyright (C) 2016 Lukas Huwiler
+//
+// This file is part of Rosmium.
+//
+// Rosmium is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Rosmium is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Rosmium.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SNAPSHOTDIFF_HPP
+#define SNAPSHOTDIFF_HPP
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <zlib.h>
+#include <osmium/io/file.hpp>
+#include <osmium/io/input_iterator.hpp>
+#include <osmium/io/reader.hpp>
+#include <osmium/io/writer.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/crc.hpp>
+#include <osmium/osm/entity_bits.hpp>
+#include <osmium/osm/object.hpp>
+
+// CRC32 of zlib in the interface osmium::CRC expects (the one of boost::crc)
+class ZlibCRC32 {
+public:
+
+  void process_byte(unsigned char byte) {
+    mCRC = crc32(mCRC, &byte, 1);
+  }
+
+  void process_bytes(const void* data, size_t size) {
+    mCRC = crc32(mCRC, static_cast<const Bytef*>(data), static_cast<uInt>(size));
+  }
+
+  uint32_t checksum() const {
+    return static_cast<uint32_t>(mCRC);
+  }
+
+private:
+  uLong mCRC = crc32(0L, Z_NULL, 0);
+};
+
+/**
+ * CRC32 of the content of an object: the tags and the location, the node
+ * references or the members. The metadata (version, timestamp, user,
+ * changeset) is left out, so a file without metadata can be compared with
+ * one which has it.
+ */
+inline uint32_t objectChecksum(const osmium::OSMObject& object) {
+  osmium::CRC<ZlibCRC32> crc;
+  crc.update(object.tags());
+  switch(object.type()) {
+    case osmium::item_type::node: crc.update(static_cast<const osmium::Node&>(object).location()); break;
+    case osmium::item_type::way: crc.update(static_cast<const osmium::Way&>(object).nodes()); break;
+    case osmium::item_type::relation: crc.update(static_cast<const osmium::Relation&>(object).members()); break;
+    default: break;
+  }
+  return crc().checksum();
+}
+
+enum class ChangeType {
+  created,
+  modified,
+  deleted
+};
+
+/**
+ * Compares two files sorted by type and id (e.g. two extracts of the same
+ * region) with a merge join, reading both files once and side by side. An
+ * object is modified if its version changed or, if one of the files has no
+ * versions (or compare_crc is set), if the CRC32 of its content changed.
+ *
+ * If a file contains several versions of an object, only the last one is
+ * compared, and an object whose last version is deleted counts as missing.
+ */
+class SnapshotDiff {
+public:
+
+  uint64_t unchanged = 0;
+  uint64_t created = 0;
+  uint64_t modified = 0;
+  uint64_t deleted = 0;
+
+  SnapshotDiff(const std::string& old_filename, const std::string& new_filename,
+               osmium::osm_entity_bits::type entities, bool compare_crc) :
+    mOld(old_filename, entities),
+    mNew(new_filename, entities),
+    mCompareCRC(compare_crc) {
+  }
+
+  /**
+   * Calls callback(change, old_object, new_object) for every change, with a
+   * nullptr for the missing object of a created or deleted one.
+   */
+  template <typename TCallback>
+  void run(TCallback callback) {
+    bool has_old = mOld.advance();
+    bool has_new = mNew.advance();
+    while(has_old || has_new) {
+      if(!has_new || (has_old && mOld.key() < mNew.key())) {
+        ++deleted;
+        callback(ChangeType::deleted, &mOld.object(), nullptr);
+        has_old = mOld.advance();
+      } else if(!has_old || mNew.key() < mOld.key()) {
+        ++created;
+        callback(ChangeType::created, nullptr, &mNew.object());
+        has_new = mNew.advance();
+      } else {
+        if(changed(mOld.object(), mNew.object())) {
+          ++modified;
+          callback(ChangeType::modified, &mOld.object(), &mNew.object());
+        } else {
+          ++unchanged;
+        }
+        has_old = mOld.advance();
+        has_new = mNew.advance();
+      }
+    }
+  }
+
+  void close() {
+    mOld.close();
+    mNew.close();
+  }
+
+private:
+  typedef osmium::io::InputIterator<osmium::io::Reader, osmium::OSMObject> object_iterator;
+  typedef std::tuple<osmium::item_type, osmium::unsigned_object_id_type, osmium::object_id_type> key_type;
+
+  // Last visible version of each object of a sorted file; the iterators keep the current buffer alive
+  class Cursor {
+  public:
+
+    Cursor(const std::string& filename, osmium::osm_entity_bits::type entities) :
+      mFilename(filename),
+      mReader(filename, entities),
+      mIt(mReader),
+      mEnd() {
+    }
+
+    bool advance() {
+      while(mIt != mEnd) {
+        mCurrent = mIt;
+        ++mIt;
+        while(mIt != mEnd && mIt->type() == mCurrent->type() && mIt->id() == mCurrent->id()) {
+          mCurrent = mIt;
+          ++mIt;
+        }
+        const key_type key = keyOf(*mCurrent);
+        if(mStarted && key < mLastKey) {
+          throw std::runtime_error(mFilename + " is not sorted by type and id");
+        }
+        mStarted = true;
+        mLastKey = key;
+        if(mCurrent->visible()) {
+          return true;
+        }
+      }
+      mCurrent = mEnd;
+      return false;
+    }
+
+    const osmium::OSMObject& object() const {
+      return *mCurrent;
+    }
+
+    const key_type& key() const {
+      return mLastKey;
+    }
+
+    void close() {
+      mReader.close();
+    }
+
+  private:
+    std::string mFilename;
+    osmium::io::Reader mReader;
+    object_iterator mIt;
+    object_iterator mEnd;
+    object_iterator mCurrent;
+    key_type mLastKey;
+    bool mStarted = false;
+  };
+
+  Cursor mOld;
+  Cursor mNew;
+  bool mCompareCRC;
+
+  // Same order as osmium's operator< on objects (by type, then absolute id)
+  static key_type keyOf(const osmium::OSMObject& object) {
+    return key_type(object.type(), object.positive_id(), object.id());
+  }
+
+  bool changed(const osmium::OSMObject& old_object, const osmium::OSMObject& new_object) const {
+    if(!mCompareCRC && old_object.version() != 0 && new_object.version() != 0) {
+      return old_object.version() != new_object.version();
+    }
+    return objectChecksum(old_object) != objectChecksum(new_object);
+  }
+};
+
+/**
+ * Writes the changes found by a SnapshotDiff as osmChange file. The osmium
+ * XML writer chooses the operation by the object: deleted objects are
+ * written as invisible copies of the old object and created objects without
+ * a version get version 1. Created objects with a higher version (e.g.
+ * objects which were moved into an extract) are written as modify.
+ */
+class ChangeFileWriter {
+public:
+
+  explicit ChangeFileWriter(const std::string& filename) :
+    mScratch(1024, osmium::memory::Buffer::auto_grow::yes) {
+    osmium::io::File file(filename);
+    if(!file.is_true("xml_change_format")) {
+      throw std::invalid_argument("The osmChange file needs the suffix .osc, .osc.gz or .osc.bz2: " + filename);
+    }
+    mWriter = std::make_shared<osmium::io::Writer>(file);
+  }
+
+  void operator()(ChangeType change, const osmium::OSMObject* old_object, const osmium::OSMObject* new_object) {
+    switch(change) {
+      case ChangeType::created:
+        if(new_object->version() == 0) {
+          copy(*new_object).set_version(1u);
+          (*mWriter)(mScratch.get<osmium::OSMObject>(0));
+        } else {
+          (*mWriter)(*new_object);
+        }
+        break;
+      case ChangeType::modified:
+        (*mWriter)(*new_object);
+        break;
+      case ChangeType::deleted:
+        copy(*old_object).set_visible(false);
+        (*mWriter)(mScratch.get<osmium::OSMObject>(0));
+        break;
+    }
+  }
+
+  void close() {
+    mWriter->close();
+  }
+
+private:
+  std::shared_ptr<osmium::io::Writer> mWriter;
+  osmium::memory::Buffer mScratch;
+
+  osmium::OSMObject& copy(const osmium::OSMObject& object) {
+    mScratch.clear();
+    mScratch.add_item(object);
+    mScratch.commit();
+    return mScratch.get<osmium::OSMObject>(0);
+  }
+};
+
+#endif // SNAPSHOTDIFF_HPP
@@ -0,0 +1,483 @@
+
+// Rosmium: R bindings for the Osmium library
+// Copyright (C) 2016 Lukas Huwiler
+//
+// This file is part of Rosmium.
+//
+// Rosmium is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Rosmium is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Rosmium.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SPATIALPARTITION_HPP
+#define SPATIALPARTITION_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <osmium/handler.hpp>
+#include <osmium/handler/node_locations_for_ways.hpp>
+#include <osmium/index/index.hpp>
+#include <osmium/io/header.hpp>
+#include <osmium/io/writer.hpp>
+#include <osmium/osm/box.hpp>
+#include <osmium/osm/entity_bits.hpp>
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/node.hpp>
+#include <osmium/osm/relation.hpp>
+#include <osmium/osm/way.hpp>
+
+#include "LocationIndex.hpp"
+
+// Uniform sample of at most capacity locations of a stream of unknown length (reservoir sampling)
+class LocationSample {
+public:
+
+  LocationSample(size_t capacity, uint64_t seed) :
+    mCapacity(capacity),
+    mRandom(seed) {
+  }
+
+  void add(const osmium::Location& location) {
+    ++mSeen;
+    if(mPoints.size() < mCapacity) {
+      mPoints.push_back(location);
+    } else {
+      std::uniform_int_distribution<uint64_t> position(0, mSeen - 1);
+      const uint64_t i = position(mRandom);
+      if(i < mCapacity) {
+        mPoints[static_cast<size_t>(i)] = location;
+      }
+    }
+  }
+
+  std::vector<osmium::Location>& points() {
+    return mPoints;
+  }
+
+  size_t usedMemory() const {
+    return mPoints.capacity() * sizeof(osmium::Location);
+  }
+
+private:
+  size_t mCapacity;
+  uint64_t mSeen = 0;
+  std::mt19937_64 mRandom;
+  std::vector<osmium::Location> mPoints;
+};
+
+/**
+ * Split of a bounding box into cells holding about the same number of
+ * points. A cell for k leaves is cut across its longer side at the
+ * quantile of its points which leaves floor(k/2) cells on the lower side,
+ * so the number of cells does not have to be a power of two.
+ */
+class KdPartition {
+public:
+
+  KdPartition() = default;
+
+  KdPartition(std::vector<osmium::Location>& points, const osmium::Box& box, unsigned cells) {
+    mBoxes.resize(cells);
+    build(points.begin(), points.end(), box, 0, cells);
+  }
+
+  // Cell of a location, -1 for an invalid location
+  int cell(const osmium::Location& location) const {
+    if(!location.valid()) {
+      return -1;
+    }
+    int split = mSplits.empty() ? ~0 : 0;
+    while(split >= 0) {
+      const Split& s = mSplits[static_cast<size_t>(split)];
+      const int32_t value = s.axis == 0 ? location.x() : location.y();
+      split = value < s.value ? s.lower : s.upper;
+    }
+    return ~split;
+  }
+
+  size_t cells() const {
+    return mBoxes.size();
+  }
+
+  const osmium::Box& box(unsigned cell) const {
+    return mBoxes[cell];
+  }
+
+private:
+  typedef std::vector<osmium::Location>::iterator iterator;
+
+  // Inner node of the tree, a negative child is the complement of a cell number
+  struct Split {
+    int axis;
+    int32_t value;
+    int lower;
+    int upper;
+  };
+
+  std::vector<Split> mSplits;
+  std::vector<osmium::Box> mBoxes;
+
+  int build(iterator begin, iterator end, const osmium::Box& box, unsigned first, unsigned count) {
+    if(count == 1) {
+      mBoxes[first] = box;
+      return ~static_cast<int>(first);
+    }
+    const unsigned lower_count = count / 2;
+    // Longer side in metres, so cells at high latitudes are not cut into slivers
+    const double latitude = (box.bottom_left().lat() + box.top_right().lat()) / 2 * M_PI / 180;
+    const double width = static_cast<double>(box.top_right().x() - box.bottom_left().x()) * std::cos(latitude);
+    const double height = static_cast<double>(box.top_right().y() - box.bottom_left().y());
+    const int axis = width >= height ? 0 : 1;
+    auto coordinate = [axis](const osmium::Location& location) {
+      return axis == 0 ? location.x() : location.y();
+    };
+
+    int32_t value;
+    iterator middle = begin + static_cast<std::ptrdiff_t>(static_cast<size_t>(end - begin) * lower_count / count);
+    if(begin == end) {
+      value = (coordinate(box.bottom_left()) + coordinate(box.top_right())) / 2;
+    } else {
+      std::nth_element(begin, middle, end, [&coordinate](const osmium::Location& a, const osmium::Location& b) {
+        return coordinate(a) < coordinate(b);
+      });
+      value = coordinate(*middle);
+      // Points on the split line belong to the upper cell
+      middle = std::partition(begin, middle, [&coordinate, value](const osmium::Location& location) {
+        return coordinate(location) < value;
+      });
+    }
+
+    osmium::Box lower_box = box;
+    osmium::Box upper_box = box;
+    if(axis == 0) {
+      lower_box.top_right().set_x(value);
+      upper_box.bottom_left().set_x(value);
+    } else {
+      lower_box.top_right().set_y(value);
+      upper_box.bottom_left().set_y(value);
+    }
+    const int split = static_cast<int>(mSplits.size());
+    mSplits.push_back(Split{axis, value, 0, 0});
+    const int lower = build(begin, middle, lower_box, first, lower_count);
+    const int upper = build(middle, end, upper_box, first + lower_count, count - lower_count);
+    mSplits[static_cast<size_t>(split)].lower = lower;
+    mSplits[static_cast<size_t>(split)].upper = upper;
+    return split;
+  }
+};
+
+struct PartitionCounts {
+  uint64_t nodes = 0;
+  uint64_t ways = 0;
+  uint64_t relations = 0;
+};
+
+/**
+ * Splits a file sorted by type and id into cells with about the same
+ * number of nodes in two passes.
+ *
+ * The first pass samples the node locations, stores them in the location
+ * index and builds the k-d split as soon as the first way arrives. Without
+ * duplication, every object is written to exactly one output: a node to
+ * the cell of its location, a way or relation to the cell most of its
+ * members are in. With duplication, ways and relations are written to all
+ * cells their members are in, and the first pass notes which nodes
+ * crossing ways need in other cells, so every way is complete in every
+ * output. Relations are not made complete. Relation members are only
+ * looked at if they come earlier in the file.
+ *
+ * Besides the location index, the memory used is the sample, the nodes of
+ * ways crossing a cell border (with duplication) and the cells of the ways
+ * and relations which are relation members.
+ */
+class SpatialPartitioner : public osmium::handler::Handler {
+public:
+
+  SpatialPartitioner(LocationIndex& index, unsigned cells, bool duplicate, size_t sample, uint64_t seed) :
+    mLocations(index),
+    mCells(cells),
+    mDuplicate(duplicate),
+    mSample(sample, seed),
+    mCounts(cells) {
+    if(cells == 0 || cells > max_cells) {
+      throw std::invalid_argument("The number of outputs has to be between 1 and " + std::to_string(max_cells));
+    }
+    mLocations.ignore_errors();
+  }
+
+  /**
+   * Ends the first pass and opens the outputs (one per cell, with the box of
+   * the cell in the header) for the second one.
+   */
+  void startWriting(const std::vector<std::string>& filenames, osmium::osm_entity_bits::type entities, bool overwrite) {
+    buildPartition();
+    std::sort(mExtraNodes.begin(), mExtraNodes.end());
+    mExtraNodes.erase(std::unique(mExtraNodes.begin(), mExtraNodes.end()), mExtraNodes.end());
+    std::sort(mMemberWays.begin(), mMemberWays.end());
+    mMemberWays.erase(std::unique(mMemberWays.begin(), mMemberWays.end()), mMemberWays.end());
+    std::sort(mMemberRelations.begin(), mMemberRelations.end());
+    mMemberRelations.erase(std::unique(mMemberRelations.begin(), mMemberRelations.end()), mMemberRelations.end());
+
+    mEntities = entities;
+    for(unsigned cell = 0; cell < mCells; ++cell) {
+      osmium::io::Header header;
+      header.add_box(mPartition.box(cell));
+      mWriters.emplace_back(new osmium::io::Writer(filenames[cell], header,
+                            overwrite ? osmium::io::overwrite::allow : osmium::io::overwrite::no));
+      mWriters.back()->set_buffer_size(writer_buffer_size);
+    }
+    mWriting = true;
+  }
+
+  void close() {
+    for(auto& writer : mWriters) {
+      writer->close();
+    }
+  }
+
+  void node(const osmium::Node& node) {
+    if(!mWriting) {
+      if(mPartitioned) {
+        throw std::runtime_error("Partitioning needs a file sorted by type and id (found a node after a way)");
+      }
+      mLocations.node(node);
+      if(node.location().valid()) {
+        mSample.add(node.location());
+        mBox.extend(node.location());
+      }
+      return;
+    }
+    if(!(mEntities & osmium::osm_entity_bits::node)) {
+      return;
+    }
+    const int cell = std::max(mPartition.cell(node.location()), 0);
+    write(node, cell, mCounts[cell].nodes);
+    auto extra = std::equal_range(mExtraNodes.begin(), mExtraNodes.end(), std::make_pair(node.id(), uint16_t(0)),
+                                  [](const cell_entry& a, const cell_entry& b) { return a.first < b.first; });
+    for(auto it = extra.first; it != extra.second; ++it) {
+      // A node without a location is noted for the first cell by crossing ways
+      if(it->second != cell) {
+        write(node, it->second, mCounts[it->second].nodes);
+      }
+    }
+  }
+
+  void way(osmium::Way& way) {
+    if(!mPartitioned) {
+      buildPartition();
+    }
+    mLocations.way(way);
+    mWayCells.clear();
+    for(const osmium::NodeRef& node_ref : way.nodes()) {
+      addCell(mWayCells, mPartition.cell(node_ref.location()));
+    }
+    const std::vector<unsigned>& cells = selectCells(mWayCells);
+    if(!mWriting) {
+      if(cells.size() > 1) {
+        for(const osmium::NodeRef& node_ref : way.nodes()) {
+          const int own = mPartition.cell(node_ref.location());
+          for(unsigned cell : cells) {
+            if(static_cast<int>(cell) != own) {
+              mExtraNodes.emplace_back(node_ref.ref(), static_cast<uint16_t>(cell));
+            }
+          }
+        }
+      }
+      return;
+    }
+    if(std::binary_search(mMemberWays.begin(), mMemberWays.end(), way.id())) {
+      for(unsigned cell : cells) {
+        mMemberWayCells.emplace_back(way.id(), static_cast<uint16_t>(cell));
+      }
+    }
+    if(mEntities & osmium::osm_entity_bits::way) {
+      for(unsigned cell : cells) {
+        write(way, cell, mCounts[cell].ways);
+      }
+    }
+  }
+
+  void relation(const osmium::Relation& relation) {
+    if(!mWriting) {
+      for(const osmium::RelationMember& member : relation.members()) {
+        if(member.type() == osmium::item_type::way) {
+          mMemberWays.push_back(member.ref());
+        } else if(member.type() == osmium::item_type::relation) {
+          mMemberRelations.push_back(member.ref());
+        }
+      }
+      return;
+    }
+    mWayCells.clear();
+    for(const osmium::RelationMember& member : relation.members()) {
+      switch(member.type()) {
+        case osmium::item_type::node:
+          addCell(mWayCells, mPartition.cell(nodeLocation(member.ref())));
+          break;
+        case osmium::item_type::way:
+          addCells(mWayCells, mMemberWayCells, member.ref());
+          break;
+        case osmium::item_type::relation:
+          addCells(mWayCells, mMemberRelationCells, member.ref());
+          break;
+        default:
+          break;
+      }
+    }
+    const std::vector<unsigned>& cells = selectCells(mWayCells);
+    if(std::binary_search(mMemberRelations.begin(), mMemberRelations.end(), relation.id())) {
+      for(unsigned cell : cells) {
+        mMemberRelationCells.emplace_back(relation.id(), static_cast<uint16_t>(cell));
+      }
+    }
+    if(mEntities & osmium::osm_entity_bits::relation) {
+      for(unsigned cell : cells) {
+        write(relation, cell, mCounts[cell].relations);
+      }
+    }
+  }
+
+  const KdPartition& partition() const {
+    return mPartition;
+  }
+
+  const std::vector<PartitionCounts>& counts() const {
+    return mCounts;
+  }
+
+  // Sampled points per cell (the balance the split aimed at)
+  const std::vector<uint64_t>& sampleCounts() const {
+    return mSampleCounts;
+  }
+
+  size_t usedMemory() const {
+    return mSample.usedMemory() +
+           (mExtraNodes.capacity() + mMemberWayCells.capacity() + mMemberRelationCells.capacity()) * sizeof(cell_entry) +
+           (mMemberWays.capacity() + mMemberRelations.capacity()) * sizeof(osmium::object_id_type);
+  }
+
+private:
+  typedef std::pair<osmium::object_id_type, uint16_t> cell_entry;
+  // (cell, number of members in it)
+  typedef std::vector<std::pair<unsigned, size_t>> cell_tally;
+
+  static const unsigned max_cells = 65535;
+  static const size_t writer_buffer_size = 1024 * 1024;
+
+  osmium::handler::NodeLocationsForWays<index_type> mLocations;
+  unsigned mCells;
+  bool mDuplicate;
+  LocationSample mSample;
+  std::vector<uint64_t> mSampleCounts;
+  osmium::Box mBox;
+  KdPartition mPartition;
+  bool mPartitioned = false;
+  bool mWriting = false;
+  osmium::osm_entity_bits::type mEntities = osmium::osm_entity_bits::nwr;
+  std::vector<std::unique_ptr<osmium::io::Writer>> mWriters;
+  std::vector<PartitionCounts> mCounts;
+
+  // (node, cell) for nodes needed in another cell than their own by a crossing way
+  std::vector<cell_entry> mExtraNodes;
+  // Ways and relations which are members of a relation, and their cells (in file order, so sorted)
+  std::vector<osmium::object_id_type> mMemberWays;
+  std::vector<osmium::object_id_type> mMemberRelations;
+  std::vector<cell_entry> mMemberWayCells;
+  std::vector<cell_entry> mMemberRelationCells;
+
+  cell_tally mWayCells;
+  std::vector<unsigned> mSelected;
+
+  void buildPartition() {
+    if(mPartitioned) {
+      return;
+    }
+    std::vector<osmium::Location>& points = mSample.points();
+    mPartition = KdPartition(points, mBox.valid() ? mBox : osmium::Box(-180.0, -90.0, 180.0, 90.0), mCells);
+    mSampleCounts.assign(mCells, 0);
+    for(const osmium::Location& location : points) {
+      ++mSampleCounts[static_cast<size_t>(mPartition.cell(location))];
+    }
+    std::vector<osmium::Location>().swap(points);
+    mPartitioned = true;
+  }
+
+  osmium::Location nodeLocation(osmium::object_id_type id) const {
+    try {
+      return mLocations.get_node_location(id);
+    } catch(osmium::not_found&) {
+      return osmium::Location();
+    }
+  }
+
+  static void addCell(cell_tally& tally, int cell) {
+    if(cell < 0) {
+      return;
+    }
+    for(auto& entry : tally) {
+      if(entry.first == static_cast<unsigned>(cell)) {
+        ++entry.second;
+        return;
+      }
+    }
+    tally.emplace_back(static_cast<unsigned>(cell), 1);
+  }
+
+  static void addCells(cell_tally& tally, const std::vector<cell_entry>& cells, osmium::object_id_type id) {
+    auto range = std::equal_range(cells.begin(), cells.end(), std::make_pair(id, uint16_t(0)),
+                                  [](const cell_entry& a, const cell_entry& b) { return a.first < b.first; });
+    for(auto it = range.first; it != range.second; ++it) {
+      addCell(tally, it->second);
+    }
+  }
+
+  // All cells with duplication, else the one with most members (the lowest on a tie)
+  const std::vector<unsigned>& selectCells(const cell_tally& tally) {
+    mSelected.clear();
+    if(tally.empty()) {
+      // No member with a location, e.g. a way cut off by an extract or a
+      // relation of relations later in the file: the first cell
+      mSelected.push_back(0);
+      return mSelected;
+    }
+    if(mDuplicate) {
+      for(const auto& entry : tally) {
+        mSelected.push_back(entry.first);
+      }
+      std::sort(mSelected.begin(), mSelected.end());
+      return mSelected;
+    }
+    auto best = tally.begin();
+    for(auto it = tally.begin(); it != tally.end(); ++it) {
+      if(it->second > best->second || (it->second == best->second && it->first < best->first)) {
+        best = it;
+      }
+    }
+    mSelected.push_back(best->first);
+    return mSelected;
+  }
+
+  template <typename TObject>
+  void write(const TObject& object, unsigned cell, uint64_t& count) {
+    (*mWriters[cell])(object);
+    ++count;
+  }
+};
+
+#endif // SPATIALPARTITION_HPP
@@ -0,0 +1,590 @@
+
+// Rosmium: R bindings for the Osmium library
+// Copyright (C) 2016 Lukas Huwiler
+//
+// This file is part of Rosmium.
+//
+// Rosmium is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Rosmium is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Rosmium.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SYNTHETICDATA_HPP
+#define SYNTHETICDATA_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include <osmium/builder/osm_object_builder.hpp>
+#include <osmium/io/header.hpp>
+#include <osmium/io/writer.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/box.hpp>
+#include <osmium/osm/item_type.hpp>
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/timestamp.hpp>
+#include <osmium/osm/types.hpp>
+
+/**
+ * Small deterministic random number generator (splitmix64). Unlike the
+ * standard library distributions, the sequence only depends on the seed
+ * and not on the platform.
+ */
+class SyntheticRandom {
+public:
+  explicit SyntheticRandom(uint64_t seed) : mState(seed) {}
+
+  SyntheticRandom(uint64_t seed, uint64_t stream, uint64_t index) :
+    mState(seed ^ (stream * 0x9E3779B97F4A7C15ULL) ^ (index * 0xC2B2AE3D27D4EB4FULL)) {
+    next();
+  }
+
+  uint64_t next() {
+    uint64_t z = (mState += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+  // uniform in [0, 1)
+  double uniform() {
+    return (next() >> 11) * (1.0 / 9007199254740992.0);
+  }
+
+  // uniform in [0, n)
+  uint64_t below(uint64_t n) {
+    return n == 0 ? 0 : next() % n;
+  }
+
+  bool chance(double p) {
+    return uniform() < p;
+  }
+
+  // approximately normal distributed (Irwin-Hall with four summands)
+  double normal(double mean, double sd) {
+    double sum = uniform() + uniform() + uniform() + uniform();
+    return mean + (sum - 2.0) * sd * 1.7320508075688772;
+  }
+
+  // geometric distribution with the given mean (>= 0)
+  uint64_t geometric(double mean) {
+    const double p = 1.0 / (mean + 1.0);
+    uint64_t n = 0;
+    while(!chance(p) && n < 100000) {
+      ++n;
+    }
+    return n;
+  }
+
+private:
+  uint64_t mState;
+};
+
+struct WeightedTag {
+  const char* key;
+  const char* value;
+  unsigned weight;
+};
+
+template <size_t N>
+inline const WeightedTag& pickTag(SyntheticRandom& rnd, const WeightedTag (&table)[N]) {
+  unsigned total = 0;
+  for(const WeightedTag& t : table) {
+    total += t.weight;
+  }
+  unsigned r = static_cast<unsigned>(rnd.below(total));
+  for(const WeightedTag& t : table) {
+    if(r < t.weight) {
+      return t;
+    }
+    r -= t.weight;
+  }
+  return table[N - 1];
+}
+
+struct SyntheticCounts {
+  uint64_t nodes = 0;
+  uint64_t ways = 0;
+  uint64_t relations = 0;
+};
+
+/**
+ * Generates a planet-like OSM file. The data is generated in three passes
+ * (nodes, ways, relations) so the output is sorted and only a few buffers
+ * are kept in memory, independent of the size of the file. Every way and
+ * relation is derived from its own random stream, which allows the node
+ * pass and the way pass to agree on the node ids of every way without
+ * storing them.
+ *
+ * Ways are placed around settlements, form chains of connected road
+ * segments and carry tags following a distribution close to the one of
+ * the planet. Relations are multipolygons, routes, superroutes (nested
+ * routes), administrative boundaries (nested subareas) and turn
+ * restrictions.
+ */
+class SyntheticGenerator {
+public:
+
+  SyntheticGenerator(uint64_t nodes, uint64_t seed, const osmium::Box& bbox) :
+    mSeed(seed), mBox(bbox) {
+    mNumWays = std::max<uint64_t>(1, nodes / nodes_per_way);
+    mNumRelations = std::max<uint64_t>(1, mNumWays / ways_per_relation);
+  }
+
+  SyntheticCounts write(const std::string& filename) {
+    osmium::io::Header header;
+    header.set("generator", "Rosmium synthetic data generator");
+    header.add_box(mBox);
+    osmium::io::Writer writer(filename, header, osmium::io::overwrite::allow);
+    SyntheticCounts counts;
+    writeNodes(writer, counts);
+    writeWays(writer, counts);
+    writeRelations(writer, counts);
+    writer.close();
+    return counts;
+  }
+
+private:
+
+  static constexpr uint64_t nodes_per_way = 9;
+  static constexpr uint64_t ways_per_relation = 80;
+  static constexpr uint64_t ways_per_settlement = 4000;
+  static constexpr size_t buffer_size = 1024 * 1024;
+
+  enum stream : uint64_t {
+    stream_way = 1,
+    stream_node = 2,
+    stream_relation = 3,
+    stream_settlement = 4
+  };
+
+  enum class relation_kind {
+    multipolygon,
+    route,
+    superroute,
+    boundary,
+    restriction
+  };
+
+  // Everything about a way that only depends on its own random stream
+  struct WayPlan {
+    bool closed;
+    bool chained;
+    uint64_t num_nodes;
+    uint64_t num_pois;
+  };
+
+  uint64_t mSeed;
+  osmium::Box mBox;
+  uint64_t mNumWays;
+  uint64_t mNumRelations;
+
+  // state shared by the node and way pass (chaining of consecutive ways)
+  osmium::object_id_type mNextNodeId = 1;
+  osmium::object_id_type mPrevLastNode = 0;
+  osmium::Location mPrevLastLocation;
+  bool mPrevOpen = false;
+
+  WayPlan planWay(uint64_t way) const {
+    SyntheticRandom rnd(mSeed, stream_way, way);
+    WayPlan plan;
+    plan.closed = rnd.chance(0.42);
+    plan.chained = !plan.closed && rnd.chance(0.6);
+    if(plan.closed) {
+      plan.num_nodes = 4 + rnd.geometric(1.5);
+    } else if(rnd.chance(0.01)) {
+      plan.num_nodes = 100 + rnd.below(900);
+    } else {
+      plan.num_nodes = 2 + rnd.geometric(6.0);
+    }
+    plan.num_pois = rnd.chance(0.25) ? 1 + rnd.geometric(0.5) : 0;
+    return plan;
+  }
+
+  relation_kind planRelation(uint64_t rel) const {
+    SyntheticRandom rnd(mSeed, stream_relation, rel);
+    const uint64_t r = rnd.below(100);
+    if(r < 45) return relation_kind::multipolygon;
+    if(r < 75) return relation_kind::route;
+    if(r < 80) return relation_kind::superroute;
+    if(r < 90) return relation_kind::boundary;
+    return relation_kind::restriction;
+  }
+
+  osmium::Location settlementCenter(uint64_t way) const {
+    SyntheticRandom rnd(mSeed, stream_settlement, way / ways_per_settlement);
+    const double lon = mBox.bottom_left().lon() + rnd.uniform() * (mBox.top_right().lon() - mBox.bottom_left().lon());
+    const double lat = mBox.bottom_left().lat() + rnd.uniform() * (mBox.top_right().lat() - mBox.bottom_left().lat());
+    return osmium::Location(lon, lat);
+  }
+
+  osmium::Location clamp(double lon, double lat) const {
+    lon = std::min(std::max(lon, mBox.bottom_left().lon()), mBox.top_right().lon());
+    lat = std::min(std::max(lat, mBox.bottom_left().lat()), mBox.top_right().lat());
+    return osmium::Location(lon, lat);
+  }
+
+  /**
+   * Computes the node ids and locations of a way. New nodes get ids from
+   * mNextNodeId. The first node of a chained way is the last node of the
+   * previous way.
+   */
+  void layoutWay(uint64_t way, const WayPlan& plan,
+                 std::vector<std::pair<osmium::object_id_type, osmium::Location>>& nodes) {
+    SyntheticRandom rnd(mSeed, stream_node, way);
+    nodes.clear();
+    const bool chained = plan.chained && mPrevOpen;
+    osmium::Location start;
+    if(chained) {
+      start = mPrevLastLocation;
+      nodes.emplace_back(mPrevLastNode, start);
+    } else {
+      const osmium::Location center = settlementCenter(way);
+      start = clamp(rnd.normal(center.lon(), 0.03), rnd.normal(center.lat(), 0.02));
+      nodes.emplace_back(mNextNodeId++, start);
+    }
+    if(plan.closed) {
+      // small irregular polygon around the start location
+      const double size = 0.0001 + rnd.uniform() * 0.0004;
+      const uint64_t corners = plan.num_nodes - 1;
+      for(uint64_t i = 1; i < corners; ++i) {
+        const double t = static_cast<double>(i) / corners;
+        const double dx = (t < 0.5 ? t * 2 : 2 - t * 2) * size;
+        const double dy = (t < 0.25 || t > 0.75 ? 0 : size) + rnd.uniform() * size * 0.2;
+        nodes.emplace_back(mNextNodeId++, clamp(start.lon() + dx, start.lat() + dy));
+      }
+      nodes.push_back(nodes.front());
+    } else {
+      double dx = rnd.normal(0, 1);
+      double dy = rnd.normal(0, 1);
+      double lon = start.lon();
+      double lat = start.lat();
+      for(uint64_t i = 1; i < plan.num_nodes; ++i) {
+        dx += rnd.normal(0, 0.3);
+        dy += rnd.normal(0, 0.3);
+        const double len = std::sqrt(dx * dx + dy * dy) + 1e-9;
+        const double step = 0.0002 + rnd.uniform() * 0.0008;
+        lon += dx / len * step;
+        lat += dy / len * step * 0.7;
+        nodes.emplace_back(mNextNodeId++, clamp(lon, lat));
+      }
+    }
+    mPrevOpen = !plan.closed;
+    mPrevLastNode = nodes.back().first;
+    mPrevLastLocation = nodes.back().second;
+  }
+
+  void resetLayout() {
+    mNextNodeId = 1;
+    mPrevLastNode = 0;
+    mPrevLastLocation = osmium::Location();
+    mPrevOpen = false;
+  }
+
+  template <typename TBuilder>
+  void setAttributes(TBuilder& builder, osmium::object_id_type id, SyntheticRandom& rnd) {
+    const osmium::user_id_type uid = static_cast<osmium::user_id_type>(1 + rnd.below(50000));
+    builder.object().set_id(id);
+    builder.object().set_version(static_cast<osmium::object_version_type>(1 + rnd.geometric(1.5)));
+    builder.object().set_changeset(static_cast<osmium::changeset_id_type>(1 + rnd.below(40000000)));
+    builder.object().set_timestamp(osmium::Timestamp(static_cast<uint32_t>(1199145600 + rnd.below(283996800))));
+    builder.object().set_uid(uid);
+    builder.add_user("user_" + std::to_string(uid));
+  }
+
+  static void possiblyFlush(osmium::io::Writer& writer, osmium::memory::Buffer& buffer) {
+    if(buffer.committed() > buffer_size - buffer_size / 10) {
+      writer(std::move(buffer));
+      buffer = osmium::memory::Buffer(buffer_size, osmium::memory::Buffer::auto_grow::yes);
+    }
+  }
+
+  void addNode(osmium::memory::Buffer& buffer, osmium::object_id_type id, const osmium::Location& location, bool poi) {
+    SyntheticRandom rnd(mSeed, stream_node, static_cast<uint64_t>(id) << 8);
+    osmium::builder::NodeBuilder builder(buffer);
+    setAttributes(builder, id, rnd);
+    builder.object().set_location(location);
+    static const WeightedTag poi_tags[] = {
+      {"amenity", "bench", 12}, {"amenity", "restaurant", 8}, {"amenity", "parking", 6}, {"amenity", "waste_basket", 6},
+      {"shop", "convenience", 5}, {"shop", "bakery", 3}, {"tourism", "information", 5}, {"natural", "tree", 14},
+      {"power", "tower", 10}, {"entrance", "yes", 6}, {"place", "locality", 2}, {"highway", "bus_stop", 6}
+    };
+    static const WeightedTag vertex_tags[] = {
+      {"highway", "crossing", 40}, {"highway", "traffic_signals", 20}, {"barrier", "gate", 15},
+      {"highway", "turning_circle", 10}, {"railway", "level_crossing", 5}, {"highway", "stop", 10}
+    };
+    if(poi) {
+      osmium::builder::TagListBuilder tags(buffer, &builder);
+      const WeightedTag& tag = pickTag(rnd, poi_tags);
+      tags.add_tag(tag.key, tag.value);
+      if(rnd.chance(0.5)) {
+        tags.add_tag("name", "Place " + std::to_string(id));
+      }
+    } else if(rnd.chance(0.015)) {
+      osmium::builder::TagListBuilder tags(buffer, &builder);
+      const WeightedTag& tag = pickTag(rnd, vertex_tags);
+      tags.add_tag(tag.key, tag.value);
+    }
+    buffer.commit();
+  }
+
+  void addWayTags(osmium::builder::WayBuilder& builder, osmium::memory::Buffer& buffer, osmium::object_id_type id,
+                  const WayPlan& plan, SyntheticRandom& rnd) {
+    static const WeightedTag building_tags[] = {
+      {"building", "yes", 60}, {"building", "house", 20}, {"building", "residential", 8},
+      {"building", "garage", 5}, {"building", "apartments", 4}, {"building", "industrial", 3}
+    };
+    static const WeightedTag area_tags[] = {
+      {"landuse", "residential", 20}, {"landuse", "farmland", 15}, {"landuse", "forest", 12}, {"landuse", "meadow", 10},
+      {"landuse", "grass", 8}, {"natural", "wood", 10}, {"natural", "water", 8}, {"leisure", "park", 6},
+      {"leisure", "pitch", 6}, {"amenity", "parking", 5}
+    };
+    static const WeightedTag line_tags[] = {
+      {"highway", "residential", 26}, {"highway", "service", 17}, {"highway", "track", 9}, {"highway", "footway", 8},
+      {"highway", "unclassified", 5}, {"highway", "path", 4}, {"highway", "tertiary", 3}, {"highway", "secondary", 2},
+      {"highway", "primary", 2}, {"highway", "motorway", 1}, {"waterway", "stream", 5}, {"railway", "rail", 2},
+      {"barrier", "fence", 5}, {"power", "line", 2}, {"", "", 9}
+    };
+    static const WeightedTag surface_tags[] = {
+      {"surface", "asphalt", 50}, {"surface", "gravel", 20}, {"surface", "unpaved", 15}, {"surface", "paved", 15}
+    };
+    osmium::builder::TagListBuilder tags(buffer, &builder);
+    if(plan.closed) {
+      if(rnd.chance(0.7)) {
+        const WeightedTag& tag = pickTag(rnd, building_tags);
+        tags.add_tag(tag.key, tag.value);
+        if(rnd.chance(0.4)) {
+          tags.add_tag("addr:street", "Street " + std::to_string(rnd.below(5000)));
+          tags.add_tag("addr:housenumber", std::to_string(1 + rnd.below(200)));
+        }
+      } else {
+        const WeightedTag& tag = pickTag(rnd, area_tags);
+        tags.add_tag(tag.key, tag.value);
+      }
+    } else {
+      const WeightedTag& tag = pickTag(rnd, line_tags);
+      if(tag.key[0] == '\0') {
+        return; // untagged way (only used as relation member)
+      }
+      tags.add_tag(tag.key, tag.value);
+      if(!std::strcmp(tag.key, "highway")) {
+        if(rnd.chance(0.5)) {
+          tags.add_tag("name", "Street " + std::to_string(id % 5000));
+        }
+        if(rnd.chance(0.2)) {
+          const WeightedTag& surface = pickTag(rnd, surface_tags);
+          tags.add_tag(surface.key, surface.value);
+        }
+        if(rnd.chance(0.15)) {
+          tags.add_tag("maxspeed", std::to_string(30 + 10 * rnd.below(10)));
+        }
+        if(rnd.chance(0.1)) {
+          tags.add_tag("oneway", "yes");
+        }
+      }
+    }
+  }
+
+  void writeNodes(osmium::io::Writer& writer, SyntheticCounts& counts) {
+    osmium::memory::Buffer buffer(buffer_size, osmium::memory::Buffer::auto_grow::yes);
+    std::vector<std::pair<osmium::object_id_type, osmium::Location>> nodes;
+    resetLayout();
+    for(uint64_t way = 0; way < mNumWays; ++way) {
+      const WayPlan plan = planWay(way);
+      const osmium::object_id_type first_new = mNextNodeId;
+      layoutWay(way, plan, nodes);
+      // the last node of a closed way is the same as the first one
+      const size_t num_nodes = plan.closed ? nodes.size() - 1 : nodes.size();
+      for(size_t i = 0; i < num_nodes; ++i) {
+        if(nodes[i].first >= first_new) {
+          addNode(buffer, nodes[i].first, nodes[i].second, false);
+          ++counts.nodes;
+        }
+      }
+      for(uint64_t i = 0; i < plan.num_pois; ++i) {
+        const osmium::Location& near = nodes[i % nodes.size()].second;
+        addNode(buffer, mNextNodeId++, clamp(near.lon() + 0.00005, near.lat() + 0.00005), true);
+        ++counts.nodes;
+      }
+      possiblyFlush(writer, buffer);
+    }
+    writer(std::move(buffer));
+  }
+
+  void writeWays(osmium::io::Writer& writer, SyntheticCounts& counts) {
+    osmium::memory::Buffer buffer(buffer_size, osmium::memory::Buffer::auto_grow::yes);
+    std::vector<std::pair<osmium::object_id_type, osmium::Location>> nodes;
+    resetLayout();
+    for(uint64_t way = 0; way < mNumWays; ++way) {
+      const WayPlan plan = planWay(way);
+      layoutWay(way, plan, nodes);
+      mNextNodeId += plan.num_pois;
+      const osmium::object_id_type id = static_cast<osmium::object_id_type>(way + 1);
+      SyntheticRandom rnd(mSeed, stream_way, way << 8);
+      {
+        osmium::builder::WayBuilder builder(buffer);
+        setAttributes(builder, id, rnd);
+        addWayTags(builder, buffer, id, plan, rnd);
+        osmium::builder::WayNodeListBuilder refs(buffer, &builder);
+        for(const auto& node : nodes) {
+          refs.add_node_ref(node.first);
+        }
+      }
+      buffer.commit();
+      ++counts.ways;
+      possiblyFlush(writer, buffer);
+    }
+    writer(std::move(buffer));
+  }
+
+  // find the next way (starting at way index from) which is closed or open
+  uint64_t findWay(uint64_t from, bool closed) const {
+    for(uint64_t i = 0; i < 64; ++i) {
+      const uint64_t way = (from + i) % mNumWays;
+      if(planWay(way).closed == closed) {
+        return way;
+      }
+    }
+    return from % mNumWays;
+  }
+
+  void addRelationMembers(osmium::builder::RelationBuilder& builder, osmium::memory::Buffer& buffer,
+                          uint64_t rel, relation_kind kind, SyntheticRandom& rnd) {
+    osmium::builder::RelationMemberListBuilder members(buffer, &builder);
+    const uint64_t start = rnd.below(mNumWays);
+    switch(kind) {
+    case relation_kind::multipolygon:
+      {
+        const uint64_t outer = findWay(start, true);
+        members.add_member(osmium::item_type::way, outer + 1, "outer");
+        const uint64_t inner = rnd.below(3);
+        uint64_t way = outer;
+        for(uint64_t i = 0; i < inner; ++i) {
+          way = findWay(way + 1, true);
+          members.add_member(osmium::item_type::way, way + 1, "inner");
+        }
+        break;
+      }
+    case relation_kind::route:
+      {
+        const uint64_t length = 3 + rnd.geometric(12.0);
+        for(uint64_t i = 0; i < length; ++i) {
+          const uint64_t way = (start + i) % mNumWays;
+          if(planWay(way).closed) {
+            continue;
+          }
+          const uint64_t r = rnd.below(10);
+          members.add_member(osmium::item_type::way, way + 1, r == 0 ? "forward" : (r == 1 ? "backward" : ""));
+        }
+        break;
+      }
+    case relation_kind::superroute:
+      {
+        // nested routes: reference earlier route relations
+        uint64_t added = 0;
+        for(uint64_t other = rel; other > 0 && added < 5; --other) {
+          if(planRelation(other - 1) == relation_kind::route && rnd.chance(0.5)) {
+            members.add_member(osmium::item_type::relation, other, "");
+            ++added;
+          }
+        }
+        break;
+      }
+    case relation_kind::boundary:
+      {
+        members.add_member(osmium::item_type::way, findWay(start, true) + 1, "outer");
+        members.add_member(osmium::item_type::node, 1 + rnd.below(mNextNodeId - 1), "admin_centre");
+        uint64_t added = 0;
+        for(uint64_t other = rel; other > 0 && added < 3; --other) {
+          if(planRelation(other - 1) == relation_kind::boundary && rnd.chance(0.3)) {
+            members.add_member(osmium::item_type::relation, other, "subarea");
+            ++added;
+          }
+        }
+        break;
+      }
+    case relation_kind::restriction:
+      {
+        const uint64_t from = findWay(start, false);
+        const uint64_t to = findWay(from + 1, false);
+        members.add_member(osmium::item_type::way, from + 1, "from");
+        members.add_member(osmium::item_type::node, 1 + rnd.below(mNextNodeId - 1), "via");
+        members.add_member(osmium::item_type::way, to + 1, "to");
+        break;
+      }
+    }
+  }
+
+  void writeRelations(osmium::io::Writer& writer, SyntheticCounts& counts) {
+    static const WeightedTag route_tags[] = {
+      {"route", "bus", 35}, {"route", "hiking", 25}, {"route", "bicycle", 20}, {"route", "road", 12},
+      {"route", "ferry", 3}, {"route", "train", 5}
+    };
+    static const WeightedTag multipolygon_tags[] = {
+      {"building", "yes", 30}, {"landuse", "forest", 20}, {"natural", "water", 20}, {"landuse", "residential", 15},
+      {"leisure", "park", 15}
+    };
+    osmium::memory::Buffer buffer(buffer_size, osmium::memory::Buffer::auto_grow::yes);
+    for(uint64_t rel = 0; rel < mNumRelations; ++rel) {
+      const relation_kind kind = planRelation(rel);
+      SyntheticRandom rnd(mSeed, stream_relation, rel << 8);
+      {
+        osmium::builder::RelationBuilder builder(buffer);
+        setAttributes(builder, static_cast<osmium::object_id_type>(rel + 1), rnd);
+        {
+          osmium::builder::TagListBuilder tags(buffer, &builder);
+          switch(kind) {
+          case relation_kind::multipolygon:
+            {
+              tags.add_tag("type", "multipolygon");
+              const WeightedTag& tag = pickTag(rnd, multipolygon_tags);
+              tags.add_tag(tag.key, tag.value);
+              break;
+            }
+          case relation_kind::route:
+            {
+              tags.add_tag("type", "route");
+              const WeightedTag& tag = pickTag(rnd, route_tags);
+              tags.add_tag(tag.key, tag.value);
+              tags.add_tag("ref", std::to_string(1 + rnd.below(300)));
+              break;
+            }
+          case relation_kind::superroute:
+            tags.add_tag("type", "superroute");
+            tags.add_tag("name", "Superroute " + std::to_string(rel + 1));
+            break;
+          case relation_kind::boundary:
+            tags.add_tag("type", "boundary");
+            tags.add_tag("boundary", "administrative");
+            tags.add_tag("admin_level", std::to_string(4 + rnd.below(7)));
+            tags.add_tag("name", "Municipality " + std::to_string(rel + 1));
+            break;
+          case relation_kind::restriction:
+            tags.add_tag("type", "restriction");
+            tags.add_tag("restriction", rnd.chance(0.5) ? "no_left_turn" : "no_u_turn");
+            break;
+          }
+        }
+        addRelationMembers(builder, buffer, rel, kind, rnd);
+      }
+      buffer.commit();
+      ++counts.relations;
+      possiblyFlush(writer, buffer);
+    }
+    writer(std::move(buffer));
+  }
+};
+
+#endif // SYNTHETICDATA_HPP
@@ -0,0 +1,269 @@
+
+// Rosmium: R bindings for the Osmium library
+// Copyright (C) 2016 Lukas Huwiler
+//
+// This file is part of Rosmium.
+//
+// Rosmium is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Rosmium is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Rosmium.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TAGTRANSFORM_HPP
+#define TAGTRANSFORM_HPP
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <regex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include <osmium/builder/osm_object_builder.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/memory/item.hpp>
+#include <osmium/osm/node.hpp>
+#include <osmium/osm/object.hpp>
+#include <osmium/osm/relation.hpp>
+#include <osmium/osm/tag.hpp>
+#include <osmium/osm/way.hpp>
+#include <osmium/thread/pool.hpp>
+
+/**
+ * Declarative rewrite of the tags of an object. The rules are applied to
+ * every tag in this order:
+ *  1. tags whose key matches one of the drop patterns (regular expressions
+ *     matching the whole key) are removed,
+ *  2. if there is a keep list, tags whose key is not on it are removed,
+ *  3. the key is renamed,
+ *  4. the value is mapped (looked up by the new key).
+ * If a renamed key collides with a key already written, the first tag is
+ * kept. Objects whose tags do not change are copied as they are.
+ */
+class TagTransform {
+public:
+
+  void drop(const std::string& pattern) {
+    mDrop.emplace_back(pattern);
+  }
+
+  void keep(const std::string& key) {
+    mKeep.insert(key);
+  }
+
+  void rename(const std::string& from, const std::string& to) {
+    mRename[from] = to;
+  }
+
+  void mapValue(const std::string& key, const std::string& from, const std::string& to) {
+    mValues[key][from] = to;
+  }
+
+  bool empty() const {
+    return mDrop.empty() && mKeep.empty() && mRename.empty() && mValues.empty();
+  }
+
+  // Adds a copy of the object with the transformed tags to the buffer and commits it
+  void apply(const osmium::OSMObject& object, osmium::memory::Buffer& out) const {
+    if(!changes(object.tags())) {
+      out.add_item(object);
+      out.commit();
+      return;
+    }
+    switch(object.type()) {
+      case osmium::item_type::node: {
+        osmium::builder::NodeBuilder builder(out);
+        copyAttributes(object, builder.object());
+        builder.object().set_location(static_cast<const osmium::Node&>(object).location());
+        builder.add_user(object.user());
+        addTags(object.tags(), builder);
+        break;
+      }
+      case osmium::item_type::way: {
+        osmium::builder::WayBuilder builder(out);
+        copyAttributes(object, builder.object());
+        builder.add_user(object.user());
+        addTags(object.tags(), builder);
+        builder.add_item(&static_cast<const osmium::Way&>(object).nodes());
+        break;
+      }
+      case osmium::item_type::relation: {
+        osmium::builder::RelationBuilder builder(out);
+        copyAttributes(object, builder.object());
+        builder.add_user(object.user());
+        addTags(object.tags(), builder);
+        builder.add_item(&static_cast<const osmium::Relation&>(object).members());
+        break;
+      }
+      default:
+        out.add_item(object);
+        break;
+    }
+    out.commit();
+  }
+
+private:
+  std::vector<std::regex> mDrop;
+  std::unordered_set<std::string> mKeep;
+  std::unordered_map<std::string, std::string> mRename;
+  std::unordered_map<std::string, std::unordered_map<std::string, std::string>> mValues;
+
+  bool dropped(const char* key) const {
+    if(!mKeep.empty() && mKeep.count(key) == 0) {
+      return true;
+    }
+    for(const std::regex& pattern : mDrop) {
+      if(std::regex_match(key, pattern)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  const std::string* renamed(const std::string& key) const {
+    auto it = mRename.find(key);
+    return it == mRename.end() ? nullptr : &it->second;
+  }
+
+  const std::string* mapped(const std::string& key, const char* value) const {
+    auto values = mValues.find(key);
+    if(values == mValues.end()) {
+      return nullptr;
+    }
+    auto it = values->second.find(value);
+    return it == values->second.end() ? nullptr : &it->second;
+  }
+
+  bool changes(const osmium::TagList& tags) const {
+    for(const osmium::Tag& tag : tags) {
+      const std::string key = tag.key();
+      if(dropped(tag.key()) || renamed(key) != nullptr || mapped(key, tag.value()) != nullptr) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static void copyAttributes(const osmium::OSMObject& source, osmium::OSMObject& target) {
+    target.set_id(source.id());
+    target.set_version(source.version());
+    target.set_changeset(source.changeset());
+    target.set_timestamp(source.timestamp());
+    target.set_visible(source.visible());
+    target.set_uid(source.uid());
+  }
+
+  void addTags(const osmium::TagList& tags, osmium::builder::Builder& parent) const {
+    osmium::builder::TagListBuilder builder(parent.buffer(), &parent);
+    std::unordered_set<std::string> written;
+    for(const osmium::Tag& tag : tags) {
+      if(dropped(tag.key())) {
+        continue;
+      }
+      std::string key = tag.key();
+      if(const std::string* new_key = renamed(key)) {
+        key = *new_key;
+      }
+      if(!written.insert(key).second) {
+        continue;
+      }
+      const std::string* new_value = mapped(key, tag.value());
+      builder.add_tag(key, new_value != nullptr ? *new_value : std::string(tag.value()));
+    }
+  }
+};
+
+// Transforms the objects of a batch on a pool thread
+struct TagTransformTask {
+  std::shared_ptr<const TagTransform> transform;
+  std::shared_ptr<osmium::memory::Buffer> input;
+
+  osmium::memory::Buffer operator()() const {
+    const size_t capacity = osmium::memory::padded_length(input->committed() + input->committed() / 8 + 1024);
+    osmium::memory::Buffer output(capacity, osmium::memory::Buffer::auto_grow::yes);
+    for(auto it = input->begin<osmium::OSMObject>(); it != input->end<osmium::OSMObject>(); ++it) {
+      transform->apply(*it, output);
+    }
+    return output;
+  }
+};
+
+/**
+ * Collects the objects passed to a writer in batches, transforms the
+ * batches on the osmium thread pool and passes the results on in the
+ * original order. At most max_pending batches are in flight, so the
+ * memory stays bounded if the transformation is faster than the writer.
+ */
+class TagTransformStage {
+public:
+  typedef std::function<void(osmium::memory::Buffer&&)> output_type;
+
+  TagTransformStage(std::shared_ptr<const TagTransform> transform, output_type output) :
+    mTransform(transform),
+    mOutput(output),
+    mBatch(newBatch()) {
+  }
+
+  void add(const osmium::OSMObject& object) {
+    mBatch->add_item(object);
+    mBatch->commit();
+    if(mBatch->committed() >= batch_size) {
+      submit();
+    }
+  }
+
+  // Transforms the last batch and waits for all results
+  void finish() {
+    if(mBatch->committed() > 0) {
+      submit();
+    }
+    deliver(true);
+  }
+
+private:
+  static const size_t batch_size = 1024 * 1024;
+  static const size_t max_pending = 16;
+
+  std::shared_ptr<const TagTransform> mTransform;
+  output_type mOutput;
+  std::shared_ptr<osmium::memory::Buffer> mBatch;
+  std::deque<std::future<osmium::memory::Buffer>> mPending;
+
+  static std::shared_ptr<osmium::memory::Buffer> newBatch() {
+    return std::make_shared<osmium::memory::Buffer>(batch_size + batch_size / 4, osmium::memory::Buffer::auto_grow::yes);
+  }
+
+  void submit() {
+    TagTransformTask task = {mTransform, mBatch};
+    mBatch = newBatch();
+    mPending.push_back(osmium::thread::Pool::instance().submit(task));
+    deliver(false);
+    while(mPending.size() >= max_pending) {
+      mPending.front().wait();
+      deliver(false);
+    }
+  }
+
+  void deliver(bool wait) {
+    while(!mPending.empty() &&
+          (wait || mPending.front().wait_for(std::chrono::seconds(0)) == std::future_status::ready)) {
+      osmium::memory::Buffer buffer = mPending.front().get();
+      mPending.pop_front();
+      mOutput(std::move(buffer));
+    }
+  }
+};
+
+#endif // TAGTRANSFORM_HPP
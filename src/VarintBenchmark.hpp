@@ -0,0 +1,241 @@
+
+// Rosmium: R bindings for the Osmium library
+// Copyright (C) 2016 Lukas Huwiler
+//
+// This file is part of Rosmium.
+//
+// Rosmium is free software: you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Rosmium is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Rosmium.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef VARINTBENCHMARK_HPP
+#define VARINTBENCHMARK_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <protozero/pbf_message.hpp>
+#include <osmium/io/detail/pbf_decoder.hpp>
+#include <osmium/io/detail/pbf_varint.hpp>
+#include <osmium/io/detail/protobuf_tags.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/entity_bits.hpp>
+
+#include "PBFBlobReader.hpp"
+
+struct VarintBenchmarkResult {
+  std::string decoder;
+  std::string stage;
+  bool supported = false;
+  uint64_t values = 0;
+  uint64_t bytes = 0;
+  double seconds = 0;
+  bool matches = false;
+};
+
+/**
+ * Compares the packed varint decoders (scalar, SSE2, AVX2) on the blocks of
+ * a PBF file. The blobs are read and uncompressed into memory first. Two
+ * stages are measured: the delta coded packed fields alone (the ids,
+ * coordinates and info of dense nodes, way refs and relation member ids),
+ * and the decoding of whole blocks into buffers with the decoder selected.
+ * The results of every decoder are compared with the scalar decoder.
+ */
+class VarintBenchmark {
+public:
+
+  explicit VarintBenchmark(const std::string& filename) {
+    PBFBlobReader reader(filename);
+    PBFBlob blob;
+    while(reader.next(blob)) {
+      std::string output;
+      const osmium::io::detail::ptr_len_type block = osmium::io::detail::decode_blob(blob.data, output);
+      mBlocks.emplace_back(block.first, block.second);
+    }
+    for(const std::string& block : mBlocks) {
+      collectFields(block);
+    }
+    mFieldChecksum = decodeFields(osmium::io::detail::varint_decoder::scalar, mValues);
+    mBlockChecksum = decodeBlocks(osmium::io::detail::varint_decoder::scalar);
+  }
+
+  VarintBenchmarkResult fields(osmium::io::detail::varint_decoder decoder, int rounds) const {
+    VarintBenchmarkResult result = prepare(decoder, "fields");
+    if(result.supported) {
+      uint64_t checksum = 0;
+      uint64_t values = 0;
+      auto start = std::chrono::steady_clock::now();
+      for(int i = 0; i < rounds; ++i) {
+        checksum = decodeFields(decoder, values);
+      }
+      result.seconds = seconds(start);
+      result.values = values * rounds;
+      result.bytes = mFieldBytes * rounds;
+      result.matches = checksum == mFieldChecksum;
+    }
+    return result;
+  }
+
+  VarintBenchmarkResult blocks(osmium::io::detail::varint_decoder decoder, int rounds) const {
+    VarintBenchmarkResult result = prepare(decoder, "blocks");
+    if(result.supported) {
+      uint64_t checksum = 0;
+      auto start = std::chrono::steady_clock::now();
+      for(int i = 0; i < rounds; ++i) {
+        checksum = decodeBlocks(decoder);
+      }
+      result.seconds = seconds(start);
+      result.values = mValues * rounds;
+      result.bytes = mFieldBytes * rounds;
+      result.matches = checksum == mBlockChecksum;
+    }
+    return result;
+  }
+
+private:
+  typedef osmium::io::detail::ptr_len_type field_type;
+
+  // Selects a decoder for all reads and restores the previous one
+  class DecoderSelection {
+  public:
+    explicit DecoderSelection(osmium::io::detail::varint_decoder decoder) :
+      mPrevious(osmium::io::detail::varint::decoder_setting().load()) {
+      osmium::io::detail::set_varint_decoder(decoder);
+    }
+
+    ~DecoderSelection() {
+      osmium::io::detail::varint::decoder_setting().store(mPrevious);
+    }
+
+  private:
+    int mPrevious;
+  };
+
+  std::vector<std::string> mBlocks;
+  std::vector<field_type> mFields;
+  uint64_t mFieldBytes = 0;
+  uint64_t mValues = 0;
+  uint64_t mFieldChecksum = 0;
+  uint64_t mBlockChecksum = 0;
+
+  template <typename TTimePoint>
+  static double seconds(const TTimePoint& start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  static VarintBenchmarkResult prepare(osmium::io::detail::varint_decoder decoder, const std::string& stage) {
+    VarintBenchmarkResult result;
+    result.decoder = osmium::io::detail::varint_decoder_name(decoder);
+    result.stage = stage;
+    result.supported = osmium::io::detail::varint_decoder_supported(decoder);
+    return result;
+  }
+
+  void addField(const field_type& field) {
+    mFields.push_back(field);
+    mFieldBytes += field.second;
+  }
+
+  // The delta coded packed fields of a primitive block
+  void collectFields(const std::string& block) {
+    using namespace osmium::io::detail;
+    protozero::pbf_message<OSMFormat::PrimitiveBlock> pbf_block(block);
+    while(pbf_block.next(OSMFormat::PrimitiveBlock::repeated_PrimitiveGroup_primitivegroup)) {
+      protozero::pbf_message<OSMFormat::PrimitiveGroup> pbf_group = pbf_block.get_message();
+      while(pbf_group.next()) {
+        switch(pbf_group.tag()) {
+          case OSMFormat::PrimitiveGroup::optional_DenseNodes_dense:
+            collectDenseNodes(pbf_group.get_message());
+            break;
+          case OSMFormat::PrimitiveGroup::repeated_Way_ways: {
+            protozero::pbf_message<OSMFormat::Way> pbf_way = pbf_group.get_message();
+            while(pbf_way.next(OSMFormat::Way::packed_sint64_refs)) {
+              addField(pbf_way.get_data());
+            }
+            break;
+          }
+          case OSMFormat::PrimitiveGroup::repeated_Relation_relations: {
+            protozero::pbf_message<OSMFormat::Relation> pbf_relation = pbf_group.get_message();
+            while(pbf_relation.next(OSMFormat::Relation::packed_sint64_memids)) {
+              addField(pbf_relation.get_data());
+            }
+            break;
+          }
+          default:
+            pbf_group.skip();
+        }
+      }
+    }
+  }
+
+  void collectDenseNodes(protozero::pbf_message<osmium::io::detail::OSMFormat::DenseNodes> pbf_dense) {
+    using namespace osmium::io::detail;
+    while(pbf_dense.next()) {
+      switch(pbf_dense.tag()) {
+        case OSMFormat::DenseNodes::packed_sint64_id:
+        case OSMFormat::DenseNodes::packed_sint64_lat:
+        case OSMFormat::DenseNodes::packed_sint64_lon:
+          addField(pbf_dense.get_data());
+          break;
+        case OSMFormat::DenseNodes::optional_DenseInfo_denseinfo: {
+          protozero::pbf_message<OSMFormat::DenseInfo> pbf_info = pbf_dense.get_message();
+          while(pbf_info.next()) {
+            switch(pbf_info.tag()) {
+              case OSMFormat::DenseInfo::packed_sint64_timestamp:
+              case OSMFormat::DenseInfo::packed_sint64_changeset:
+              case OSMFormat::DenseInfo::packed_sint32_uid:
+              case OSMFormat::DenseInfo::packed_sint32_user_sid:
+                addField(pbf_info.get_data());
+                break;
+              default:
+                pbf_info.skip();
+            }
+          }
+          break;
+        }
+        default:
+          pbf_dense.skip();
+      }
+    }
+  }
+
+  uint64_t decodeFields(osmium::io::detail::varint_decoder decoder, uint64_t& values) const {
+    std::vector<int64_t> decoded;
+    uint64_t checksum = 0;
+    values = 0;
+    for(const field_type& field : mFields) {
+      osmium::io::detail::decode_packed_sint_delta(field.first, field.first + field.second, decoded, decoder);
+      for(size_t i = 0; i < decoded.size(); ++i) {
+        checksum += static_cast<uint64_t>(decoded[i]) * (i + 1);
+      }
+      values += decoded.size();
+    }
+    return checksum;
+  }
+
+  uint64_t decodeBlocks(osmium::io::detail::varint_decoder decoder) const {
+    DecoderSelection selection(decoder);
+    uint64_t checksum = 0;
+    for(const std::string& block : mBlocks) {
+      osmium::io::detail::PBFPrimitiveBlockDecoder blockDecoder(
+        osmium::io::detail::ptr_len_type(block.data(), block.size()), osmium::osm_entity_bits::nwr);
+      osmium::memory::Buffer buffer = blockDecoder();
+      checksum = checksum * 31 + std::hash<std::string>()(std::string(reinterpret_cast<const char*>(buffer.data()), buffer.committed()));
+    }
+    return checksum;
+  }
+};
+
+#endif // VARINTBENCHMARK_HPP
@@ -18,13 +18,16 @@
 // along with Rosmium.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <Rcpp.h>
+#include <chrono>
+#include <cmath>
+#include <iterator>
 #include <memory>
 #include <unordered_set>
+#include <unordered_map>
 #include <math.h>
 #include <osmium/handler.hpp>
 #include <osmium/handler/node_locations_for_ways.hpp>
 #include <osmium/area/assembler.hpp>
-#include <osmium/area/multipolygon_collector.hpp>
 #include <osmium/visitor.hpp>
 #include <osmium/osm/tag.hpp>
 #include <osmium/osm/object.hpp>
@@ -38,14 +41,42 @@
 #include <osmium/memory/buffer.hpp>
 #include <osmium/index/map/all.hpp>
 #include <osmium/index/node_locations_map.hpp>
+#include <osmium/geom/tile.hpp>
+#include <osmium/osm/box.hpp>
+#include <osmium/osm/timestamp.hpp>
 #include <map>
 
 
 #include "object_filter/interpreter.h"
 #include "OSMObjects.hpp"
+#include "MemoryAccounting.hpp"
+#include "LocationIndex.hpp"
+#include "SyntheticData.hpp"
+#include "IndexBenchmark.hpp"
+#include "GeometryBenchmark.hpp"
+#include "VarintBenchmark.hpp"
+#include "ParallelApply.hpp"
+#include "HandlerChain.hpp"
+#include "AreaStatistics.hpp"
+#include "ParallelMultipolygonCollector.hpp"
+#include "AreaTags.hpp"
+#include "RouteCollector.hpp"
+#include "HistoryFilter.hpp"
+#include "SnapshotDiff.hpp"
+#include "ChangesetStats.hpp"
+#include "FeatureExporter.hpp"
+#include "OutputTarget.hpp"
+#include "Checkpoint.hpp"
+#include "NativeExtension.hpp"
+#include "SpatialPartition.hpp"
+#include "BlobIndex.hpp"
+#include "TagTransform.hpp"
 
 RCPP_EXPOSED_CLASS(OSMReader)
 RCPP_EXPOSED_CLASS(CountHandler)
+RCPP_EXPOSED_CLASS(StatsHandler)
+RCPP_EXPOSED_CLASS(TileHandler)
+RCPP_EXPOSED_CLASS(ChangesetHandler)
 RCPP_EXPOSED_CLASS(RHandler)
 RCPP_EXPOSED_CLASS(WriteHandler)
 RCPP_EXPOSED_CLASS(Dummy)
@@ -53,8 +84,6 @@ RCPP_EXPOSED_CLASS(ObjectFilter)
   
 typedef std::map<osmium::osm_entity_bits::type, Rcpp::Function> EntityFunctionMap;
 typedef std::pair<osmium::osm_entity_bits::type, Rcpp::Function> EntityFunctionPair;
-typedef osmium::index::map::SparseMemArray<osmium::unsigned_object_id_type, osmium::Location> sparse_mem_array;
-typedef osmium::index::map::Map<osmium::unsigned_object_id_type, osmium::Location> index_type;
 
 class ParseException : public std::exception
 {
@@ -80,6 +109,9 @@ public:
     }
   } 
   
+  // Filter of a native predicate, combined with another filter if given
+  ObjectFilter(std::shared_ptr<tagfilter::Command> command) : mCommand(command) {}
+  
   std::shared_ptr<tagfilter::Command> getCommand() {
     return mCommand;
   }
@@ -92,18 +124,231 @@ struct CountHandler : public osmium::handler::Handler {
   uint64_t ways = 0;
   uint64_t relations = 0;
   
-  void node(osmium::Node&) {
+  void node(const osmium::Node&) {
     ++nodes;
   }
   
-  void way(osmium::Way&) {
+  void way(const osmium::Way&) {
     ++ways;
   }
   
-  void relation(osmium::Relation&) {
+  void relation(const osmium::Relation&) {
     ++relations;
   }
   
+  void merge(const CountHandler& other) {
+    nodes += other.nodes;
+    ways += other.ways;
+    relations += other.relations;
+  }
+  
+  void clear() {
+    nodes = 0;
+    ways = 0;
+    relations = 0;
+  }
+  
+  void save(StateWriter& state) const {
+    state.write(nodes);
+    state.write(ways);
+    state.write(relations);
+  }
+  
+  void load(StateReader& state) {
+    nodes = state.read<uint64_t>();
+    ways = state.read<uint64_t>();
+    relations = state.read<uint64_t>();
+  }
+  
+};
+
+// Summary statistics of a file (object counts, tags, references, versions, time range and extent)
+class StatsHandler : public osmium::handler::Handler {
+public:
+  
+  void node(const osmium::Node& node) {
+    ++mNodes;
+    object(node);
+    if(node.location().valid()) {
+      mExtent.extend(node.location());
+    }
+  }
+  
+  void way(const osmium::Way& way) {
+    ++mWays;
+    object(way);
+    mWayNodes += way.nodes().size();
+  }
+  
+  void relation(const osmium::Relation& rel) {
+    ++mRelations;
+    object(rel);
+    mMembers += rel.members().size();
+  }
+  
+  void merge(const StatsHandler& other) {
+    mNodes += other.mNodes;
+    mWays += other.mWays;
+    mRelations += other.mRelations;
+    mTags += other.mTags;
+    mWayNodes += other.mWayNodes;
+    mMembers += other.mMembers;
+    mMaxVersion = std::max(mMaxVersion, other.mMaxVersion);
+    mMaxId = std::max(mMaxId, other.mMaxId);
+    if(other.mFirstTimestamp < mFirstTimestamp) {
+      mFirstTimestamp = other.mFirstTimestamp;
+    }
+    if(other.mLastTimestamp > mLastTimestamp) {
+      mLastTimestamp = other.mLastTimestamp;
+    }
+    if(other.mExtent.valid()) {
+      mExtent.extend(other.mExtent);
+    }
+  }
+  
+  void clear() {
+    *this = StatsHandler();
+  }
+  
+  void save(StateWriter& state) const {
+    for(double value : {mNodes, mWays, mRelations, mTags, mWayNodes, mMembers, mMaxVersion, mMaxId}) {
+      state.write(value);
+    }
+    state.write(static_cast<uint32_t>(mFirstTimestamp));
+    state.write(static_cast<uint32_t>(mLastTimestamp));
+    for(const osmium::Location& location : {mExtent.bottom_left(), mExtent.top_right()}) {
+      state.write(location.x());
+      state.write(location.y());
+    }
+  }
+  
+  void load(StateReader& state) {
+    for(double* value : {&mNodes, &mWays, &mRelations, &mTags, &mWayNodes, &mMembers, &mMaxVersion, &mMaxId}) {
+      *value = state.read<double>();
+    }
+    mFirstTimestamp = osmium::Timestamp(state.read<uint32_t>());
+    mLastTimestamp = osmium::Timestamp(state.read<uint32_t>());
+    for(osmium::Location* location : {&mExtent.bottom_left(), &mExtent.top_right()}) {
+      const int32_t x = state.read<int32_t>();
+      *location = osmium::Location(x, state.read<int32_t>());
+    }
+  }
+  
+  Rcpp::NumericVector summary() {
+    bool has_time = mFirstTimestamp <= mLastTimestamp;
+    bool has_extent = mExtent.valid();
+    return Rcpp::NumericVector::create(
+      Rcpp::Named("nodes") = mNodes, Rcpp::Named("ways") = mWays, Rcpp::Named("relations") = mRelations,
+      Rcpp::Named("tags") = mTags, Rcpp::Named("way_nodes") = mWayNodes, Rcpp::Named("members") = mMembers,
+      Rcpp::Named("max_id") = mMaxId, Rcpp::Named("max_version") = mMaxVersion,
+      Rcpp::Named("first_timestamp") = has_time ? mFirstTimestamp.seconds_since_epoch() : NA_REAL,
+      Rcpp::Named("last_timestamp") = has_time ? mLastTimestamp.seconds_since_epoch() : NA_REAL,
+      Rcpp::Named("min_lon") = has_extent ? mExtent.bottom_left().lon() : NA_REAL,
+      Rcpp::Named("min_lat") = has_extent ? mExtent.bottom_left().lat() : NA_REAL,
+      Rcpp::Named("max_lon") = has_extent ? mExtent.top_right().lon() : NA_REAL,
+      Rcpp::Named("max_lat") = has_extent ? mExtent.top_right().lat() : NA_REAL);
+  }
+  
+private:
+  double mNodes = 0;
+  double mWays = 0;
+  double mRelations = 0;
+  double mTags = 0;
+  double mWayNodes = 0;
+  double mMembers = 0;
+  double mMaxVersion = 0;
+  double mMaxId = 0;
+  osmium::Timestamp mFirstTimestamp = osmium::end_of_time();
+  osmium::Timestamp mLastTimestamp = osmium::start_of_time();
+  osmium::Box mExtent;
+  
+  void object(const osmium::OSMObject& obj) {
+    mTags += obj.tags().size();
+    mMaxVersion = std::max(mMaxVersion, static_cast<double>(obj.version()));
+    mMaxId = std::max(mMaxId, static_cast<double>(obj.id()));
+    if(obj.timestamp().valid()) {
+      if(obj.timestamp() < mFirstTimestamp) {
+        mFirstTimestamp = obj.timestamp();
+      }
+      if(obj.timestamp() > mLastTimestamp) {
+        mLastTimestamp = obj.timestamp();
+      }
+    }
+  }
+};
+
+// Number of nodes per web mercator tile at the given zoom level
+class TileHandler : public osmium::handler::Handler {
+public:
+  
+  TileHandler(int zoom) {
+    if(zoom < 0 || zoom > 30) {
+      Rcpp::stop("zoom has to be between 0 and 30");
+    }
+    mZoom = zoom;
+  }
+  
+  void node(const osmium::Node& node) {
+    if(node.location().valid()) {
+      osmium::geom::Tile tile(mZoom, node.location());
+      ++mCounts[(static_cast<uint64_t>(tile.x) << 32) | tile.y];
+    }
+  }
+  
+  void merge(const TileHandler& other) {
+    for(const auto& count : other.mCounts) {
+      mCounts[count.first] += count.second;
+    }
+  }
+  
+  void clear() {
+    mCounts.clear();
+  }
+  
+  void save(StateWriter& state) const {
+    state.write(mZoom);
+    state.write(static_cast<uint64_t>(mCounts.size()));
+    for(const auto& count : mCounts) {
+      state.write(count.first);
+      state.write(count.second);
+    }
+  }
+  
+  void load(StateReader& state) {
+    if(state.read<uint32_t>() != mZoom) {
+      throw std::runtime_error("The checkpoint was written for another zoom level");
+    }
+    mCounts.clear();
+    const uint64_t size = state.read<uint64_t>();
+    for(uint64_t i = 0; i < size; ++i) {
+      const uint64_t tile = state.read<uint64_t>();
+      mCounts[tile] = state.read<uint64_t>();
+    }
+  }
+  
+  int getZoom() {
+    return mZoom;
+  }
+  
+  Rcpp::DataFrame tiles() {
+    std::vector<std::pair<uint64_t, uint64_t> > counts(mCounts.begin(), mCounts.end());
+    std::sort(counts.begin(), counts.end());
+    Rcpp::IntegerVector x(counts.size()), y(counts.size());
+    Rcpp::IntegerVector zoom(counts.size(), static_cast<int>(mZoom));
+    Rcpp::NumericVector nodes(counts.size());
+    for(size_t i = 0; i < counts.size(); ++i) {
+      x[i] = static_cast<int>(counts[i].first >> 32);
+      y[i] = static_cast<int>(counts[i].first & 0xffffffff);
+      nodes[i] = counts[i].second;
+    }
+    return Rcpp::DataFrame::create(Rcpp::Named("x") = x, Rcpp::Named("y") = y,
+                                   Rcpp::Named("zoom") = zoom,
+                                   Rcpp::Named("nodes") = nodes);
+  }
+  
+private:
+  uint32_t mZoom;
+  std::unordered_map<uint64_t, uint64_t> mCounts;
 };
 
 class HandlerWithFilter : public osmium::handler::Handler {
@@ -148,12 +393,47 @@ class WriteHandler : public HandlerWithFilter {
 public:
   
   WriteHandler(std::string filename) {
-    mFilename = filename;
+    mTarget.filename = filename;
     // mWriter = std::make_shared<osmium::io::Writer>(filename); 
   } 
   
+  void toFile(std::string filename, std::string format, bool overwrite) {
+    mTarget = OutputTarget();
+    mTarget.filename = filename;
+    mTarget.format = format;
+    mTarget.overwrite = overwrite;
+  }
+  
+  // Writes to an open file descriptor (1 for stdout), which stays open
+  void toFd(int fd, std::string format) {
+    mTarget = OutputTarget();
+    mTarget.kind = OutputTarget::Kind::fd;
+    mTarget.fd = fd;
+    mTarget.format = format;
+  }
+  
+  /**
+   * Passes the output as raw vectors to an R function (which writes them to
+   * a connection) as soon as more than max_pending bytes are waiting, and
+   * the rest when the writer is closed.
+   */
+  void toConnection(Rcpp::Function write, std::string format, double max_pending) {
+    mTarget = OutputTarget();
+    mTarget.kind = OutputTarget::Kind::sink;
+    mTarget.format = format;
+    mConnectionWriter = std::make_shared<Rcpp::Function>(write);
+    mMaxPending = static_cast<size_t>(max_pending);
+  }
+  
   void init() {
-    mWriter = std::make_shared<osmium::io::Writer>(mFilename); 
+    mWriter = mTarget.open(mSink);
+    if(mTransform != nullptr) {
+      std::shared_ptr<osmium::io::Writer> writer = mWriter;
+      mStage = std::make_shared<TagTransformStage>(mTransform, [this, writer](osmium::memory::Buffer&& buffer) {
+        (*writer)(std::move(buffer));
+        drainSink(false);
+      });
+    }
     mNodeRefs = std::make_shared<std::unordered_set<osmium::object_id_type>>();
     mWayRefs = std::make_shared<std::unordered_set<osmium::object_id_type>>();
     mRelRefs = std::make_shared<std::unordered_set<osmium::object_id_type>>();
@@ -161,28 +441,71 @@ public:
   
   void close() {
     clearFilter();
+    if(mWriter == nullptr) {
+      return;
+    }
+    if(mStage != nullptr) {
+      mStage->finish();
+      mStage = nullptr;
+    }
     mWriter->close();
+    drainSink(true);
+    mSink = nullptr;
     mWriter = nullptr;
     mNodeRefs = nullptr;
     mWayRefs = nullptr;
     mRelRefs = nullptr; 
   }
   
+  /**
+   * Rewrites the tags of all objects written from now on (see TagTransform).
+   * The rules are given as parallel vectors: drop patterns, keys to keep,
+   * renamed keys (from, to) and mapped values (key, from, to).
+   */
+  void setTagTransform(Rcpp::CharacterVector drop, Rcpp::CharacterVector keep,
+                       Rcpp::CharacterVector rename_from, Rcpp::CharacterVector rename_to,
+                       Rcpp::CharacterVector value_key, Rcpp::CharacterVector value_from,
+                       Rcpp::CharacterVector value_to) {
+    std::shared_ptr<TagTransform> transform = std::make_shared<TagTransform>();
+    try {
+      for(int i = 0; i < drop.size(); ++i) {
+        transform->drop(Rcpp::as<std::string>(drop[i]));
+      }
+    } catch(std::regex_error& e) {
+      Rcpp::stop("Invalid pattern in drop: " + std::string(e.what()));
+    }
+    for(int i = 0; i < keep.size(); ++i) {
+      transform->keep(Rcpp::as<std::string>(keep[i]));
+    }
+    for(int i = 0; i < rename_from.size(); ++i) {
+      transform->rename(Rcpp::as<std::string>(rename_from[i]), Rcpp::as<std::string>(rename_to[i]));
+    }
+    for(int i = 0; i < value_key.size(); ++i) {
+      transform->mapValue(Rcpp::as<std::string>(value_key[i]), Rcpp::as<std::string>(value_from[i]),
+                          Rcpp::as<std::string>(value_to[i]));
+    }
+    mTransform = transform->empty() ? nullptr : transform;
+  }
+  
+  void clearTagTransform() {
+    mTransform = nullptr;
+  }
+  
   void node(const osmium::Node& node) {
     if(containsID(node.id(), mNodeRefs) || meetsFilterCondition(node)) {     
-      (*mWriter)(node);     
+      write(node);
     }
   }
   
   void way(const osmium::Way& way) {
     if(containsID(way.id(), mWayRefs) || meetsFilterCondition(way)) {
-      (*mWriter)(way);
+      write(way);
     }
   }
 
   void relation(const osmium::Relation& rel) {
     if(containsID(rel.id(), mRelRefs) || meetsFilterCondition(rel)) {
-      (*mWriter)(rel); 
+      write(rel);
     }
   } 
   
@@ -206,9 +529,22 @@ public:
     } 
   }
   
+  size_t usedMemory() const {
+    if(mNodeRefs == nullptr) {
+      return 0;
+    }
+    return ::usedMemory(*mNodeRefs) + ::usedMemory(*mWayRefs) + ::usedMemory(*mRelRefs);
+  }
+  
 private:
-  std::string mFilename;
+  OutputTarget mTarget;
   std::shared_ptr<osmium::io::Writer> mWriter; 
+  std::shared_ptr<SinkQueue> mSink;
+  std::shared_ptr<Rcpp::Function> mConnectionWriter;
+  size_t mMaxPending = 0;
+  std::shared_ptr<TagTransform> mTransform;
+  // Transforms the tags on the thread pool ahead of the writer while writing
+  std::shared_ptr<TagTransformStage> mStage;
   std::shared_ptr<std::unordered_set<osmium::object_id_type>> mNodeRefs; 
   std::shared_ptr<std::unordered_set<osmium::object_id_type>> mWayRefs;
   std::shared_ptr<std::unordered_set<osmium::object_id_type>> mRelRefs;
@@ -216,6 +552,26 @@ private:
   bool containsID(osmium::object_id_type id, std::shared_ptr<std::unordered_set<osmium::object_id_type>> ids) {
     return ids->count(id) > 0;
   }
+  
+  template <typename TObject>
+  void write(const TObject& object) {
+    if(mStage != nullptr) {
+      mStage->add(object);
+    } else {
+      (*mWriter)(object);
+      drainSink(false);
+    }
+  }
+  
+  // Runs on the main thread: R must not be called from the write thread
+  void drainSink(bool all) {
+    if(mSink == nullptr || (!all && mSink->pending() <= mMaxPending)) {
+      return;
+    }
+    for(const std::string& chunk : mSink->take()) {
+      (*mConnectionWriter)(Rcpp::RawVector(chunk.begin(), chunk.end()));
+    }
+  }
 };
 
 class WriteHelper : public HandlerWithFilter {
@@ -267,6 +623,10 @@ public:
     return !mWaysToDo->empty();
   }
   
+  size_t usedMemory() const {
+    return ::usedMemory(*mWaysToDo) + ::usedMemory(*mRelToDo);
+  }
+  
 private:
   std::shared_ptr<std::unordered_set<osmium::object_id_type>> mWaysToDo;
   std::shared_ptr<std::unordered_set<osmium::object_id_type>> mRelToDo;
@@ -277,6 +637,8 @@ class RHandler : public osmium::handler::Handler {
 public: 
   
   int mResultSize = 0;
+  // Build areas from closed ways with area tags only, in one pass without the relation pre-pass
+  bool mWayAreas = false;
   
   RHandler(Rcpp::CharacterVector object_includes, Rcpp::IntegerVector max_results) : mRWrapper(object_includes){
     mResultSize = Rcpp::as<int>(max_results);
@@ -303,19 +665,22 @@ public:
   
   void node(const osmium::Node& node) {
     if(mFunctions.count(osmium::osm_entity_bits::node) && meetsFilterCondition(node) && mCurrentCount++ < mResultSize) {     
-      (mFunctions.at(osmium::osm_entity_bits::node))(mRWrapper.createRNode(node), mCurrentCount);
+      (mFunctions.at(osmium::osm_entity_bits::node))(withHistory(mRWrapper.createRNode(node)), mCurrentCount);
     }
   }
   
   void way(const osmium::Way& way) {
     if(mFunctions.count(osmium::osm_entity_bits::way) && meetsFilterCondition(way) && mCurrentCount++ < mResultSize) {
-        (mFunctions.at(osmium::osm_entity_bits::way))(mRWrapper.createRWay(way), mCurrentCount);
+        (mFunctions.at(osmium::osm_entity_bits::way))(withHistory(mRWrapper.createRWay(way)), mCurrentCount);
+    }
+    if(mWayAreas && mFunctions.count(osmium::osm_entity_bits::area) && isAreaWay(way) && meetsFilterCondition(way) && mCurrentCount++ < mResultSize) {
+      (mFunctions.at(osmium::osm_entity_bits::area))(withHistory(mRWrapper.createRArea(way)), mCurrentCount);
     }
   }
 
   void relation(const osmium::Relation& rel) {
     if(mFunctions.count(osmium::osm_entity_bits::relation) && meetsFilterCondition(rel) && mCurrentCount++ < mResultSize) {
-      (mFunctions.at(osmium::osm_entity_bits::relation))(mRWrapper.createRRelation(rel), mCurrentCount);
+      (mFunctions.at(osmium::osm_entity_bits::relation))(withHistory(mRWrapper.createRRelation(rel)), mCurrentCount);
     }
   }
   
@@ -329,6 +694,32 @@ public:
     return mFunctions.count(osmium::osm_entity_bits::area) > 0;
   }
   
+  // Areas are built from relations (multipolygon and boundary) and closed ways by the osmium assembler
+  bool needsMultipolygons() {
+    return hasAreaCallback() && !mWayAreas;
+  }
+  
+  size_t resultSize() const {
+    return mRWrapper.estimatedSize();
+  }
+  
+  // Version and validity interval of the next object, set when a history file is read with a time filter
+  void setHistory(const osmium::DiffObject& diff) {
+    mHistory = true;
+    mVersion = diff.version();
+    mValidFrom = diff.start_time();
+    mValidTo = diff.end_time();
+  }
+  
+  // Number of geometries created and of NA geometries by reason
+  Rcpp::NumericVector geometryProblems() {
+    const GeometryCounters& counters = mRWrapper.geometryCounters();
+    return Rcpp::NumericVector::create(Rcpp::Named("valid") = static_cast<double>(counters.valid),
+                                       Rcpp::Named("missing_location") = static_cast<double>(counters.missing_location),
+                                       Rcpp::Named("too_few_points") = static_cast<double>(counters.too_few_points),
+                                       Rcpp::Named("invalid_ring") = static_cast<double>(counters.invalid_ring));
+  }
+  
 private:
   
   void setFunction(Rcpp::Function& func, osmium::osm_entity_bits::type object_type) {
@@ -343,7 +734,23 @@ private:
     return mObjectFilter == nullptr || mObjectFilter->execute(obj);
   } 
   
+  // Adds the version and the validity interval (valid_to is NA for the current version) as attributes
+  Rcpp::List withHistory(Rcpp::List obj) {
+    if(mHistory) {
+      Rcpp::CharacterVector valid_to(1);
+      valid_to[0] = mValidTo == osmium::end_of_time() ? NA_STRING : Rf_mkChar(mValidTo.to_iso().c_str());
+      obj.attr("version") = static_cast<double>(mVersion);
+      obj.attr("valid_from") = mValidFrom.to_iso();
+      obj.attr("valid_to") = valid_to;
+    }
+    return obj;
+  }
+  
   int mCurrentCount = 0;
+  bool mHistory = false;
+  osmium::object_version_type mVersion = 0;
+  osmium::Timestamp mValidFrom;
+  osmium::Timestamp mValidTo;
   RosmiumWrapper mRWrapper;
   EntityFunctionMap mFunctions;
   std::shared_ptr<tagfilter::Command> mObjectFilter = nullptr;
@@ -352,6 +759,128 @@ private:
 
 
 
+// Columns of the changeset groups (users, time windows, hashtags), timestamps in seconds since 1970
+struct ChangesetGroupColumns {
+  Rcpp::NumericVector changesets, changes, comments, first, last, min_lon, min_lat, max_lon, max_lat;
+
+  explicit ChangesetGroupColumns(int n) :
+    changesets(n), changes(n), comments(n), first(n), last(n), min_lon(n), min_lat(n), max_lon(n), max_lat(n) {
+  }
+
+  void set(int i, const ChangesetGroup& group) {
+    const bool has_time = group.first <= group.last;
+    const bool has_bounds = group.bounds.valid();
+    changesets[i] = group.changesets;
+    changes[i] = group.changes;
+    comments[i] = group.comments;
+    first[i] = has_time ? group.first.seconds_since_epoch() : NA_REAL;
+    last[i] = has_time ? group.last.seconds_since_epoch() : NA_REAL;
+    min_lon[i] = has_bounds ? group.bounds.bottom_left().lon() : NA_REAL;
+    min_lat[i] = has_bounds ? group.bounds.bottom_left().lat() : NA_REAL;
+    max_lon[i] = has_bounds ? group.bounds.top_right().lon() : NA_REAL;
+    max_lat[i] = has_bounds ? group.bounds.top_right().lat() : NA_REAL;
+  }
+};
+
+// Users ordered by the number of changesets (most active first)
+Rcpp::DataFrame changeset_users(ChangesetHandler* handler) {
+  std::vector<std::pair<osmium::user_id_type, const UserGroup*> > users;
+  for(const auto& user : handler->users()) {
+    users.push_back(std::make_pair(user.first, &user.second));
+  }
+  std::sort(users.begin(), users.end(), [](const std::pair<osmium::user_id_type, const UserGroup*>& a,
+                                           const std::pair<osmium::user_id_type, const UserGroup*>& b) {
+    return a.second->changesets != b.second->changesets ? a.second->changesets > b.second->changesets : a.first < b.first;
+  });
+  const int n = static_cast<int>(users.size());
+  Rcpp::NumericVector uid(n);
+  Rcpp::CharacterVector user(n);
+  ChangesetGroupColumns columns(n);
+  for(int i = 0; i < n; ++i) {
+    uid[i] = users[i].first;
+    user[i] = users[i].second->name;
+    columns.set(i, *users[i].second);
+  }
+  return Rcpp::DataFrame::create(Rcpp::Named("uid") = uid, Rcpp::Named("user") = user,
+                                 Rcpp::Named("changesets") = columns.changesets, Rcpp::Named("changes") = columns.changes,
+                                 Rcpp::Named("comments") = columns.comments, Rcpp::Named("first") = columns.first,
+                                 Rcpp::Named("last") = columns.last, Rcpp::Named("min_lon") = columns.min_lon,
+                                 Rcpp::Named("min_lat") = columns.min_lat, Rcpp::Named("max_lon") = columns.max_lon,
+                                 Rcpp::Named("max_lat") = columns.max_lat, Rcpp::Named("stringsAsFactors") = false);
+}
+
+Rcpp::DataFrame changeset_windows(ChangesetHandler* handler) {
+  const int n = static_cast<int>(handler->windows().size());
+  Rcpp::NumericVector start(n);
+  ChangesetGroupColumns columns(n);
+  int i = 0;
+  for(const auto& window : handler->windows()) {
+    start[i] = window.first;
+    columns.set(i++, window.second);
+  }
+  return Rcpp::DataFrame::create(Rcpp::Named("start") = start,
+                                 Rcpp::Named("changesets") = columns.changesets, Rcpp::Named("changes") = columns.changes,
+                                 Rcpp::Named("comments") = columns.comments, Rcpp::Named("first") = columns.first,
+                                 Rcpp::Named("last") = columns.last, Rcpp::Named("min_lon") = columns.min_lon,
+                                 Rcpp::Named("min_lat") = columns.min_lat, Rcpp::Named("max_lon") = columns.max_lon,
+                                 Rcpp::Named("max_lat") = columns.max_lat);
+}
+
+// Hashtags ordered by the number of changesets
+Rcpp::DataFrame changeset_hashtags(ChangesetHandler* handler) {
+  std::vector<std::pair<std::string, const HashtagGroup*> > hashtags;
+  for(const auto& hashtag : handler->hashtags()) {
+    hashtags.push_back(std::make_pair(hashtag.first, &hashtag.second));
+  }
+  std::sort(hashtags.begin(), hashtags.end(), [](const std::pair<std::string, const HashtagGroup*>& a,
+                                                 const std::pair<std::string, const HashtagGroup*>& b) {
+    return a.second->changesets != b.second->changesets ? a.second->changesets > b.second->changesets : a.first < b.first;
+  });
+  const int n = static_cast<int>(hashtags.size());
+  Rcpp::CharacterVector hashtag(n);
+  Rcpp::NumericVector users(n);
+  ChangesetGroupColumns columns(n);
+  for(int i = 0; i < n; ++i) {
+    hashtag[i] = hashtags[i].first;
+    users[i] = hashtags[i].second->users.size();
+    columns.set(i, *hashtags[i].second);
+  }
+  return Rcpp::DataFrame::create(Rcpp::Named("hashtag") = hashtag, Rcpp::Named("users") = users,
+                                 Rcpp::Named("changesets") = columns.changesets, Rcpp::Named("changes") = columns.changes,
+                                 Rcpp::Named("comments") = columns.comments, Rcpp::Named("first") = columns.first,
+                                 Rcpp::Named("last") = columns.last, Rcpp::Named("min_lon") = columns.min_lon,
+                                 Rcpp::Named("min_lat") = columns.min_lat, Rcpp::Named("max_lon") = columns.max_lon,
+                                 Rcpp::Named("max_lat") = columns.max_lat, Rcpp::Named("stringsAsFactors") = false);
+}
+
+// The changesets intersecting the bounding box of the handler
+Rcpp::DataFrame changeset_selected(ChangesetHandler* handler) {
+  const std::vector<ChangesetRecord>& records = handler->selected();
+  const int n = static_cast<int>(records.size());
+  Rcpp::NumericVector id(n), uid(n), created_at(n), closed_at(n), changes(n), min_lon(n), min_lat(n), max_lon(n), max_lat(n);
+  Rcpp::CharacterVector user(n), comment(n);
+  for(int i = 0; i < n; ++i) {
+    const ChangesetRecord& record = records[i];
+    id[i] = record.id;
+    uid[i] = record.uid;
+    user[i] = record.user;
+    created_at[i] = record.created_at.valid() ? record.created_at.seconds_since_epoch() : NA_REAL;
+    closed_at[i] = record.closed_at.valid() ? record.closed_at.seconds_since_epoch() : NA_REAL;
+    changes[i] = record.changes;
+    min_lon[i] = record.bounds.bottom_left().lon();
+    min_lat[i] = record.bounds.bottom_left().lat();
+    max_lon[i] = record.bounds.top_right().lon();
+    max_lat[i] = record.bounds.top_right().lat();
+    comment[i] = record.comment;
+  }
+  return Rcpp::DataFrame::create(Rcpp::Named("id") = id, Rcpp::Named("uid") = uid, Rcpp::Named("user") = user,
+                                 Rcpp::Named("created_at") = created_at, Rcpp::Named("closed_at") = closed_at,
+                                 Rcpp::Named("changes") = changes, Rcpp::Named("min_lon") = min_lon,
+                                 Rcpp::Named("min_lat") = min_lat, Rcpp::Named("max_lon") = max_lon,
+                                 Rcpp::Named("max_lat") = max_lat, Rcpp::Named("comment") = comment,
+                                 Rcpp::Named("stringsAsFactors") = false);
+}
+
 void set_lon(osmium::Location* loc, double lon) {
  loc->set_lon(lon);
 }
@@ -365,29 +894,152 @@ class OSMReader {
 private:
   std::string mFilename;
   osmium::osm_entity_bits::type mEntities;
+  MemoryTracker mMemory;
+  int mThreads = 0;
+  bool mOrderedAreas = true;
+  bool mSpillMembers = false;
+  TimeFilter mTimeFilter;
+  // Ranges of the blobs decoded by osm_get() so far
+  std::shared_ptr<BlobIndex> mBlobIndex;
+ 
+  // Same as osmium::apply() on the reader, but checks the memory budget after every buffer
+  template <typename... THandlers>
+  void apply_tracked(osmium::io::Reader &r, THandlers&... handlers) {
+    while(osmium::memory::Buffer buffer = r.read()) {
+      osmium::apply(buffer, handlers...);
+      mMemory.check();
+    }
+  }
  
-// TODO: create index from string 
-  std::unique_ptr<index_type> createIndex(const std::string& idx) {
-    if(idx == "sparse_mem_array") return std::unique_ptr<index_type>(new sparse_mem_array());
+  // Runs copies of the handlers as one static chain in parallel and copies the results back
+  template <typename THandler1, typename THandler2>
+  void apply_merged(osmium::io::Reader &r, THandler1& handler1, THandler2& handler2) {
+    MergeableChain<THandler1, THandler2> chain(handler1, handler2);
+    parallel_apply(r, chain, mThreads);
+    handler1 = chain.template get<0>();
+    handler2 = chain.template get<1>();
+  }
+  
+  template <typename THandler1, typename THandler2, typename THandler3>
+  void apply_merged(osmium::io::Reader &r, THandler1& handler1, THandler2& handler2, THandler3& handler3) {
+    MergeableChain<THandler1, THandler2, THandler3> chain(handler1, handler2, handler3);
+    parallel_apply(r, chain, mThreads);
+    handler1 = chain.template get<0>();
+    handler2 = chain.template get<1>();
+    handler3 = chain.template get<2>();
   }
  
   void apply_with_location(RHandler& handler, osmium::io::Reader &r, const std::string &idx) {
-    std::unique_ptr<index_type> index = std::unique_ptr<index_type>(new sparse_mem_array());
-    osmium::handler::NodeLocationsForWays<index_type> location_handler(*index);
+    LocationIndex index(idx);
+    TrackedComponent tracked_index(mMemory, "location_index", [&index]() { return index.residentMemory(); },
+                                   [&index]() { return index.spillToFile(); });
+    osmium::handler::NodeLocationsForWays<index_type> location_handler(index);
     location_handler.ignore_errors();
-    osmium::apply(r, location_handler, handler);
+    apply_tracked(r, location_handler, handler);
   }
    
+  // Native handlers run on one thread on the versions selected by the time filter
+  template <typename THandler>
+  void apply_native(THandler& handler, osmium::osm_entity_bits::type entities) {
+    osmium::io::Reader reader(mFilename, entities);
+    if(mTimeFilter.active()) {
+      applyHistory(reader, mTimeFilter, [&handler](const osmium::DiffObject& diff) {
+        osmium::apply_item(diff.curr(), handler);
+      });
+    } else {
+      parallel_apply(reader, handler, mThreads);
+    }
+    reader.close();
+  }
+
+  template <typename THandler>
+  Rcpp::NumericVector run_checkpointed(THandler& handler, const std::string& kind, osmium::osm_entity_bits::type entities,
+                                       const std::string& checkpoint, double interval) {
+    CheckpointProgress progress;
+    try {
+      Checkpoint file(checkpoint, mFilename, kind, entities);
+      progress = checkpointedApply(mFilename, entities, handler, file, interval, [this]() {
+        mMemory.check();
+        Rcpp::checkUserInterrupt();
+      });
+    } catch(MemoryBudgetExceeded& e) {
+      Rcpp::stop(e.what());
+    } catch(std::exception& e) {
+      Rcpp::stop(e.what());
+    }
+    return Rcpp::NumericVector::create(Rcpp::Named("resumed_from") = static_cast<double>(progress.resumed_from),
+                                       Rcpp::Named("blobs") = static_cast<double>(progress.blobs),
+                                       Rcpp::Named("checkpoints") = static_cast<double>(progress.checkpoints));
+  }
+
+  void apply_history(RHandler& handler, bool with_locations, const std::string &idx) {
+    if(handler.needsMultipolygons()) {
+      Rcpp::stop("Areas of multipolygon relations can not be built with a time filter, use area_mode = \"ways\"");
+    }
+    osmium::osm_entity_bits::type entities = mEntities;
+    if(handler.hasAreaCallback()) {
+      entities = entities | osmium::osm_entity_bits::node | osmium::osm_entity_bits::way;
+    }
+    osmium::io::Reader reader(mFilename, entities);
+    size_t objects = 0;
+    if((with_locations || handler.hasAreaCallback()) && mTimeFilter.mode() == TimeFilter::Mode::range) {
+      // Node versions are kept by time, the location index holds only one location per node
+      HistoryLocations locations(mTimeFilter.from());
+      TrackedComponent tracked_locations(mMemory, "history_locations", [&locations]() { return locations.usedMemory(); });
+      applyHistory(reader, mTimeFilter, [this, &handler, &locations, &objects](const osmium::DiffObject& diff) {
+        handler.setHistory(diff);
+        osmium::OSMObject& object = currentVersion(diff);
+        locations.update(object);
+        osmium::apply_item(object, handler);
+        checkMemoryEvery(++objects);
+      });
+    } else if(with_locations || handler.hasAreaCallback()) {
+      LocationIndex index(idx);
+      TrackedComponent tracked_index(mMemory, "location_index", [&index]() { return index.residentMemory(); },
+                                     [&index]() { return index.spillToFile(); });
+      osmium::handler::NodeLocationsForWays<index_type> location_handler(index);
+      location_handler.ignore_errors();
+      applyHistory(reader, mTimeFilter, [this, &handler, &location_handler, &objects](const osmium::DiffObject& diff) {
+        handler.setHistory(diff);
+        osmium::apply_item(currentVersion(diff), location_handler, handler);
+        checkMemoryEvery(++objects);
+      });
+    } else {
+      applyHistory(reader, mTimeFilter, [this, &handler, &objects](const osmium::DiffObject& diff) {
+        handler.setHistory(diff);
+        osmium::apply_item(diff.curr(), handler);
+        checkMemoryEvery(++objects);
+      });
+    }
+    reader.close();
+  }
+  
+  // The history is streamed object by object, so the budget is checked about as often as for a buffer
+  void checkMemoryEvery(size_t objects) {
+    if(objects % 10000 == 0) {
+      mMemory.check();
+    }
+  }
+  
+  void checkNoTimeFilter(const char* function) {
+    if(mTimeFilter.active()) {
+      Rcpp::stop(std::string(function) + " does not support a time filter, call clearTimeFilter() on the reader first");
+    }
+  }
+  
   void apply_with_area(RHandler& handler, osmium::io::Reader &r,
-                       osmium::area::MultipolygonCollector<osmium::area::Assembler> &collector,
+                       ParallelMultipolygonCollector<osmium::area::Assembler> &collector,
                        const std::string &idx) {
-    std::unique_ptr<index_type> index = std::unique_ptr<index_type>(new sparse_mem_array());
-    osmium::handler::NodeLocationsForWays<index_type> location_handler(*index);
+    LocationIndex index(idx);
+    TrackedComponent tracked_index(mMemory, "location_index", [&index]() { return index.residentMemory(); },
+                                   [&index]() { return index.spillToFile(); });
+    osmium::handler::NodeLocationsForWays<index_type> location_handler(index);
     location_handler.ignore_errors();
-    osmium::apply(r, location_handler, handler,
-                  collector.handler([&handler](const osmium::memory::Buffer& area_buffer) {
-                    osmium::apply(area_buffer, handler);
-                  }));
+    auto& area_handler = collector.handler([&handler](const osmium::memory::Buffer& area_buffer) {
+      osmium::apply(area_buffer, handler);
+    });
+    apply_tracked(r, location_handler, handler, area_handler);
+    collector.finish();
   } 
   
 public:
@@ -400,63 +1052,299 @@ public:
     return mFilename;
   }
   
+  int getThreads() {
+    return mThreads;
+  }
+  
+  void setThreads(int threads) {
+    if(threads < 0) {
+      Rcpp::stop("threads has to be 0 (one per core) or a positive number");
+    }
+    mThreads = threads;
+  }
+  
+  bool getOrderedAreas() {
+    return mOrderedAreas;
+  }
+  
+  void setOrderedAreas(bool ordered) {
+    mOrderedAreas = ordered;
+  }
+  
+  bool getSpillMembers() {
+    return mSpillMembers;
+  }
+  
+  void setSpillMembers(bool spill) {
+    mSpillMembers = spill;
+  }
+  
+  // Reads only the versions of a history file visible at the given time
+  void setSnapshot(std::string timestamp) {
+    mTimeFilter = TimeFilter::snapshot(timestamp);
+  }
+  
+  // Reads all versions of a history file valid at some time in [from, to)
+  void setTimeRange(std::string from, std::string to) {
+    mTimeFilter = TimeFilter::range(from, to);
+  }
+  
+  void clearTimeFilter() {
+    mTimeFilter = TimeFilter();
+  }
+  
   void apply(CountHandler& handler) {
+    apply_native(handler, mEntities);
+  }
+  
+  void apply_stats(StatsHandler& handler) {
+    apply_native(handler, mEntities);
+  }
+  
+  void apply_tiles(TileHandler& handler) {
+    apply_native(handler, mEntities & osmium::osm_entity_bits::node);
+  }
+  
+  void apply_changesets(ChangesetHandler& handler) {
+    checkNoTimeFilter("applyChangesets");
+    apply_native(handler, osmium::osm_entity_bits::changeset);
+  }
+
+  /**
+   * Runs a CountHandler, StatsHandler or TileHandler with checkpoints (see
+   * checkpointedApply()), so an interrupted scan of a PBF file continues
+   * where the last checkpoint was written.
+   */
+  Rcpp::NumericVector apply_checkpointed(SEXP handler, std::string checkpoint, double interval) {
+    checkNoTimeFilter("osm_apply_checkpointed");
+    if(Rf_inherits(handler, "Rcpp_CountHandler")) {
+      return run_checkpointed(*Rcpp::as<CountHandler*>(handler), "CountHandler", mEntities, checkpoint, interval);
+    } else if(Rf_inherits(handler, "Rcpp_StatsHandler")) {
+      return run_checkpointed(*Rcpp::as<StatsHandler*>(handler), "StatsHandler", mEntities, checkpoint, interval);
+    } else if(Rf_inherits(handler, "Rcpp_TileHandler")) {
+      return run_checkpointed(*Rcpp::as<TileHandler*>(handler), "TileHandler",
+                              mEntities & osmium::osm_entity_bits::node, checkpoint, interval);
+    }
+    Rcpp::stop("Checkpoints are supported for CountHandler, StatsHandler and TileHandler");
+  }
+
+  void apply_r(RHandler& handler, bool with_locations = false, std::string idx = "sparse_mem_array") {
+    TrackedComponent tracked_results(mMemory, "r_results", [&handler]() { return handler.resultSize(); });
+    try {
+      if(mTimeFilter.active()) {
+        apply_history(handler, with_locations, idx);
+      } else if(handler.needsMultipolygons()) {
+        osmium::area::Assembler::config_type assembler_config;
+        ParallelMultipolygonCollector<osmium::area::Assembler> collector(assembler_config, mOrderedAreas);
+        TrackedComponent tracked_collector(mMemory, "multipolygon_collector", [&collector]() { return collector.used_memory(); },
+                                           [&collector]() { return collector.startSpill(); });
+        osmium::io::Reader reader1(mFilename);
+        collector.read_relations(reader1);
+        reader1.close();
+        if(mSpillMembers) {
+          collector.startSpill();
+        }
+        mMemory.check();
+        osmium::io::Reader reader2(mFilename);
+        apply_with_area(handler, reader2, collector, idx);
+        reader2.close();
+      } else if(with_locations || handler.hasAreaCallback()) {
+        osmium::osm_entity_bits::type entities = mEntities;
+        if(handler.hasAreaCallback()) {
+          entities = entities | osmium::osm_entity_bits::node | osmium::osm_entity_bits::way;
+        }
+        osmium::io::Reader reader(mFilename, entities);
+        apply_with_location(handler, reader, idx);
+        reader.close();
+      } else {
+        osmium::io::Reader reader(mFilename, mEntities);
+        apply_tracked(reader, handler);
+        reader.close();
+      }
+    } catch(MemoryBudgetExceeded& e) {
+      Rcpp::stop(e.what());
+    }
+  }
+  
+  /**
+   * Runs several native handlers in one pass over the file. Combinations of
+   * the aggregating handlers are pre-instantiated as static chains and run
+   * in parallel, combinations with a WriteHandler are static chains on one
+   * thread. Everything else (e.g. the same handler type twice or handlers
+   * compiled by the user) falls back to a dynamic chain.
+   */
+  std::string apply_chain(Rcpp::List handlers) {
+    checkNoTimeFilter("applyChain");
+    CountHandler* count = nullptr;
+    StatsHandler* stats = nullptr;
+    TileHandler* tiles = nullptr;
+    WriteHandler* writer = nullptr;
+    // User-compiled handlers only run in the dynamic chain
+    std::vector<std::unique_ptr<NativeHandlerAdapter> > natives;
+    DynamicChain dynamic;
+    bool duplicates = false;
+    for(int i = 0; i < handlers.size(); ++i) {
+      SEXP handler = handlers[i];
+      if(Rf_inherits(handler, "Rcpp_CountHandler")) {
+        duplicates = duplicates || count != nullptr;
+        count = Rcpp::as<CountHandler*>(handler);
+        dynamic.add(*count);
+      } else if(Rf_inherits(handler, "Rcpp_StatsHandler")) {
+        duplicates = duplicates || stats != nullptr;
+        stats = Rcpp::as<StatsHandler*>(handler);
+        dynamic.add(*stats);
+      } else if(Rf_inherits(handler, "Rcpp_TileHandler")) {
+        duplicates = duplicates || tiles != nullptr;
+        tiles = Rcpp::as<TileHandler*>(handler);
+        dynamic.add(*tiles);
+      } else if(Rf_inherits(handler, "Rcpp_WriteHandler")) {
+        duplicates = duplicates || writer != nullptr;
+        writer = Rcpp::as<WriteHandler*>(handler);
+        dynamic.add(*writer);
+      } else if(isNativeHandler(handler)) {
+        try {
+          natives.emplace_back(new NativeHandlerAdapter(handler));
+        } catch(std::exception& e) {
+          Rcpp::stop(e.what());
+        }
+        dynamic.add(*natives.back());
+      } else {
+        Rcpp::stop("Only native handlers (CountHandler, StatsHandler, TileHandler, WriteHandler, rosmium::make_handler()) can be chained");
+      }
+    }
+    if(dynamic.size() == 0) {
+      return "none";
+    }
+    
     osmium::io::Reader reader(mFilename, mEntities);
-    osmium::apply(reader, handler);
+    std::string chain = "dynamic";
+    if(writer != nullptr) {
+      writer->init();
+    }
+    try {
+      if(duplicates || !natives.empty()) {
+        apply_tracked(reader, dynamic);
+      } else if(writer == nullptr) {
+        chain = "parallel";
+        if(count && stats && tiles) {
+          apply_merged(reader, *count, *stats, *tiles);
+        } else if(count && stats) {
+          apply_merged(reader, *count, *stats);
+        } else if(count && tiles) {
+          apply_merged(reader, *count, *tiles);
+        } else if(stats && tiles) {
+          apply_merged(reader, *stats, *tiles);
+        } else if(count) {
+          parallel_apply(reader, *count, mThreads);
+        } else if(stats) {
+          parallel_apply(reader, *stats, mThreads);
+        } else {
+          parallel_apply(reader, *tiles, mThreads);
+        }
+      } else {
+        chain = "static";
+        if(count && stats && !tiles) {
+          apply_tracked(reader, *count, *stats, *writer);
+        } else if(count && !stats && !tiles) {
+          apply_tracked(reader, *count, *writer);
+        } else if(stats && !count && !tiles) {
+          apply_tracked(reader, *stats, *writer);
+        } else if(!count && !stats && !tiles) {
+          apply_tracked(reader, *writer);
+        } else {
+          chain = "dynamic";
+          apply_tracked(reader, dynamic);
+        }
+      }
+    } catch(MemoryBudgetExceeded& e) {
+      if(writer != nullptr) {
+        writer->close();
+      }
+      Rcpp::stop(e.what());
+    }
     reader.close();
+    if(writer != nullptr) {
+      writer->close();
+    }
+    return chain;
   }
   
-  void apply_r(RHandler& handler, bool with_locations = false, std::string idx = "sparse_mem_array") {
-    if(handler.hasAreaCallback()) {
-      osmium::area::Assembler::config_type assembler_config;
-      osmium::area::MultipolygonCollector<osmium::area::Assembler> collector(assembler_config);
-      osmium::io::Reader reader1(mFilename);
-      collector.read_relations(reader1);
-      reader1.close();
-      osmium::io::Reader reader2(mFilename);
-      apply_with_area(handler, reader2, collector, idx);
-      reader2.close();
-    } else if(with_locations) {
-      osmium::io::Reader reader(mFilename, mEntities);
-      apply_with_location(handler, reader, idx);
-      reader.close();
-    } else {
+  // Runs a handler of rosmium::make_handler() on one thread, with node locations for the ways if requested
+  void apply_native_handler(SEXP handler, bool with_locations, std::string idx) {
+    checkNoTimeFilter("osm_apply_native");
+    std::unique_ptr<NativeHandlerAdapter> native;
+    try {
+      native.reset(new NativeHandlerAdapter(handler));
+    } catch(std::exception& e) {
+      Rcpp::stop(e.what());
+    }
+    try {
       osmium::io::Reader reader(mFilename, mEntities);
-      osmium::apply(reader, handler);
+      if(with_locations) {
+        LocationIndex index(idx);
+        TrackedComponent tracked_index(mMemory, "location_index", [&index]() { return index.residentMemory(); },
+                                       [&index]() { return index.spillToFile(); });
+        osmium::handler::NodeLocationsForWays<index_type> location_handler(index);
+        location_handler.ignore_errors();
+        apply_tracked(reader, location_handler, *native);
+      } else {
+        apply_tracked(reader, *native);
+      }
       reader.close();
+    } catch(MemoryBudgetExceeded& e) {
+      Rcpp::stop(e.what());
     }
   }
   
   void apply_writer(WriteHandler& handler, bool include_refs) {
+    if(include_refs) {
+      // The referenced objects are collected over all versions in the file
+      checkNoTimeFilter("apply_writer with include_refs");
+    }
     osmium::io::Reader reader(mFilename, mEntities);
     handler.init();
-    if(include_refs) {
-      WriteHelper wh(handler); 
-      if(mEntities & osmium::osm_entity_bits::relation) {
-        osmium::osm_entity_bits::type pre_pass = osmium::osm_entity_bits::nwr;
-        if(!wh.requiresAllEntities()) {
-          pre_pass = osmium::osm_entity_bits::relation;
-        } 
-        do {
-          osmium::io::Reader relReader(mFilename, pre_pass); 
-          osmium::apply(relReader, wh);
-          relReader.close(); 
-        } while(wh.anyRelationsToDo());
+    TrackedComponent tracked_ids(mMemory, "write_ids", [&handler]() { return handler.usedMemory(); });
+    try {
+      if(include_refs) {
+        WriteHelper wh(handler); 
+        TrackedComponent tracked_todo(mMemory, "write_pending_refs", [&wh]() { return wh.usedMemory(); });
+        if(mEntities & osmium::osm_entity_bits::relation) {
+          osmium::osm_entity_bits::type pre_pass = osmium::osm_entity_bits::nwr;
+          if(!wh.requiresAllEntities()) {
+            pre_pass = osmium::osm_entity_bits::relation;
+          } 
+          do {
+            osmium::io::Reader relReader(mFilename, pre_pass); 
+            apply_tracked(relReader, wh);
+            relReader.close(); 
+          } while(wh.anyRelationsToDo());
+        }
+        if(mEntities & osmium::osm_entity_bits::way) {
+          osmium::osm_entity_bits::type pre_pass = osmium::osm_entity_bits::nwr;
+          if(!wh.requiresAllEntities()) {
+            pre_pass = osmium::osm_entity_bits::way;
+          } 
+          do {
+            osmium::io::Reader wayReader(mFilename, pre_pass); 
+            apply_tracked(wayReader, wh);
+            wayReader.close(); 
+          } while(wh.anyWaysToDo());
+        }   
+        wh.clearFilter();
       }
-      if(mEntities & osmium::osm_entity_bits::way) {
-        osmium::osm_entity_bits::type pre_pass = osmium::osm_entity_bits::nwr;
-        if(!wh.requiresAllEntities()) {
-          pre_pass = osmium::osm_entity_bits::way;
-        } 
-        do {
-          osmium::io::Reader wayReader(mFilename, pre_pass); 
-          osmium::apply(wayReader, wh);
-          wayReader.close(); 
-        } while(wh.anyWaysToDo());
-      }   
-      wh.clearFilter();
-    }
-    osmium::apply(reader, handler);
+      if(mTimeFilter.active()) {
+        size_t objects = 0;
+        applyHistory(reader, mTimeFilter, [this, &handler, &objects](const osmium::DiffObject& diff) {
+          osmium::apply_item(diff.curr(), handler);
+          checkMemoryEvery(++objects);
+        });
+      } else {
+        apply_tracked(reader, handler);
+      }
+    } catch(MemoryBudgetExceeded& e) {
+      handler.close();
+      Rcpp::stop(e.what());
+    }
     try {
       handler.close();
     } catch(std::exception e) {
@@ -465,8 +1353,701 @@ public:
     reader.close();
   }
   
+  /**
+   * Assembles the lines of all route and superroute relations (see
+   * RouteCollector) and returns them with the stitching diagnostics.
+   */
+  Rcpp::DataFrame routes(std::string idx = "sparse_mem_array") {
+    checkNoTimeFilter("osm_routes");
+    RouteCollector collector;
+    TrackedComponent tracked_collector(mMemory, "route_collector", [&collector]() { return collector.used_memory(); });
+    try {
+      osmium::io::Reader reader1(mFilename, osmium::osm_entity_bits::relation);
+      collector.read_relations(reader1);
+      reader1.close();
+      mMemory.check();
+      osmium::io::Reader reader2(mFilename, osmium::osm_entity_bits::node | osmium::osm_entity_bits::way);
+      LocationIndex index(idx);
+      TrackedComponent tracked_index(mMemory, "location_index", [&index]() { return index.residentMemory(); },
+                                     [&index]() { return index.spillToFile(); });
+      osmium::handler::NodeLocationsForWays<index_type> location_handler(index);
+      location_handler.ignore_errors();
+      apply_tracked(reader2, location_handler, collector.handler());
+      reader2.close();
+      collector.finish();
+    } catch(MemoryBudgetExceeded& e) {
+      Rcpp::stop(e.what());
+    }
+
+    const std::vector<RouteResult>& results = collector.results();
+    const int n = static_cast<int>(results.size());
+    Rcpp::NumericVector id(n), length(n);
+    Rcpp::CharacterVector type(n), route(n), name(n), ref(n), geom(n);
+    Rcpp::IntegerVector members(n), ways(n), missing(n), invalid(n), ignored(n), segments(n), gaps(n), reversed(n);
+    for(int i = 0; i < n; ++i) {
+      const RouteResult& result = results[i];
+      id[i] = result.id;
+      type[i] = result.superroute ? "superroute" : "route";
+      route[i] = result.route;
+      name[i] = result.name;
+      ref[i] = result.ref;
+      if(result.wkb.empty()) {
+        geom[i] = NA_STRING;
+      } else {
+        geom[i] = result.wkb;
+      }
+      members[i] = result.members;
+      ways[i] = result.ways;
+      missing[i] = result.missing_ways;
+      invalid[i] = result.invalid_ways;
+      ignored[i] = result.ignored_members;
+      segments[i] = result.segments;
+      gaps[i] = result.gaps;
+      reversed[i] = result.reversed;
+      length[i] = result.length;
+    }
+    return Rcpp::DataFrame::create(Rcpp::Named("id") = id, Rcpp::Named("type") = type, Rcpp::Named("route") = route,
+                                   Rcpp::Named("name") = name, Rcpp::Named("ref") = ref, Rcpp::Named("geom") = geom,
+                                   Rcpp::Named("length") = length, Rcpp::Named("members") = members,
+                                   Rcpp::Named("ways") = ways, Rcpp::Named("missing_ways") = missing,
+                                   Rcpp::Named("invalid_ways") = invalid, Rcpp::Named("ignored_members") = ignored,
+                                   Rcpp::Named("segments") = segments, Rcpp::Named("gaps") = gaps,
+                                   Rcpp::Named("reversed") = reversed, Rcpp::Named("stringsAsFactors") = false);
+  }
+  
+  /**
+   * Assembles all areas without passing them to R and returns the problems
+   * reported by the assembler, a summary and the timings of every
+   * multipolygon relation (slowest first).
+   */
+  Rcpp::List area_stats(std::string idx = "sparse_mem_array") {
+    checkNoTimeFilter("osm_area_stats");
+    osmium::area::Assembler::config_type assembler_config;
+    ParallelMultipolygonCollector<osmium::area::Assembler> collector(assembler_config, false);
+    collector.collectStats();
+    uint64_t areas = 0;
+    auto start = std::chrono::steady_clock::now();
+    try {
+      TrackedComponent tracked_collector(mMemory, "multipolygon_collector", [&collector]() { return collector.used_memory(); },
+                                         [&collector]() { return collector.startSpill(); });
+      osmium::io::Reader reader1(mFilename, osmium::osm_entity_bits::relation);
+      collector.read_relations(reader1);
+      reader1.close();
+      if(mSpillMembers) {
+        collector.startSpill();
+      }
+      mMemory.check();
+      osmium::io::Reader reader2(mFilename, osmium::osm_entity_bits::node | osmium::osm_entity_bits::way);
+      LocationIndex index(idx);
+      TrackedComponent tracked_index(mMemory, "location_index", [&index]() { return index.residentMemory(); },
+                                     [&index]() { return index.spillToFile(); });
+      osmium::handler::NodeLocationsForWays<index_type> location_handler(index);
+      location_handler.ignore_errors();
+      auto& area_handler = collector.handler([&areas](osmium::memory::Buffer&& area_buffer) {
+        areas += std::distance(area_buffer.cbegin<osmium::Area>(), area_buffer.cend<osmium::Area>());
+      });
+      apply_tracked(reader2, location_handler, area_handler);
+      reader2.close();
+      collector.finish();
+    } catch(MemoryBudgetExceeded& e) {
+      Rcpp::stop(e.what());
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    AreaAssemblyStats& stats = collector.stats();
+    stats.sortByTime();
+    const AreaProblemCounts& counts = stats.problems;
+    Rcpp::NumericVector problems = Rcpp::NumericVector::create(
+      Rcpp::Named("open_rings") = static_cast<double>(counts.open_rings),
+      Rcpp::Named("intersections") = static_cast<double>(counts.intersections),
+      Rcpp::Named("duplicate_segments") = static_cast<double>(counts.duplicate_segments),
+      Rcpp::Named("duplicate_nodes") = static_cast<double>(counts.duplicate_nodes),
+      Rcpp::Named("role_should_be_outer") = static_cast<double>(counts.role_should_be_outer),
+      Rcpp::Named("role_should_be_inner") = static_cast<double>(counts.role_should_be_inner));
+
+    const int n = static_cast<int>(stats.relations.size());
+    Rcpp::NumericVector id(n), total(n), extract(n), rings(n), build(n);
+    Rcpp::IntegerVector members(n), segments(n), relation_problems(n);
+    Rcpp::LogicalVector valid(n);
+    double relation_seconds = 0;
+    int valid_relations = 0;
+    for(int i = 0; i < n; ++i) {
+      const AreaAssemblyRecord& record = stats.relations[i];
+      id[i] = record.id;
+      members[i] = record.members;
+      segments[i] = record.segments;
+      total[i] = record.seconds();
+      extract[i] = record.extract_seconds;
+      rings[i] = record.rings_seconds;
+      build[i] = record.build_seconds;
+      relation_problems[i] = record.problems;
+      valid[i] = record.valid;
+      relation_seconds += record.seconds();
+      valid_relations += record.valid;
+    }
+    Rcpp::NumericVector summary = Rcpp::NumericVector::create(
+      Rcpp::Named("areas") = static_cast<double>(areas),
+      Rcpp::Named("relations") = n,
+      Rcpp::Named("valid_relations") = valid_relations,
+      Rcpp::Named("ways") = static_cast<double>(stats.ways),
+      Rcpp::Named("valid_ways") = static_cast<double>(stats.valid_ways),
+      Rcpp::Named("relation_seconds") = relation_seconds,
+      Rcpp::Named("way_seconds") = stats.way_seconds,
+      Rcpp::Named("seconds") = seconds);
+    Rcpp::DataFrame relations = Rcpp::DataFrame::create(
+      Rcpp::Named("id") = id, Rcpp::Named("members") = members, Rcpp::Named("segments") = segments,
+      Rcpp::Named("seconds") = total, Rcpp::Named("extract_seconds") = extract,
+      Rcpp::Named("rings_seconds") = rings, Rcpp::Named("build_seconds") = build,
+      Rcpp::Named("problems") = relation_problems, Rcpp::Named("valid") = valid);
+    return Rcpp::List::create(Rcpp::Named("problems") = problems, Rcpp::Named("summary") = summary,
+                              Rcpp::Named("relations") = relations);
+  }
+  
+  /**
+   * Writes the nodes, ways and areas selected by the filter as GeoJSON text
+   * sequence or CSV/TSV file, without creating R objects. Returns the number
+   * of features written, of objects skipped because of an invalid geometry
+   * and of bytes written (before compression).
+   */
+  Rcpp::NumericVector export_features(std::string output, std::string format, Rcpp::CharacterVector columns,
+                                      SEXP filter, unsigned char types, bool way_areas, std::string idx,
+                                      bool overwrite) {
+    checkNoTimeFilter("osm_export");
+    ExportOptions options;
+    std::shared_ptr<tagfilter::Command> command;
+    if(!Rf_isNull(filter)) {
+      command = Rcpp::as<ObjectFilter*>(filter)->getCommand();
+    }
+    try {
+      options.format = ExportOptions::parseFormat(format);
+      options.columns = Rcpp::as<std::vector<std::string> >(columns);
+      options.types = (osmium::osm_entity_bits::type) types;
+      options.way_areas = way_areas;
+      FeatureExporter exporter(output, options, command, overwrite);
+      const bool multipolygons = (options.types & osmium::osm_entity_bits::area) && !way_areas;
+      osmium::area::Assembler::config_type assembler_config;
+      ParallelMultipolygonCollector<osmium::area::Assembler> collector(assembler_config, mOrderedAreas);
+      TrackedComponent tracked_collector(mMemory, "multipolygon_collector", [&collector]() { return collector.used_memory(); },
+                                         [&collector]() { return collector.startSpill(); });
+      if(multipolygons) {
+        osmium::io::Reader reader1(mFilename, osmium::osm_entity_bits::relation);
+        collector.read_relations(reader1);
+        reader1.close();
+        if(mSpillMembers) {
+          collector.startSpill();
+        }
+        mMemory.check();
+      }
+      osmium::io::Reader reader2(mFilename, osmium::osm_entity_bits::node | osmium::osm_entity_bits::way);
+      LocationIndex index(idx);
+      TrackedComponent tracked_index(mMemory, "location_index", [&index]() { return index.residentMemory(); },
+                                     [&index]() { return index.spillToFile(); });
+      osmium::handler::NodeLocationsForWays<index_type> location_handler(index);
+      location_handler.ignore_errors();
+      auto& area_handler = collector.handler([&exporter](osmium::memory::Buffer&& area_buffer) {
+        exporter.add(std::move(area_buffer));
+      });
+      while(osmium::memory::Buffer buffer = reader2.read()) {
+        if(multipolygons) {
+          osmium::apply(buffer, location_handler, area_handler);
+        } else {
+          osmium::apply(buffer, location_handler);
+        }
+        exporter.add(std::move(buffer));
+        mMemory.check();
+      }
+      reader2.close();
+      if(multipolygons) {
+        collector.finish();
+      }
+      exporter.close();
+      return Rcpp::NumericVector::create(Rcpp::Named("features") = static_cast<double>(exporter.features),
+                                         Rcpp::Named("invalid_geometries") = static_cast<double>(exporter.invalid_geometries),
+                                         Rcpp::Named("bytes") = static_cast<double>(exporter.bytes));
+    } catch(MemoryBudgetExceeded& e) {
+      Rcpp::stop(e.what());
+    } catch(std::exception& e) {
+      Rcpp::stop(e.what());
+    }
+  }
+  
+  /**
+   * Splits the file into one output per file name with about the same number
+   * of nodes each (see SpatialPartitioner) and returns the cells with their
+   * boxes and the number of objects written.
+   */
+  Rcpp::DataFrame partition(Rcpp::CharacterVector files, bool duplicate, double sample, double seed,
+                            std::string idx, bool overwrite) {
+    checkNoTimeFilter("osm_partition");
+    const std::vector<std::string> filenames = Rcpp::as<std::vector<std::string> >(files);
+    std::unique_ptr<SpatialPartitioner> partitioner;
+    try {
+      osmium::osm_entity_bits::type entities = osmium::osm_entity_bits::node | osmium::osm_entity_bits::way;
+      if(mEntities & osmium::osm_entity_bits::relation) {
+        entities = entities | osmium::osm_entity_bits::relation;
+      }
+      LocationIndex index(idx);
+      TrackedComponent tracked_index(mMemory, "location_index", [&index]() { return index.residentMemory(); },
+                                     [&index]() { return index.spillToFile(); });
+      partitioner.reset(new SpatialPartitioner(index, static_cast<unsigned>(filenames.size()), duplicate,
+                                               static_cast<size_t>(sample), static_cast<uint64_t>(seed)));
+      SpatialPartitioner& p = *partitioner;
+      TrackedComponent tracked_partition(mMemory, "partition", [&p]() { return p.usedMemory(); });
+      osmium::io::Reader reader1(mFilename, entities);
+      apply_tracked(reader1, p);
+      reader1.close();
+      p.startWriting(filenames, mEntities, overwrite);
+      osmium::io::Reader reader2(mFilename, entities);
+      apply_tracked(reader2, p);
+      reader2.close();
+      p.close();
+    } catch(MemoryBudgetExceeded& e) {
+      Rcpp::stop(e.what());
+    } catch(std::exception& e) {
+      Rcpp::stop(e.what());
+    }
+
+    const int n = static_cast<int>(filenames.size());
+    Rcpp::NumericVector xmin(n), ymin(n), xmax(n), ymax(n), sampled(n), nodes(n), ways(n), relations(n);
+    for(int i = 0; i < n; ++i) {
+      const osmium::Box& box = partitioner->partition().box(static_cast<unsigned>(i));
+      xmin[i] = box.bottom_left().lon();
+      ymin[i] = box.bottom_left().lat();
+      xmax[i] = box.top_right().lon();
+      ymax[i] = box.top_right().lat();
+      sampled[i] = static_cast<double>(partitioner->sampleCounts()[i]);
+      const PartitionCounts& counts = partitioner->counts()[i];
+      nodes[i] = static_cast<double>(counts.nodes);
+      ways[i] = static_cast<double>(counts.ways);
+      relations[i] = static_cast<double>(counts.relations);
+    }
+    return Rcpp::DataFrame::create(Rcpp::Named("file") = files, Rcpp::Named("xmin") = xmin, Rcpp::Named("ymin") = ymin,
+                                   Rcpp::Named("xmax") = xmax, Rcpp::Named("ymax") = ymax,
+                                   Rcpp::Named("sampled") = sampled, Rcpp::Named("nodes") = nodes,
+                                   Rcpp::Named("ways") = ways, Rcpp::Named("relations") = relations,
+                                   Rcpp::Named("stringsAsFactors") = false);
+  }
+  
+  /**
+   * Reads the objects of one type with the given ids, decoding only the
+   * blobs which hold them (see BlobIndex). The ways get their geometry from
+   * the nodes they reference, which are fetched the same way. The result is
+   * columnar: one data frame for the objects, one for the tags and one for
+   * the members of relations.
+   */
+  Rcpp::List get_objects(Rcpp::NumericVector ids, std::string type, bool geometry) {
+    checkNoTimeFilter("osm_get");
+    osmium::item_type item;
+    if(type == "node") {
+      item = osmium::item_type::node;
+    } else if(type == "way") {
+      item = osmium::item_type::way;
+    } else if(type == "relation") {
+      item = osmium::item_type::relation;
+    } else {
+      Rcpp::stop("type has to be \"node\", \"way\" or \"relation\"");
+    }
+    std::vector<osmium::object_id_type> wanted;
+    wanted.reserve(ids.size());
+    for(int i = 0; i < ids.size(); ++i) {
+      // The conversion of NA, NaN, infinite or too large values is undefined
+      const double id = ids[i];
+      if(!(std::isfinite(id) && std::fabs(id) < 9.2e18)) {
+        Rcpp::stop("ids must be finite numbers");
+      }
+      wanted.push_back(static_cast<osmium::object_id_type>(id));
+    }
+    std::sort(wanted.begin(), wanted.end());
+    wanted.erase(std::unique(wanted.begin(), wanted.end()), wanted.end());
+
+    osmium::memory::Buffer objects(1024 * 1024, osmium::memory::Buffer::auto_grow::yes);
+    std::vector<std::pair<osmium::object_id_type, osmium::Location> > locations;
+    uint64_t decoded = 0;
+    try {
+      TrackedComponent tracked_objects(mMemory, "get_objects", [&objects, &locations]() {
+        return objects.capacity() + locations.capacity() * sizeof(locations[0]);
+      });
+      if(mBlobIndex == nullptr || !mBlobIndex->matches(mFilename)) {
+        mBlobIndex = std::make_shared<BlobIndex>(mFilename);
+      }
+      const uint64_t decoded_before = mBlobIndex->decoded;
+      mBlobIndex->fetch(item, wanted, [&objects](const osmium::OSMObject& object) {
+        objects.add_item(object);
+        objects.commit();
+      });
+      mMemory.check();
+      if(geometry && item == osmium::item_type::way) {
+        std::vector<osmium::object_id_type> refs;
+        for(auto it = objects.begin<osmium::Way>(); it != objects.end<osmium::Way>(); ++it) {
+          for(const osmium::NodeRef& node_ref : it->nodes()) {
+            refs.push_back(node_ref.ref());
+          }
+        }
+        std::sort(refs.begin(), refs.end());
+        refs.erase(std::unique(refs.begin(), refs.end()), refs.end());
+        mBlobIndex->fetch(osmium::item_type::node, refs, [&locations](const osmium::OSMObject& object) {
+          locations.emplace_back(object.id(), static_cast<const osmium::Node&>(object).location());
+        });
+        // Of several versions of a node, the last one counts
+        std::stable_sort(locations.begin(), locations.end(), [](const std::pair<osmium::object_id_type, osmium::Location>& a,
+                                                                const std::pair<osmium::object_id_type, osmium::Location>& b) {
+          return a.first < b.first;
+        });
+        for(auto it = objects.begin<osmium::Way>(); it != objects.end<osmium::Way>(); ++it) {
+          for(osmium::NodeRef& node_ref : it->nodes()) {
+            auto found = std::upper_bound(locations.begin(), locations.end(), std::make_pair(node_ref.ref(), osmium::Location()),
+                                          [](const std::pair<osmium::object_id_type, osmium::Location>& a,
+                                             const std::pair<osmium::object_id_type, osmium::Location>& b) {
+              return a.first < b.first;
+            });
+            if(found != locations.begin() && (found - 1)->first == node_ref.ref()) {
+              node_ref.set_location((found - 1)->second);
+            }
+          }
+        }
+        mMemory.check();
+      }
+      decoded = mBlobIndex->decoded - decoded_before;
+    } catch(MemoryBudgetExceeded& e) {
+      Rcpp::stop(e.what());
+    } catch(std::exception& e) {
+      Rcpp::stop(e.what());
+    }
+
+    std::vector<double> id, version, changeset, timestamp, uid;
+    std::vector<std::string> user;
+    std::vector<bool> visible;
+    Rcpp::CharacterVector geom;
+    std::vector<double> tag_id, member_id, member_ref;
+    std::vector<std::string> key, value, member_type, member_role;
+    std::vector<osmium::object_id_type> found;
+    osmium::geom::WKBFactory<> factory(osmium::geom::wkb_type::wkb, osmium::geom::out_type::hex);
+    for(auto it = objects.begin<osmium::OSMObject>(); it != objects.end<osmium::OSMObject>(); ++it) {
+      const osmium::OSMObject& object = *it;
+      found.push_back(object.id());
+      id.push_back(object.id());
+      version.push_back(object.version());
+      changeset.push_back(object.changeset());
+      timestamp.push_back(static_cast<double>(object.timestamp().seconds_since_epoch()));
+      uid.push_back(object.uid());
+      user.push_back(object.user());
+      visible.push_back(object.visible());
+      for(const osmium::Tag& tag : object.tags()) {
+        tag_id.push_back(object.id());
+        key.push_back(tag.key());
+        value.push_back(tag.value());
+      }
+      if(item == osmium::item_type::relation) {
+        for(const osmium::RelationMember& member : static_cast<const osmium::Relation&>(object).members()) {
+          member_id.push_back(object.id());
+          member_type.push_back(osmium::item_type_to_name(member.type()));
+          member_ref.push_back(member.ref());
+          member_role.push_back(member.role());
+        }
+      } else if(geometry) {
+        try {
+          if(item == osmium::item_type::node) {
+            geom.push_back(factory.create_point(static_cast<const osmium::Node&>(object)));
+          } else {
+            geom.push_back(factory.create_linestring(static_cast<const osmium::Way&>(object)));
+          }
+        } catch(std::exception&) {
+          // Missing nodes or fewer than two locations
+          geom.push_back(NA_STRING);
+        }
+      }
+    }
+    std::sort(found.begin(), found.end());
+    std::vector<double> missing;
+    for(osmium::object_id_type wanted_id : wanted) {
+      if(!std::binary_search(found.begin(), found.end(), wanted_id)) {
+        missing.push_back(wanted_id);
+      }
+    }
+
+    Rcpp::DataFrame object_frame = Rcpp::DataFrame::create(
+      Rcpp::Named("id") = id, Rcpp::Named("version") = version, Rcpp::Named("changeset") = changeset,
+      Rcpp::Named("timestamp") = timestamp, Rcpp::Named("uid") = uid, Rcpp::Named("user") = user,
+      Rcpp::Named("visible") = visible, Rcpp::Named("stringsAsFactors") = false);
+    if(geometry && item != osmium::item_type::relation) {
+      object_frame["geom"] = geom;
+    }
+    Rcpp::List result = Rcpp::List::create(
+      Rcpp::Named("objects") = object_frame,
+      Rcpp::Named("tags") = Rcpp::DataFrame::create(Rcpp::Named("id") = tag_id, Rcpp::Named("key") = key,
+                                                    Rcpp::Named("value") = value, Rcpp::Named("stringsAsFactors") = false));
+    if(item == osmium::item_type::relation) {
+      result["members"] = Rcpp::DataFrame::create(Rcpp::Named("id") = member_id, Rcpp::Named("type") = member_type,
+                                                  Rcpp::Named("ref") = member_ref, Rcpp::Named("role") = member_role,
+                                                  Rcpp::Named("stringsAsFactors") = false);
+    }
+    result["missing"] = missing;
+    result["blobs"] = Rcpp::NumericVector::create(Rcpp::Named("total") = static_cast<double>(mBlobIndex->blobs()),
+                                                  Rcpp::Named("indexed") = static_cast<double>(mBlobIndex->knownRanges()),
+                                                  Rcpp::Named("decoded") = static_cast<double>(decoded));
+    return result;
+  }
+  
+  void setMemoryBudget(double bytes, bool spill_indexes) {
+    mMemory.setBudget(bytes > 0 ? static_cast<size_t>(bytes) : 0, spill_indexes);
+  }
+  
+  Rcpp::DataFrame memoryUsage() {
+    std::vector<std::string> names;
+    std::vector<double> current;
+    std::vector<double> peak;
+    for(const MemoryComponent& component : mMemory.components()) {
+      names.push_back(component.name);
+      current.push_back(component.current);
+      peak.push_back(component.peak);
+    }
+    names.push_back("total");
+    current.push_back(mMemory.current());
+    peak.push_back(mMemory.peak());
+    return Rcpp::DataFrame::create(Rcpp::Named("component") = names, Rcpp::Named("current") = current,
+                                   Rcpp::Named("peak") = peak, Rcpp::Named("stringsAsFactors") = false);
+  }
+  
 };
 
+Rcpp::NumericVector generate_synthetic(std::string filename, double nodes, double seed, Rcpp::NumericVector bbox) {
+  if(bbox.size() != 4) {
+    Rcpp::stop("bbox has to contain min longitude, min latitude, max longitude and max latitude");
+  }
+  SyntheticGenerator generator(static_cast<uint64_t>(nodes), static_cast<uint64_t>(seed),
+                               osmium::Box(bbox[0], bbox[1], bbox[2], bbox[3]));
+  SyntheticCounts counts = generator.write(filename);
+  return Rcpp::NumericVector::create(Rcpp::Named("nodes") = counts.nodes, Rcpp::Named("ways") = counts.ways,
+                                     Rcpp::Named("relations") = counts.relations);
+}
+
+Rcpp::DataFrame benchmark_indexes(double nodes, Rcpp::CharacterVector maps, double lookups, double seed) {
+  std::vector<std::string> types = maps.size() > 0 ? Rcpp::as<std::vector<std::string> >(maps) : LocationIndex::types();
+  IndexBenchmark benchmark(static_cast<uint64_t>(nodes), static_cast<uint64_t>(lookups), static_cast<uint64_t>(seed));
+  Rcpp::CharacterVector map(types.size()), error(types.size());
+  Rcpp::NumericVector insert_seconds(types.size()), inserts_per_sec(types.size()), sort_seconds(types.size());
+  Rcpp::NumericVector sequential_lookup_ns(types.size()), random_lookup_ns(types.size());
+  Rcpp::NumericVector used_memory(types.size()), resident_memory(types.size());
+  for(size_t i = 0; i < types.size(); ++i) {
+    Rcpp::checkUserInterrupt();
+    IndexBenchmarkResult result = benchmark.run(types[i]);
+    map[i] = result.map;
+    insert_seconds[i] = result.insert_seconds;
+    inserts_per_sec[i] = result.insert_seconds > 0 ? result.nodes / result.insert_seconds : NA_REAL;
+    sort_seconds[i] = result.sort_seconds;
+    sequential_lookup_ns[i] = result.sequential_lookup_ns;
+    random_lookup_ns[i] = result.random_lookup_ns;
+    used_memory[i] = result.used_memory;
+    resident_memory[i] = result.resident_memory;
+    if(result.error.empty()) {
+      error[i] = NA_STRING;
+    } else {
+      error[i] = result.error;
+    }
+  }
+  return Rcpp::DataFrame::create(Rcpp::Named("map") = map, Rcpp::Named("nodes") = nodes,
+                                 Rcpp::Named("insert_seconds") = insert_seconds,
+                                 Rcpp::Named("inserts_per_sec") = inserts_per_sec,
+                                 Rcpp::Named("sort_seconds") = sort_seconds,
+                                 Rcpp::Named("sequential_lookup_ns") = sequential_lookup_ns,
+                                 Rcpp::Named("random_lookup_ns") = random_lookup_ns,
+                                 Rcpp::Named("used_memory") = used_memory,
+                                 Rcpp::Named("resident_memory") = resident_memory,
+                                 Rcpp::Named("error") = error,
+                                 Rcpp::Named("stringsAsFactors") = false);
+}
+
+Rcpp::DataFrame benchmark_geometry(std::string filename, Rcpp::CharacterVector formats, std::string idx) {
+  std::vector<std::string> names = Rcpp::as<std::vector<std::string> >(formats);
+  std::vector<GeometryBenchmarkResult> results;
+  try {
+    GeometryBenchmark benchmark(filename, idx);
+    for(const std::string& format : names) {
+      Rcpp::checkUserInterrupt();
+      std::vector<GeometryBenchmarkResult> runs = benchmark.run(format);
+      results.insert(results.end(), runs.begin(), runs.end());
+    }
+  } catch(std::exception& e) {
+    Rcpp::stop(e.what());
+  }
+  const int n = static_cast<int>(results.size());
+  Rcpp::CharacterVector format(n), output(n);
+  Rcpp::NumericVector geometries(n), seconds(n), per_sec(n), bytes(n), allocations(n);
+  for(int i = 0; i < n; ++i) {
+    format[i] = results[i].format;
+    output[i] = results[i].output;
+    geometries[i] = results[i].geometries;
+    seconds[i] = results[i].seconds;
+    per_sec[i] = results[i].seconds > 0 ? results[i].geometries / results[i].seconds : NA_REAL;
+    bytes[i] = results[i].bytes;
+    allocations[i] = results[i].allocations;
+  }
+  return Rcpp::DataFrame::create(Rcpp::Named("format") = format, Rcpp::Named("output") = output,
+                                 Rcpp::Named("geometries") = geometries, Rcpp::Named("seconds") = seconds,
+                                 Rcpp::Named("geometries_per_sec") = per_sec, Rcpp::Named("bytes") = bytes,
+                                 Rcpp::Named("allocations") = allocations,
+                                 Rcpp::Named("stringsAsFactors") = false);
+}
+
+Rcpp::DataFrame benchmark_varint(std::string filename, Rcpp::CharacterVector decoders, int rounds) {
+  std::vector<std::string> names = Rcpp::as<std::vector<std::string> >(decoders);
+  std::vector<VarintBenchmarkResult> results;
+  try {
+    VarintBenchmark benchmark(filename);
+    for(const std::string& name : names) {
+      osmium::io::detail::varint_decoder decoder;
+      if(name == "scalar") {
+        decoder = osmium::io::detail::varint_decoder::scalar;
+      } else if(name == "sse2") {
+        decoder = osmium::io::detail::varint_decoder::sse2;
+      } else if(name == "avx2") {
+        decoder = osmium::io::detail::varint_decoder::avx2;
+      } else {
+        throw std::invalid_argument("Unknown varint decoder: " + name);
+      }
+      Rcpp::checkUserInterrupt();
+      results.push_back(benchmark.fields(decoder, rounds));
+      results.push_back(benchmark.blocks(decoder, rounds));
+    }
+  } catch(std::exception& e) {
+    Rcpp::stop(e.what());
+  }
+  const int n = static_cast<int>(results.size());
+  Rcpp::CharacterVector decoder(n), stage(n);
+  Rcpp::LogicalVector supported(n), matches(n);
+  Rcpp::NumericVector values(n), bytes(n), seconds(n), values_per_sec(n), mb_per_sec(n);
+  for(int i = 0; i < n; ++i) {
+    const VarintBenchmarkResult& result = results[i];
+    decoder[i] = result.decoder;
+    stage[i] = result.stage;
+    supported[i] = result.supported;
+    values[i] = result.supported ? result.values : NA_REAL;
+    bytes[i] = result.supported ? result.bytes : NA_REAL;
+    seconds[i] = result.supported ? result.seconds : NA_REAL;
+    values_per_sec[i] = result.seconds > 0 ? result.values / result.seconds : NA_REAL;
+    mb_per_sec[i] = result.seconds > 0 ? result.bytes / result.seconds / (1024.0 * 1024.0) : NA_REAL;
+    matches[i] = result.supported ? result.matches : NA_LOGICAL;
+  }
+  return Rcpp::DataFrame::create(Rcpp::Named("decoder") = decoder, Rcpp::Named("stage") = stage,
+                                 Rcpp::Named("supported") = supported, Rcpp::Named("values") = values,
+                                 Rcpp::Named("bytes") = bytes, Rcpp::Named("seconds") = seconds,
+                                 Rcpp::Named("values_per_sec") = values_per_sec,
+                                 Rcpp::Named("mb_per_sec") = mb_per_sec, Rcpp::Named("matches") = matches,
+                                 Rcpp::Named("stringsAsFactors") = false);
+}
+
+/**
+ * Sets the read options used by all readers opened afterwards. They apply to
+ * uncompressed files read from disk, such as PBF files.
+ */
+void set_read_options(double read_size, bool advise, bool prefetch, std::string cache) {
+  // also rejects NA and NaN before the cast
+  if(!(read_size >= osmium::io::read_options::min_read_size && read_size <= osmium::io::read_options::max_read_size)) {
+    Rcpp::stop("Read size must be between 4 KiB and 1 GiB");
+  }
+  osmium::io::read_options options;
+  options.read_size = static_cast<size_t>(read_size);
+  options.advise = advise;
+  options.prefetch = prefetch;
+  if(cache == "keep") {
+    options.cache = osmium::io::read_cache::keep;
+  } else if(cache == "drop") {
+    options.cache = osmium::io::read_cache::drop;
+  } else if(cache == "direct") {
+    options.cache = osmium::io::read_cache::direct;
+  } else {
+    Rcpp::stop("Unknown cache mode: " + cache);
+  }
+  try {
+    osmium::io::set_default_read_options(options);
+  } catch(std::exception& e) {
+    Rcpp::stop(e.what());
+  }
+}
+
+Rcpp::List get_read_options() {
+  const osmium::io::read_options options = osmium::io::default_read_options();
+  return Rcpp::List::create(Rcpp::Named("read_size") = static_cast<double>(options.read_size),
+                            Rcpp::Named("advise") = options.advise,
+                            Rcpp::Named("prefetch") = options.prefetch,
+                            Rcpp::Named("cache") = osmium::io::read_cache_name(options.cache));
+}
+
+// The statistics of the read thread of the last reader which finished reading
+Rcpp::DataFrame get_read_statistics() {
+  const osmium::io::read_statistics stats = osmium::io::last_read_statistics();
+  return Rcpp::DataFrame::create(Rcpp::Named("bytes") = static_cast<double>(stats.bytes),
+                                 Rcpp::Named("reads") = static_cast<double>(stats.reads),
+                                 Rcpp::Named("read_seconds") = stats.read_seconds,
+                                 Rcpp::Named("seconds") = stats.seconds,
+                                 Rcpp::Named("read_mb_per_sec") = stats.read_mb_per_second(),
+                                 Rcpp::Named("mb_per_sec") = stats.mb_per_second(),
+                                 Rcpp::Named("cache") = osmium::io::read_cache_name(stats.cache),
+                                 Rcpp::Named("stringsAsFactors") = false);
+}
+
+/**
+ * Compares two sorted files by type and id. With an output file the changes
+ * are written as osmChange and only the counts are returned, otherwise the
+ * changed objects are returned as table.
+ */
+Rcpp::List diff_files(std::string old_filename, std::string new_filename, unsigned char entities,
+                      std::string output, bool compare_crc) {
+  std::vector<std::string> type;
+  std::vector<double> id, old_version, new_version;
+  std::vector<std::string> change;
+  Rcpp::NumericVector summary;
+  try {
+    SnapshotDiff diff(old_filename, new_filename, (osmium::osm_entity_bits::type) entities, compare_crc);
+    if(!output.empty()) {
+      ChangeFileWriter writer(output);
+      diff.run(std::ref(writer));
+      writer.close();
+    } else {
+      static const char* const change_names[] = {"create", "modify", "delete"};
+      diff.run([&](ChangeType kind, const osmium::OSMObject* old_object, const osmium::OSMObject* new_object) {
+        const osmium::OSMObject& object = new_object != nullptr ? *new_object : *old_object;
+        type.push_back(osmium::item_type_to_name(object.type()));
+        id.push_back(object.id());
+        change.push_back(change_names[static_cast<int>(kind)]);
+        old_version.push_back(old_object != nullptr ? old_object->version() : NA_REAL);
+        new_version.push_back(new_object != nullptr ? new_object->version() : NA_REAL);
+      });
+    }
+    diff.close();
+    summary = Rcpp::NumericVector::create(Rcpp::Named("unchanged") = static_cast<double>(diff.unchanged),
+                                          Rcpp::Named("created") = static_cast<double>(diff.created),
+                                          Rcpp::Named("modified") = static_cast<double>(diff.modified),
+                                          Rcpp::Named("deleted") = static_cast<double>(diff.deleted));
+  } catch(std::exception& e) {
+    Rcpp::stop(e.what());
+  }
+  Rcpp::DataFrame changes = Rcpp::DataFrame::create(
+    Rcpp::Named("type") = type, Rcpp::Named("id") = id, Rcpp::Named("change") = change,
+    Rcpp::Named("old_version") = old_version, Rcpp::Named("new_version") = new_version,
+    Rcpp::Named("stringsAsFactors") = false);
+  return Rcpp::List::create(Rcpp::Named("summary") = summary, Rcpp::Named("changes") = changes);
+}
+
+// Object filter with a predicate of rosmium::make_predicate() as leaf, combined with another filter if given
+ObjectFilter native_filter(SEXP predicate, SEXP filter, bool use_or) {
+  std::shared_ptr<tagfilter::Command> command;
+  try {
+    command = std::make_shared<NativePredicateCommand>(predicate);
+  } catch(std::exception& e) {
+    Rcpp::stop(e.what());
+  }
+  if(!Rf_isNull(filter)) {
+    std::shared_ptr<tagfilter::Command> other = Rcpp::as<ObjectFilter*>(filter)->getCommand();
+    if(use_or) {
+      command = std::make_shared<tagfilter::CommandOr>(other, command);
+    } else {
+      command = std::make_shared<tagfilter::CommandAnd>(other, command);
+    }
+  }
+  return ObjectFilter(command);
+}
+
 class Dummy {
    int x;
    int get_x() {return x;}
@@ -496,9 +2077,28 @@ RCPP_MODULE(Rosmium){
   class_<OSMReader>("Reader")
     .constructor<std::string, unsigned char>()
     .property("file", &OSMReader::getFilename)
+    .property("threads", &OSMReader::getThreads, &OSMReader::setThreads)
+    .property("orderedAreas", &OSMReader::getOrderedAreas, &OSMReader::setOrderedAreas)
+    .property("spillMembers", &OSMReader::getSpillMembers, &OSMReader::setSpillMembers)
     .method("apply", &OSMReader::apply)
+    .method("applyStats", &OSMReader::apply_stats)
+    .method("applyTiles", &OSMReader::apply_tiles)
+    .method("applyCheckpointed", &OSMReader::apply_checkpointed)
+    .method("applyChangesets", &OSMReader::apply_changesets)
+    .method("applyChain", &OSMReader::apply_chain)
+    .method("setSnapshot", &OSMReader::setSnapshot)
+    .method("setTimeRange", &OSMReader::setTimeRange)
+    .method("clearTimeFilter", &OSMReader::clearTimeFilter)
     .method("applyR", &OSMReader::apply_r)
     .method("apply_writer", &OSMReader::apply_writer)
+    .method("applyNative", &OSMReader::apply_native_handler)
+    .method("routes", &OSMReader::routes)
+    .method("areaStats", &OSMReader::area_stats)
+    .method("exportFeatures", &OSMReader::export_features)
+    .method("partition", &OSMReader::partition)
+    .method("getObjects", &OSMReader::get_objects)
+    .method("setMemoryBudget", &OSMReader::setMemoryBudget)
+    .method("memoryUsage", &OSMReader::memoryUsage)
   ;
   
   class_<osmium::handler::Handler>("Handler")
@@ -514,12 +2114,19 @@ RCPP_MODULE(Rosmium){
     .constructor<Rcpp::CharacterVector, Rcpp::IntegerVector>()
     .method("registerFunction", &RHandler::registerFunction)
     .method("registerObjectFilter", &RHandler::registerObjectFilter)
+    .method("geometryProblems", &RHandler::geometryProblems)
     .field("max_results", &RHandler::mResultSize)
+    .field("way_areas", &RHandler::mWayAreas)
   ;
   
   class_<WriteHandler>("WriteHandler")
     .derives<HandlerWithFilter>("FilterHandler")
     .constructor<std::string>()
+    .method("toFile", &WriteHandler::toFile)
+    .method("toFd", &WriteHandler::toFd)
+    .method("toConnection", &WriteHandler::toConnection)
+    .method("setTagTransform", &WriteHandler::setTagTransform)
+    .method("clearTagTransform", &WriteHandler::clearTagTransform)
   ;
   
   class_<CountHandler>("CountHandler")
@@ -527,11 +2134,45 @@ RCPP_MODULE(Rosmium){
     .default_constructor()
     .field("nodes",&CountHandler::nodes)
     .field("ways", &CountHandler::ways)
+    .field("relations", &CountHandler::relations)
+  ;
+  
+  class_<StatsHandler>("StatsHandler")
+    .derives<osmium::handler::Handler>("Handler")
+    .default_constructor()
+    .method("summary", &StatsHandler::summary)
+  ;
+  
+  class_<TileHandler>("TileHandler")
+    .derives<osmium::handler::Handler>("Handler")
+    .constructor<int>()
+    .property("zoom", &TileHandler::getZoom)
+    .method("tiles", &TileHandler::tiles)
+  ;
+  
+  class_<ChangesetHandler>("ChangesetHandler")
+    .derives<osmium::handler::Handler>("Handler")
+    .constructor<std::string>()
+    .method("setBox", &ChangesetHandler::setBox)
+    .method("users", &changeset_users)
+    .method("windows", &changeset_windows)
+    .method("hashtags", &changeset_hashtags)
+    .method("changesets", &changeset_selected)
   ;
   
   class_<ObjectFilter>("ObjectFilter")
     .constructor<Rcpp::CharacterVector>()  
   ;
+  
+  Rcpp::function("generateSynthetic", &generate_synthetic);
+  Rcpp::function("benchmarkIndexes", &benchmark_indexes);
+  Rcpp::function("benchmarkGeometry", &benchmark_geometry);
+  Rcpp::function("benchmarkVarint", &benchmark_varint);
+  Rcpp::function("setReadOptions", &set_read_options);
+  Rcpp::function("getReadOptions", &get_read_options);
+  Rcpp::function("readStatistics", &get_read_statistics);
+  Rcpp::function("diffFiles", &diff_files);
+  Rcpp::function("nativeFilter", &native_filter);
 }
 
 